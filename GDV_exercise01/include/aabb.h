@@ -20,15 +20,35 @@ struct AABB {
         max = ::max(max, p);
     }
 
+    /// extend the bounding box to also contain the other bounding box
+    void extend(const AABB& other)
+    {
+        min = ::min(min, other.min);
+        max = ::max(max, other.max);
+    }
+
     /// returns the size of the bounding box
     Point3D extents() const { return max - min; }
 
+    /// returns the center of the bounding box
+    Point3D center() const { return (min + max) * 0.5f; }
+
+    /// returns the surface area of the bounding box, 0 if it is empty
+    float surfaceArea() const
+    {
+        const Point3D e = extents();
+        return e.x >= 0.0f && e.y >= 0.0f && e.z >= 0.0f ? 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x) : 0.0f;
+    }
+
     /// checks whether the point is contained in the bounding box
     bool contains(const Point3D& p) const { return p >= min && p <= max; }
 
     /// checks whether the given bounding box is contained in this bounding box
     bool contains(const AABB& other) const { return other.min >= min && other.max <= max; }
 
+    /// checks whether the bounding boxes share at least one point
+    bool overlaps(const AABB& other) const { return min <= other.max && other.min <= max; }
+
     /// extend the bounding box to also contain the other bounding box
     AABB operator+(const AABB& other) { return {::min(min, other.min), ::max(max, other.max)}; }
 
@@ -0,0 +1,34 @@
+#ifndef AMBIENTOCCLUSION_H
+#define AMBIENTOCCLUSION_H
+
+#include <cstdint>
+
+#include "bvh.h"
+#include "mesh.h"
+
+/// how ambient occlusion is baked
+struct AmbientOcclusionSettings {
+    /// rays per vertex
+    uint32_t rays{64};
+    /// faces farther away than this fraction of the largest extent of the bounds do not occlude, 0 for no limit
+    float maxDistance{0.25f};
+};
+
+/**
+ * @brief bake the ambient occlusion of every vertex into Mesh::getAmbientOcclusion()
+ *
+ * shadow rays leave each vertex cosine distributed around the area weighted normal of all
+ * faces around it, the value is the fraction of the rays which reach maxDistance without
+ * hitting a face. the directions of a vertex form a Fibonacci lattice on the hemisphere,
+ * shifted by a hash of the vertex index, so neighboring vertices get different directions
+ * and the result does not depend on the number of threads. vertices without faces get 1.
+ *
+ * @param bvh a BVH built over the faces of the mesh
+ * @return the number of rays traced
+ */
+uint64_t bakeAmbientOcclusion(Mesh& mesh, const TriangleBVH& bvh, const AmbientOcclusionSettings& settings = {});
+
+/// bake the ambient occlusion with a BVH built for the purpose
+uint64_t bakeAmbientOcclusion(Mesh& mesh, const AmbientOcclusionSettings& settings = {});
+
+#endif // AMBIENTOCCLUSION_H
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm> // std::reverse
+#include <array>
+#include <bit> // std::bit_cast, std::endian
+#include <cstdint>
+#include <cstring> // std::memcpy
+
+/**
+ * @brief helpers to read and write unaligned little or big endian values
+ *
+ * all of them are defined in the header, so the compiler can inline them
+ * into the bulk conversion loops of the file readers and writers
+ */
+
+/// reverse the byte order of a trivially copyable value
+template <typename T>
+inline T byteSwap(T value)
+{
+    auto bytes = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+    std::reverse(bytes.begin(), bytes.end());
+    return std::bit_cast<T>(bytes);
+}
+
+/// read a value from a possibly unaligned pointer, swapping the byte order if requested
+template <typename T>
+inline T readValue(const uint8_t* p, bool swap = false)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return swap ? byteSwap(value) : value;
+}
+
+/// read a little endian value from a possibly unaligned pointer
+template <typename T>
+inline T readLittleEndian(const uint8_t* p)
+{
+    return readValue<T>(p, std::endian::native != std::endian::little);
+}
+
+/// write a value to a possibly unaligned pointer in little endian byte order
+template <typename T>
+inline void writeLittleEndian(uint8_t* p, T value)
+{
+    if constexpr (std::endian::native != std::endian::little)
+        value = byteSwap(value);
+    std::memcpy(p, &value, sizeof(T));
+}
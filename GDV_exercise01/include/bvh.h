@@ -0,0 +1,129 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "memorystats.h"
+#include "mesh.h"
+#include "ray.h"
+
+/// the point on the faces of a mesh closest to a query point
+struct ClosestPoint {
+    Point3D point;
+    float distanceSquared{std::numeric_limits<float>::infinity()};
+    /// the face the point lies on, or RayHit::none
+    uint32_t face{RayHit::none};
+
+    bool found() const { return face != RayHit::none; }
+    float distance() const { return std::sqrt(distanceSquared); }
+};
+
+/**
+ * @brief bounding volume hierarchy over the triangles of a mesh
+ *
+ * the tree is built top-down with a binned surface area heuristic (SAH). when
+ * vertices move but the faces stay the same, refit() updates the bounds
+ * bottom-up in parallel. refitting keeps the topology, so the tree degrades
+ * for larger motions: if the SAH cost grows past restructureThreshold times
+ * the cost after the last build, the treelets below the nodes that grew the
+ * most are restructured to their optimal topology (Karras and Aila 2013),
+ * and if that does not bring the cost back under the threshold the tree is
+ * rebuilt.
+ *
+ * the BVH keeps a pointer to the mesh, which must outlive it.
+ */
+class TriangleBVH {
+public:
+    static constexpr uint32_t invalid = UINT32_MAX;
+
+    struct Node {
+        AABB bounds;
+        /// inner nodes: the left child, leaves: the first entry of the face order
+        uint32_t left{invalid};
+        /// inner nodes: the right child
+        uint32_t right{invalid};
+        /// number of faces of a leaf, 0 for inner nodes
+        uint32_t count{0};
+        /// parent node, invalid for the root
+        uint32_t parent{invalid};
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    /// what refit() had to do to keep the tree usable
+    enum class RefitResult { Refitted, Restructured, Rebuilt };
+
+    /// faces per leaf the builder creates at most
+    static constexpr uint32_t maxLeafSize = 8;
+
+    TriangleBVH() = default;
+    explicit TriangleBVH(const Mesh& mesh) { build(mesh); }
+
+    /// build the hierarchy over the faces of the given mesh
+    void build(const Mesh& mesh);
+
+    /**
+     * @brief update the bounds after the vertices of the mesh moved, the faces must not have changed
+     * @return whether the tree only was refitted, or also restructured or rebuilt
+     */
+    RefitResult refit();
+
+    /// find the closest hit of the ray inside [tMin, tMax], returns whether there is one
+    bool intersect(const Ray& ray, RayHit& hit) const;
+
+    /**
+     * @brief find the closest hits of all rays of the packet, returns whether any ray hits
+     * a node is visited if any of the rays enters it, so this pays off for coherent rays
+     */
+    bool intersect(RayPacket& packet) const;
+
+    /// checks whether the ray hits any face inside [tMin, tMax], e.g. for shadow rays
+    bool occluded(const Ray& ray) const;
+
+    /**
+     * @brief find the point on the faces closest to p which is not farther than maxDistance
+     * the nearer child is visited first and nodes farther than the closest point so far are skipped,
+     * so a tight maxDistance, e.g. from a neighboring query, saves most of the work
+     * @return whether there is such a point
+     */
+    bool closestPoint(const Point3D& p, ClosestPoint& result,
+                      float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+    /// expected cost of a random ray: inner nodes count 1 and faces 1, weighted by the surface area relative to the root
+    float sahCost() const;
+    /// the SAH cost right after the last build
+    float referenceCost() const { return builtCost; }
+
+    /// SAH cost growth relative to the last build which makes refit() restructure the tree
+    void setRestructureThreshold(float threshold) { restructureThreshold = threshold; }
+
+    const Mesh* getMesh() const { return mesh; }
+    /// the nodes, the root is node 0
+    const CountedVector<Node, MemoryCategory::AccelerationStructures>& getNodes() const { return nodes; }
+    /// face indices in the order the leaves reference them
+    const CountedVector<uint32_t, MemoryCategory::AccelerationStructures>& getFaceOrder() const { return faceOrder; }
+    /// bounds of the whole mesh
+    AABB getBounds() const { return nodes.empty() ? AABB{} : nodes[0].bounds; }
+
+private:
+    /// bounds of the faces of a leaf
+    AABB leafBounds(const Node& leaf) const;
+    /// optimize the treelets of the nodes whose area grew past the threshold, false if the tree got too deep
+    bool restructure();
+    /// find the optimal topology of the treelet with up to 7 leaves below root
+    void optimizeTreelet(uint32_t root, CountedVector<float, MemoryCategory::Temporary>& costs);
+
+    const Mesh* mesh{nullptr};
+    CountedVector<Node, MemoryCategory::AccelerationStructures> nodes;
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> faceOrder;
+    /// all leaf nodes, the starting points of the parallel refit
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> leaves;
+    /// surface area of each node after the last build or restructuring
+    CountedVector<float, MemoryCategory::AccelerationStructures> referenceAreas;
+    float builtCost{0.0f};
+    float restructureThreshold{1.25f};
+};
+
+#endif // BVH_H
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "aabb.h"
+
+/// inverse of a 4x4 matrix by Gauss-Jordan elimination with partial pivoting
+inline nanogui::Matrix4f invert(const nanogui::Matrix4f& matrix)
+{
+    // the storage is column-major, m[column][row]
+    nanogui::Matrix4f a = matrix, inverse{1.0f};
+    for (int col = 0; col < 4; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < 4; ++row)
+            if (std::abs(a.m[col][row]) > std::abs(a.m[col][pivot]))
+                pivot = row;
+        for (int c = 0; c < 4; ++c) {
+            std::swap(a.m[c][col], a.m[c][pivot]);
+            std::swap(inverse.m[c][col], inverse.m[c][pivot]);
+        }
+        const float scale = 1.0f / a.m[col][col];
+        for (int c = 0; c < 4; ++c) {
+            a.m[c][col] *= scale;
+            inverse.m[c][col] *= scale;
+        }
+        for (int row = 0; row < 4; ++row) {
+            const float factor = a.m[col][row];
+            if (row == col || factor == 0.0f)
+                continue;
+            for (int c = 0; c < 4; ++c) {
+                a.m[c][row] -= factor * a.m[c][col];
+                inverse.m[c][row] -= factor * inverse.m[c][col];
+            }
+        }
+    }
+    return inverse;
+}
+
+/// apply the matrix to the point (x, y, z, 1) and divide by w
+inline Point3D transformPoint(const nanogui::Matrix4f& matrix, float x, float y, float z)
+{
+    float result[4];
+    for (int row = 0; row < 4; ++row)
+        result[row] = matrix.m[0][row] * x + matrix.m[1][row] * y + matrix.m[2][row] * z + matrix.m[3][row];
+    return {result[0] / result[3], result[1] / result[3], result[2] / result[3]};
+}
+
+/// the transformations a mesh is shown with
+struct ViewSetup {
+    nanogui::Matrix4f model{1.0f};
+    nanogui::Matrix4f view{1.0f};
+    nanogui::Matrix4f projection{1.0f};
+    /// the camera position in world space
+    nanogui::Vector3f cameraPosition{0.0f};
+
+    nanogui::Matrix4f mvp() const { return projection * view * model; }
+};
+
+/**
+ * @brief the camera of MeshCanvas: the mesh with the given bounds rotates about the y axis by angle
+ * radians, optionally scaled and centered, and is seen from (0, 0.5, -4) with a vertical field of
+ * view of 30 degrees widened for narrow images
+ */
+inline ViewSetup canvasView(const AABB& bounds, float angle, bool autoScale, bool autoCenter, float aspect)
+{
+    using nanogui::Matrix4f;
+    using nanogui::Vector3f;
+
+    ViewSetup setup;
+    setup.cameraPosition = {0, 0.5f, -4.0f};
+
+    const Matrix4f rotate = Matrix4f::rotate({0.0f, 1.0f, 0.0f}, angle);
+    const float scale = autoCenter ? 2.0f / bounds.extents().maxComponent()
+                                   : 1.0f / max(abs(bounds.min), abs(bounds.max)).maxComponent();
+    const Point3D center = bounds.min + bounds.extents() * 0.5f;
+    const Vector3f translation{-center.x, -center.y, -center.z};
+
+    setup.model = rotate;
+    if (autoScale)
+        setup.model = setup.model * Matrix4f::scale(Vector3f{scale});
+    if (autoCenter)
+        setup.model = setup.model * Matrix4f::translate(translation);
+
+    setup.view = Matrix4f::look_at(setup.cameraPosition, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+
+    const float fov = 30.0f * std::numbers::pi_v<float> / 180.0f / std::max(0.2f, std::min(1.0f, aspect));
+    setup.projection = Matrix4f::perspective(fov, 0.1f, 20.f, aspect);
+    return setup;
+}
@@ -1,10 +1,15 @@
 #ifndef EXERCISE01_H
 #define EXERCISE01_H
 
+#include <iostream>
+#include <string>
 #include <nanogui/nanogui.h>
 
+#include "ambientocclusion.h"
+#include "bvh.h"
 #include "mesh.h"
 #include "meshcanvas.h"
+#include "meshdistance.h"
 
 #if __cpp_lib_math_constants >= 201907L
 #include <numbers>
@@ -27,7 +32,7 @@ class Exercise01Controls final : public nanogui::Object
 public:
     Exercise01Controls(nanogui::FormHelper& gui, nanogui::Vector2i pos,
                        const Mesh& mesh, nanogui::ref<MeshCanvas>& canvas)
-        : mesh{mesh}, transformedMesh{mesh}, canvas{canvas}
+        : mesh{mesh}, transformedMesh{mesh}, bvh{transformedMesh}, canvas{canvas}
     {
         controlWindow = gui.add_window({450, 10}, "Exercise 1");
         gui.add_group("Scaling");
@@ -47,8 +52,11 @@ public:
         gui.add_button("rotate z", [&]() -> void {rotateMeshZ();});
         gui.add_group("");
         gui.add_button("reset", [&]() -> void {resetMesh();});
+        gui.add_button("distance to original", [&]() -> void {showDistance();});
+        gui.add_button("save OBJ", [&]() -> void {saveMesh();});
 
         canvas->uploadMesh(transformedMesh);
+        canvas->set_pick_callback([&](const Ray& ray) -> void {pickFace(ray);});
     }
 
     void scaleMesh() {
@@ -56,15 +64,13 @@ public:
             vertex = Exercise01::scale(vertex, sx, sy, sz);
         for (auto& normal : transformedMesh.getNormals())
             normal = Exercise01::scale(normal, 1.0f/sx, 1.0f/sy, 1.0f/sz);
-        transformedMesh.updateBounds();
-        canvas->uploadMesh(transformedMesh);
+        meshMoved();
     }
 
     void translateMesh() {
         for (auto& vertex : transformedMesh.getVertices())
             vertex = Exercise01::translate(vertex, tx, ty, tz);
-        transformedMesh.updateBounds();
-        canvas->uploadMesh(transformedMesh);
+        meshMoved();
     }
 
     void rotateMeshX() {
@@ -72,8 +78,7 @@ public:
             vertex = Exercise01::rotateX(vertex, angle*degToRad);
         for (auto& normal : transformedMesh.getNormals())
             normal = Exercise01::rotateX(normal, angle*degToRad);
-        transformedMesh.updateBounds();
-        canvas->uploadMesh(transformedMesh);
+        meshMoved();
     }
 
     void rotateMeshY() {
@@ -81,8 +86,7 @@ public:
             vertex = Exercise01::rotateY(vertex, angle*degToRad);
         for (auto& normal : transformedMesh.getNormals())
             normal = Exercise01::rotateY(normal, angle*degToRad);
-        transformedMesh.updateBounds();
-        canvas->uploadMesh(transformedMesh);
+        meshMoved();
     }
 
     void rotateMeshZ() {
@@ -90,18 +94,73 @@ public:
             vertex = Exercise01::rotateZ(vertex, angle*degToRad);
         for (auto& normal : transformedMesh.getNormals())
             normal = Exercise01::rotateZ(normal, angle*degToRad);
-        transformedMesh.updateBounds();
+        meshMoved();
+    }
+
+    const Mesh& getTransformedMesh() const { return transformedMesh; }
+
+    /// ask for a file name and save the transformed mesh there
+    void saveMesh() {
+        const std::string path = nanogui::file_dialog({{"obj", "Wavefront OBJ"}}, true);
+        if (path.empty())
+            return;
+        try {
+            transformedMesh.saveOBJ(path);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    /// bake the ambient occlusion of the transformed mesh, it is kept by the transformations
+    void bakeMeshOcclusion() {
+        bakeAmbientOcclusion(transformedMesh, bvh);
         canvas->uploadMesh(transformedMesh);
     }
 
     void resetMesh() {
         transformedMesh = mesh;
+        bvh.build(transformedMesh);
         canvas->uploadMesh(transformedMesh);
     }
 
+    /// color the transformed mesh by the distance of its vertices to the original surface
+    void showDistance() {
+        try {
+            transformedMesh.updateFaceAreas();
+            const TriangleBVH originalBvh{mesh};
+            const MeshDistance distance = compareMeshes(mesh, originalBvh, transformedMesh, bvh);
+            std::cout << "Hausdorff distance " << distance.hausdorff() << ", RMS distance " << distance.rms()
+                      << std::endl;
+            canvas->set_vertex_values(distance.vertexErrorsB, distance.hausdorff());
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    /// print the face of the transformed mesh hit by the ray
+    void pickFace(const Ray& ray) const {
+        RayHit hit;
+        if (bvh.intersect(ray, hit))
+            std::cout << "Picked face " << hit.face << " at " << ray.at(hit.t) << std::endl;
+    }
+
 private:
+    /// the vertices moved but the faces stayed, so the BVH only has to be refitted
+    void meshMoved() {
+        transformedMesh.updateBounds();
+        const TriangleBVH::RefitResult result = bvh.refit();
+        std::cout << "BVH " << (result == TriangleBVH::RefitResult::Refitted       ? "refitted"
+                                : result == TriangleBVH::RefitResult::Restructured ? "restructured"
+                                                                                   : "rebuilt")
+                  << ", SAH cost " << bvh.sahCost() << " (" << bvh.referenceCost() << " after the build)" << std::endl;
+        canvas->uploadMesh(transformedMesh);
+    }
+
     const Mesh& mesh;
     Mesh transformedMesh;
+    TriangleBVH bvh;
     nanogui::ref<nanogui::Window> controlWindow;
     nanogui::ref<MeshCanvas> canvas;
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+
+#include "aabb.h"
+
+/// the points p with dot(normal, p) + distance >= 0 are inside
+struct Plane {
+    Point3D normal;
+    float distance{0.0f};
+
+    float signedDistance(const Point3D& p) const { return dot(normal, p) + distance; }
+};
+
+/// result of testing a bounding box against a frustum
+enum class FrustumTest { Outside, Intersecting, Inside };
+
+/// a view frustum given by six planes facing inwards
+struct Frustum {
+    /// left, right, bottom, top, near, far
+    std::array<Plane, 6> planes;
+
+    /**
+     * @brief extract the planes of the clip volume -w <= x, y, z <= w (Gribb and Hartmann 2001)
+     * for a projection * view matrix the planes are in world space, with the model matrix
+     * included they are in the coordinates of the model
+     */
+    static Frustum fromMatrix(const nanogui::Matrix4f& matrix)
+    {
+        // nanogui matrices are column-major, m[column][row]
+        auto row = [&](int r) -> std::array<float, 4> {
+            return {matrix.m[0][r], matrix.m[1][r], matrix.m[2][r], matrix.m[3][r]};
+        };
+        const std::array<float, 4> w = row(3);
+        Frustum frustum;
+        for (int axis = 0; axis < 3; ++axis) {
+            const std::array<float, 4> r = row(axis);
+            for (int side = 0; side < 2; ++side) {
+                const float sign = side == 0 ? 1.0f : -1.0f;
+                Plane& plane = frustum.planes[2 * axis + side];
+                plane.normal = {w[0] + sign * r[0], w[1] + sign * r[1], w[2] + sign * r[2]};
+                plane.distance = w[3] + sign * r[3];
+                const float length = plane.normal.norm();
+                if (length > 0.0f) {
+                    plane.normal = plane.normal / length;
+                    plane.distance /= length;
+                }
+            }
+        }
+        return frustum;
+    }
+
+    /// whether the box is completely outside, completely inside or crosses a plane of the frustum
+    FrustumTest classify(const AABB& box) const
+    {
+        if (!(box.min <= box.max))
+            return FrustumTest::Outside;
+        const Point3D center = box.center();
+        const Point3D half = box.extents() * 0.5f;
+        FrustumTest result = FrustumTest::Inside;
+        for (const Plane& plane : planes) {
+            const float s = plane.signedDistance(center);
+            const float radius = dot(abs(plane.normal), half);
+            if (s < -radius)
+                return FrustumTest::Outside;
+            if (s < radius)
+                result = FrustumTest::Intersecting;
+        }
+        return result;
+    }
+
+    /// conservative: boxes outside of the frustum near its edges may still be reported
+    bool intersects(const AABB& box) const { return classify(box) != FrustumTest::Outside; }
+};
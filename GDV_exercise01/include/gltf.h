@@ -0,0 +1,102 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+/// component types of glTF accessors, the values are the glTF constants
+enum class GLTFComponentType : uint32_t {
+    Int8 = 5120,
+    UInt8 = 5121,
+    Int16 = 5122,
+    UInt16 = 5123,
+    UInt32 = 5125,
+    Float32 = 5126
+};
+
+/// size of one component in bytes
+size_t componentSize(GLTFComponentType type);
+
+/**
+ * @brief strided view of the elements of a glTF accessor inside a mapped GLB file
+ * the view stays valid as long as the GLBFile it was taken from
+ */
+struct GLBAccessor {
+    /// first byte of the first element
+    const uint8_t* data{nullptr};
+    /// number of elements
+    size_t count{0};
+    /// distance between two elements in bytes
+    size_t stride{0};
+    GLTFComponentType componentType{GLTFComponentType::Float32};
+    /// components per element, e.g. 3 for VEC3
+    size_t components{1};
+    /// integer components map to [0, 1] or [-1, 1]
+    bool normalized{false};
+
+    /**
+     * @brief checks whether the elements are stored exactly like an array of T
+     * with T consisting of components values of the given type
+     */
+    bool isPacked(GLTFComponentType type, size_t componentsOfT, size_t sizeOfT, size_t alignOfT) const;
+
+    /// checks whether the elements are stored exactly like an array of T made of float or uint32 components
+    template <typename T>
+    bool isPackedAs(GLTFComponentType type) const
+    {
+        return isPacked(type, sizeof(T) / componentSize(type), sizeof(T), alignof(T));
+    }
+
+    /// view the elements as an array of T, only valid if isPackedAs<T>() holds
+    template <typename T>
+    std::span<const T> as() const
+    {
+        return {reinterpret_cast<const T*>(data), count};
+    }
+
+    /**
+     * @brief convert the elements [begin, end) to floats, normalized integers are mapped to
+     * [0, 1] or [-1, 1], the first outComponents components are written per element
+     */
+    void readFloats(size_t begin, size_t end, float* out, size_t outComponents) const;
+
+    /// convert the (scalar) elements [begin, end) to uint32 indices
+    void readIndices(size_t begin, size_t end, uint32_t* out) const;
+};
+
+/// the geometry of one glTF mesh primitive
+struct GLBPrimitive {
+    std::optional<GLBAccessor> positions, normals, texCoords, indices;
+    /// glTF primitive mode, 4 = triangles, 5 = triangle strip, 6 = triangle fan
+    uint32_t mode{4};
+    /// name of the glTF mesh the primitive belongs to
+    std::string meshName;
+
+    /// checks whether the primitive consists of triangles
+    bool isTriangles() const { return mode >= 4 && mode <= 6; }
+};
+
+/**
+ * @brief a memory-mapped binary glTF 2.0 (.glb) file
+ * only the embedded binary buffer is supported, node transforms are not applied
+ */
+class GLBFile {
+public:
+    /// map and parse the given file, throws std::runtime_error if it is not a supported GLB file
+    explicit GLBFile(const std::string& filename);
+
+    /// all primitives of all meshes in the order of the file
+    const std::vector<GLBPrimitive>& getPrimitives() const { return primitives; }
+
+private:
+    MappedFile file;
+    std::vector<GLBPrimitive> primitives;
+};
+
+#endif // GLTF_H
@@ -0,0 +1,126 @@
+#ifndef HALFEDGE_H
+#define HALFEDGE_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+/**
+ * @brief compact index based half-edge connectivity of a triangle mesh
+ *
+ * half-edge h = 3*f+k belongs to face f and starts at its k-th corner, so
+ * next, prev and face are implicit and only the origin vertex and the twin
+ * are stored per half-edge.
+ *
+ * edges shared by more than two faces or by two faces with inconsistent
+ * orientation are non-manifold: their half-edges are left without twin and
+ * behave like boundary edges. vertices where several fans of faces meet are
+ * flagged as non-manifold, circulating around them only visits one fan.
+ */
+class HalfEdgeMesh {
+public:
+    static constexpr uint32_t invalid = UINT32_MAX;
+
+    HalfEdgeMesh() = default;
+    explicit HalfEdgeMesh(const Mesh& mesh) { build(mesh); }
+
+    /// build the connectivity of the faces of the given mesh
+    void build(const Mesh& mesh);
+
+    /**
+     * @brief convert back to a mesh
+     * removed vertices and faces are compacted away, smooth groups, texture
+     * coordinates and ambient occlusion are kept, the vertex remaining after a
+     * collapse keeps its own. bounds, face areas and normals are re-computed
+     */
+    Mesh toMesh() const;
+
+    size_t numVertices() const { return positions.size(); }
+    size_t numFaces() const { return faceDeleted.size(); }
+    size_t numHalfEdges() const { return origins.size(); }
+
+    /// number of edges with more than two faces or inconsistent orientation
+    size_t numNonManifoldEdges() const { return nonManifoldEdges; }
+    /// number of vertices where more than one fan of faces meets
+    size_t numNonManifoldVertices() const { return nonManifoldVertices; }
+
+    static uint32_t face(uint32_t h) { return h / 3; }
+    static uint32_t next(uint32_t h) { return h % 3 == 2 ? h - 2 : h + 1; }
+    static uint32_t prev(uint32_t h) { return h % 3 == 0 ? h + 2 : h - 1; }
+
+    /// vertex the half-edge starts at
+    uint32_t from(uint32_t h) const { return origins[h]; }
+    /// vertex the half-edge points to
+    uint32_t to(uint32_t h) const { return origins[next(h)]; }
+    /// the oppositely oriented half-edge of the neighboring face, or invalid
+    uint32_t twin(uint32_t h) const { return twins[h]; }
+    /// whether the half-edge has no neighboring face
+    bool isBoundary(uint32_t h) const { return twins[h] == invalid; }
+
+    /// an outgoing half-edge of the vertex, on the boundary if the vertex is, or invalid
+    uint32_t outgoing(uint32_t v) const { return vertexHalfEdges[v]; }
+    bool isBoundaryVertex(uint32_t v) const;
+    bool isManifoldVertex(uint32_t v) const { return !vertexNonManifold[v]; }
+    /// whether the vertex was removed by a collapse or is not used by any face
+    bool isDeletedVertex(uint32_t v) const { return vertexHalfEdges[v] == invalid; }
+    bool isDeletedFace(uint32_t f) const { return faceDeleted[f]; }
+
+    const Vertex& position(uint32_t v) const { return positions[v]; }
+    Vertex& position(uint32_t v) { return positions[v]; }
+
+    /// call f(h) for each outgoing half-edge of v
+    template <typename F>
+    void forEachOutgoing(uint32_t v, F&& f) const
+    {
+        const uint32_t start = vertexHalfEdges[v];
+        if (start == invalid)
+            return;
+        uint32_t h = start;
+        do {
+            f(h);
+            h = twins[prev(h)];
+        } while (h != invalid && h != start);
+    }
+
+    /// the vertices sharing an edge with v, in order around v
+    std::vector<uint32_t> oneRing(uint32_t v) const;
+
+    /// the faces sharing an edge with face f, invalid for boundary edges
+    std::array<uint32_t, 3> faceNeighbors(uint32_t f) const;
+
+    /// the boundary loops as lists of boundary half-edges
+    std::vector<std::vector<uint32_t>> boundaryLoops() const;
+
+    /**
+     * @brief collapse the edge of half-edge h into its origin vertex
+     * the target vertex and the one or two faces adjacent to the edge are removed
+     * @param h the half-edge to collapse
+     * @param position the new position of the remaining vertex
+     * @return false if the collapse would change the topology (link condition) and was skipped
+     */
+    bool collapseEdge(uint32_t h, const Vertex& position);
+
+private:
+    bool canCollapse(uint32_t h) const;
+    /// re-select the outgoing half-edge of v after its faces changed
+    void updateOutgoing(uint32_t v, uint32_t candidate);
+
+    /// origin vertex per half-edge
+    std::vector<uint32_t> origins;
+    /// twin per half-edge
+    std::vector<uint32_t> twins;
+    /// outgoing half-edge per vertex
+    std::vector<uint32_t> vertexHalfEdges;
+    std::vector<uint8_t> vertexNonManifold;
+    std::vector<uint8_t> faceDeleted;
+    std::vector<Vertex> positions;
+    TextureCoordinateList texCoords;
+    AmbientOcclusionList ambientOcclusion;
+    SmoothGroupList smoothGroups;
+    size_t nonManifoldEdges{0};
+    size_t nonManifoldVertices{0};
+};
+
+#endif // HALFEDGE_H
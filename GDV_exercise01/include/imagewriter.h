@@ -0,0 +1,22 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * the images are linear RGB with three floats per pixel and the rows from top to bottom,
+ * all writers throw std::runtime_error if the file cannot be written
+ */
+
+/// write an 8 bit sRGB PNG, the colors are clamped to [0, 1]
+void writePNG(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb);
+
+/// write an uncompressed OpenEXR scanline file with 32 bit float channels, keeping the full range
+void writeEXR(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb);
+
+/// write a PNG or EXR file depending on the file extension
+void writeImage(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb);
+
+#endif // IMAGEWRITER_H
@@ -0,0 +1,48 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+/**
+ * @brief read-only memory mapping of a whole file
+ *
+ * the pages are only read from disk when they are accessed, so large
+ * files can be parsed without copying them into a buffer first
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    /// map the given file, throws std::runtime_error if it cannot be opened
+    explicit MappedFile(const std::string& filename) { open(filename); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// map the given file, throws std::runtime_error if it cannot be opened
+    void open(const std::string& filename);
+    /// unmap the file
+    void close();
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    const uint8_t* begin() const { return bytes; }
+    const uint8_t* end() const { return bytes + length; }
+
+private:
+    const uint8_t* bytes{nullptr};
+    size_t length{0};
+#if defined(_WIN32)
+    void* fileHandle{nullptr};
+    void* mappingHandle{nullptr};
+#else
+    int fileDescriptor{-1};
+#endif
+};
+
+#endif // MAPPEDFILE_H
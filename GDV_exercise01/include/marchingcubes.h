@@ -0,0 +1,32 @@
+#ifndef MARCHINGCUBES_H
+#define MARCHINGCUBES_H
+
+#include "mesh.h"
+#include "scalargrid.h"
+#include "signeddistancefield.h"
+
+/**
+ * @brief extract the surface where a scalar field crosses isoValue with marching cubes
+ *
+ * samples below the iso value are inside, the faces are oriented and the normals point
+ * towards larger values, out of a signed distance field. the normals are the normalized
+ * field gradients of central differences, interpolated along the cell edges. all faces
+ * form one smooth group. faces of cells with the iso value exactly at a sample have zero
+ * area, Mesh::repair() removes them.
+ *
+ * the cell layers are split into one slab per thread. a counting pass finds the number of
+ * vertices and faces of every slab, so all arrays are allocated with their final size and
+ * every slab writes its own range. the vertices on the cell edges are shared through two
+ * layers of per-slab edge caches. a slab numbers the edges of its first sample layer first,
+ * so the slab below can work out the indices on the layer between them by itself.
+ *
+ * the triangles of the 256 cell cases are generated once from the cell faces: on every
+ * face the crossings are connected such that inside corners stay separated, which is the
+ * same on both sides of the face, so the surface has no cracks.
+ */
+Mesh marchingCubes(const ScalarGrid& grid, float isoValue = 0.0f);
+
+/// extract the iso surface of a signed distance field, with 0 the surface of the sampled mesh
+Mesh marchingCubes(const SignedDistanceField& field, float isoValue = 0.0f);
+
+#endif // MARCHINGCUBES_H
@@ -0,0 +1,131 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+/// categories of heap memory tracked by the counting allocators
+enum class MemoryCategory : size_t {
+    Vertices,
+    Faces,
+    Normals,
+    TextureCoordinates,
+    FaceAreas,
+    SmoothGroups,
+    AmbientOcclusion,
+    /// bounding volume hierarchies and other spatial indices
+    AccelerationStructures,
+    /// voxel grids like signed distance fields
+    DistanceFields,
+    /// buffers that only live while a mesh is loaded or processed
+    Temporary,
+    Count
+};
+
+/**
+ * @brief allocation statistics of one memory category
+ *
+ * all members are atomic, so the counters may be updated from several threads
+ */
+struct MemoryCounter {
+    /// bytes currently allocated
+    std::atomic<size_t> current{0};
+    /// maximum of current since the last call to resetPeak()
+    std::atomic<size_t> peak{0};
+    /// number of allocations in total
+    std::atomic<size_t> allocations{0};
+
+    void allocate(size_t bytes)
+    {
+        const size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t oldPeak = peak.load(std::memory_order_relaxed);
+        while (now > oldPeak && !peak.compare_exchange_weak(oldPeak, now, std::memory_order_relaxed)) {}
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void deallocate(size_t bytes) { current.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    /// restart peak tracking at the current usage
+    void resetPeak() { peak.store(current.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+};
+
+/// get the global counter of the given category
+MemoryCounter& memoryCounter(MemoryCategory category);
+/// get the global counter summing up all categories
+MemoryCounter& totalMemoryCounter();
+/**
+ * @brief peak of the total heap memory while the scope lives, relative to its start
+ *
+ * the counters are global, so allocations of other threads in the meantime are included
+ */
+class MemoryPeakScope {
+public:
+    MemoryPeakScope() : counter{totalMemoryCounter()}, baseline{counter.current.load(std::memory_order_relaxed)}
+    {
+        counter.resetPeak();
+    }
+
+    /// bytes allocated at most on top of the start, 0 if the usage only went down
+    size_t peak() const
+    {
+        const size_t now = counter.peak.load(std::memory_order_relaxed);
+        return now > baseline ? now - baseline : 0;
+    }
+
+    /// the part of the peak which is not held by the given resident bytes any more
+    size_t transient(size_t resident) const { return peak() > resident ? peak() - resident : 0; }
+
+private:
+    MemoryCounter& counter;
+    size_t baseline;
+};
+
+/// get a printable name of the given category
+const char* memoryCategoryName(MemoryCategory category);
+/// format a byte count for humans, e.g. "1.50 MiB"
+std::string formatBytes(size_t bytes);
+
+/**
+ * @brief std::allocator replacement which reports every allocation to the
+ * counter of its category and to the total counter
+ */
+template <typename T, MemoryCategory Category>
+struct CountingAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = CountingAllocator<U, Category>;
+    };
+
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U, Category>&) noexcept {}
+
+    T* allocate(size_t n)
+    {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        memoryCounter(Category).allocate(n * sizeof(T));
+        totalMemoryCounter().allocate(n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        memoryCounter(Category).deallocate(n * sizeof(T));
+        totalMemoryCounter().deallocate(n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U, Category>&) const { return true; }
+};
+
+/// std::vector whose memory is accounted to the given category
+template <typename T, MemoryCategory Category>
+using CountedVector = std::vector<T, CountingAllocator<T, Category>>;
+
+#endif // MEMORYSTATS_H
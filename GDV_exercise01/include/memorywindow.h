@@ -0,0 +1,84 @@
+#ifndef MEMORYWINDOW_H
+#define MEMORYWINDOW_H
+
+#include <nanogui/nanogui.h>
+
+#include "memorystats.h"
+#include "mesh.h"
+#include "meshcanvas.h"
+
+using namespace nanogui;
+
+/// A debug window showing the memory used by meshes and their GPU buffers
+class MemoryStatsWindow final : public Object {
+public:
+    MemoryStatsWindow(FormHelper& gui, Vector2i pos) {
+        controlWindow = gui.add_window(pos, "Memory");
+        gui.add_group("Meshes");
+        addRow(gui, "Vertices", vertices);
+        addRow(gui, "Faces", faces);
+        addRow(gui, "Normals", normals);
+        addRow(gui, "Texture coordinates", texCoords);
+        addRow(gui, "Face areas", faceAreas);
+        addRow(gui, "Smooth groups", smoothGroups);
+        addRow(gui, "Ambient occlusion", ambientOcclusion);
+        addRow(gui, "Peak load transient", peakLoadTransient);
+        gui.add_group("Process");
+        addRow(gui, "Tracked total", total);
+        addRow(gui, "Tracked peak", peak);
+        gui.add_group("GPU");
+        addRow(gui, "Buffers", gpu);
+        gui.add_button("refresh", [&]() -> void { refresh(); });
+    }
+
+    void addMesh(const Mesh& mesh) { meshes.push_back(&mesh); refresh(); }
+
+    void addMeshCanvas(ref<MeshCanvas>& canvas) { canvasObjects.push_back(canvas); refresh(); }
+
+    /// re-read the counters of all registered meshes and canvases
+    void refresh() {
+        MeshMemoryUsage sum;
+        for (const Mesh* mesh : meshes) {
+            const MeshMemoryUsage usage = mesh->getMemoryUsage();
+            sum.vertices += usage.vertices;
+            sum.faces += usage.faces;
+            sum.normals += usage.normals;
+            sum.texCoords += usage.texCoords;
+            sum.faceAreas += usage.faceAreas;
+            sum.smoothGroups += usage.smoothGroups;
+            sum.ambientOcclusion += usage.ambientOcclusion;
+            sum.peakLoadTransient = std::max(sum.peakLoadTransient, usage.peakLoadTransient);
+        }
+        size_t gpuBytes = 0;
+        for (const auto& canvas : canvasObjects)
+            gpuBytes += canvas->getGpuMemoryUsage();
+
+        vertices->set_caption(formatBytes(sum.vertices));
+        faces->set_caption(formatBytes(sum.faces));
+        normals->set_caption(formatBytes(sum.normals));
+        texCoords->set_caption(formatBytes(sum.texCoords));
+        faceAreas->set_caption(formatBytes(sum.faceAreas));
+        smoothGroups->set_caption(formatBytes(sum.smoothGroups));
+        ambientOcclusion->set_caption(formatBytes(sum.ambientOcclusion));
+        peakLoadTransient->set_caption(formatBytes(sum.peakLoadTransient));
+        total->set_caption(formatBytes(totalMemoryCounter().current));
+        peak->set_caption(formatBytes(totalMemoryCounter().peak));
+        gpu->set_caption(formatBytes(gpuBytes));
+    }
+
+private:
+    void addRow(FormHelper& gui, const std::string& name, ref<Label>& label) {
+        label = new Label(gui.window(), "");
+        label->set_fixed_width(100);
+        gui.add_widget(name, label);
+    }
+
+    ref<Window> controlWindow;
+    std::vector<const Mesh*> meshes;
+    std::vector<ref<MeshCanvas>> canvasObjects;
+
+    ref<Label> vertices, faces, normals, texCoords, faceAreas, smoothGroups, ambientOcclusion, peakLoadTransient;
+    ref<Label> total, peak, gpu;
+};
+
+#endif // MEMORYWINDOW_H
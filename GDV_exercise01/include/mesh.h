@@ -2,12 +2,16 @@
 #define MESH_H
 
 #include <cstdint>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "aabb.h"
+#include "memorystats.h"
 #include "point2d.h"
 #include "point3d.h"
+#include "spacefillingcurve.h"
 
 using Vertex = Point3D;
 using TextureCoordinate = Point2D;
@@ -16,6 +20,64 @@ struct TriangleIndices {
     uint32_t v1, v2, v3;
 };
 
+using VertexList = CountedVector<Vertex, MemoryCategory::Vertices>;
+using NormalList = CountedVector<Vertex, MemoryCategory::Normals>;
+using FaceList = CountedVector<TriangleIndices, MemoryCategory::Faces>;
+using TextureCoordinateList = CountedVector<TextureCoordinate, MemoryCategory::TextureCoordinates>;
+using FaceAreaList = CountedVector<float, MemoryCategory::FaceAreas>;
+using SmoothGroupList = CountedVector<std::pair<size_t, size_t>, MemoryCategory::SmoothGroups>;
+using AmbientOcclusionList = CountedVector<float, MemoryCategory::AmbientOcclusion>;
+
+/**
+ * @brief heap memory used by the attribute arrays of a mesh (in bytes)
+ */
+struct MeshMemoryUsage {
+    size_t vertices{0};
+    size_t faces{0};
+    size_t normals{0};
+    size_t texCoords{0};
+    size_t faceAreas{0};
+    size_t smoothGroups{0};
+    size_t ambientOcclusion{0};
+    /// peak memory on top of the final arrays while the mesh was loaded
+    size_t peakLoadTransient{0};
+
+    /// sum of all attribute arrays
+    size_t resident() const
+    {
+        return vertices + faces + normals + texCoords + faceAreas + smoothGroups + ambientOcclusion;
+    }
+};
+
+/// "to string"
+std::ostream& operator<<(std::ostream& os, const MeshMemoryUsage& usage);
+
+/// what Mesh::repair found and removed
+struct MeshRepairReport {
+    /// faces with a vertex index out of range
+    size_t invalidFaces{0};
+    /// faces using the same vertex more than once
+    size_t degenerateFaces{0};
+    /// faces with an area not above the threshold, or with non-finite positions
+    size_t zeroAreaFaces{0};
+    /// faces with the same three vertices as a face before them, in any order
+    size_t duplicateFaces{0};
+    size_t unreferencedVertices{0};
+
+    size_t removedFaces() const { return invalidFaces + degenerateFaces + zeroAreaFaces + duplicateFaces; }
+};
+
+/// "to string"
+std::ostream& operator<<(std::ostream& os, const MeshRepairReport& report);
+
+/// how the OBJ loader maps the vertices referenced by faces to mesh vertices
+enum class OBJVertexMode {
+    /// one vertex per OBJ position, normals and texture coordinates of its corners are averaged
+    MergePositions,
+    /// one vertex per distinct (position, texture coordinate, normal) triple, seams and hard edges are kept
+    SplitAttributes
+};
+
 /**
  * @brief 3D Triangle Mesh
  */
@@ -25,57 +87,196 @@ public:
 
     /**
      * @brief loadOBJ loads an OBJ file containing triangles or quads
-     * vertex normals and texture coordinates are ignored
      * all faces are merged into one object
      * @param filename
+     * @param mode whether vertices are merged per position or split per attribute triple
+     */
+    void loadOBJ(const std::string& filename, OBJVertexMode mode = OBJVertexMode::MergePositions);
+
+    /**
+     * @brief saveOBJ writes the mesh to an OBJ file
+     * normals and texture coordinates are written if there is one per vertex, and share
+     * the vertex indices, smooth groups are written as "s" statements
+     * @param filename
+     * @param parallel format the file on all cores (the output is identical)
+     */
+    void saveOBJ(const std::string& filename, bool parallel = true) const;
+
+    /**
+     * @brief loadPLY loads a binary little or big endian PLY file
+     * polygons are split into triangles, all faces form one smooth group,
+     * normals are computed if the file has none
+     * @param filename
+     */
+    void loadPLY(const std::string& filename);
+
+    /**
+     * @brief savePLY writes the mesh to a binary little endian PLY file
+     * normals and texture coordinates are written if there is one per vertex
+     * @param filename
+     */
+    void savePLY(const std::string& filename) const;
+
+    /**
+     * @brief loadSTL loads a binary STL file
+     * corners with bit-identical positions are merged into one vertex, all faces
+     * form one smooth group
+     * @param filename
+     */
+    void loadSTL(const std::string& filename);
+
+    /**
+     * @brief loadGLB loads the triangle primitives of a binary glTF 2.0 file
+     * all primitives are merged into one mesh like the objects of an OBJ file, primitives
+     * with normals form smooth groups, packed float attributes and uint32 indices are
+     * copied in bulk from the mapped file
+     * @param filename
      */
-    void loadOBJ(const std::string& filename);
+    void loadGLB(const std::string& filename);
+
+    /// load every triangle primitive of a binary glTF 2.0 file as a separate mesh
+    static std::vector<Mesh> loadGLBSubmeshes(const std::string& filename);
+
+    /**
+     * @brief saveCompressed writes the mesh in the compressed GDVM format
+     * positions are quantized inside the bounding box and predicted from already coded
+     * vertices, the faces are split into blocks which can be decoded independently;
+     * vertices are renumbered in the order of their first use and unreferenced ones are dropped
+     * @param filename
+     * @param positionBits quantization bits per position component (1 to 30)
+     */
+    void saveCompressed(const std::string& filename, uint32_t positionBits = 16) const;
+
+    /**
+     * @brief loadCompressed loads a mesh written by saveCompressed, decoding the blocks in parallel
+     * @param filename
+     */
+    void loadCompressed(const std::string& filename);
+
+    /// load an OBJ, PLY, STL, GLB, or GDVM file depending on the file extension
+    void load(const std::string& filename);
 
     /// remove all vertices and faces
     void clear() { *this = {}; }
 
     /// get vertices for reading
-    const std::vector<Vertex>& getVertices() const { return vertices; }
+    const VertexList& getVertices() const { return vertices; }
     /// get vertices for writing
-    std::vector<Vertex>& getVertices() { return vertices; }
+    VertexList& getVertices() { return vertices; }
     /// get faces for reading
-    const std::vector<TriangleIndices>& getFaces() const { return faces; }
+    const FaceList& getFaces() const { return faces; }
     /// get faces for writing
-    std::vector<TriangleIndices>& getFaces() { return faces; }
+    FaceList& getFaces() { return faces; }
     /// get pre-computed bounding box
     const AABB& getBounds() const { return aabb; }
     /// re-compute bounding box
     void updateBounds();
 
     /// get normals for reading
-    const std::vector<Vertex>& getNormals() const { return normals; }
+    const NormalList& getNormals() const { return normals; }
     /// get normals for writing
-    std::vector<Vertex>& getNormals() { return normals; }
+    NormalList& getNormals() { return normals; }
     /// get texture coordinates for reading
-    const std::vector<TextureCoordinate>& getTextureCoordinates() const { return texCoords; }
+    const TextureCoordinateList& getTextureCoordinates() const { return texCoords; }
     /// get texture coordinates for writing
-    std::vector<TextureCoordinate>& getTextureCoordinates() { return texCoords; }
+    TextureCoordinateList& getTextureCoordinates() { return texCoords; }
+
+    const FaceAreaList& getFaceAreas() const { return faceAreas; }
+    /// re-compute the area of each face
+    void updateFaceAreas();
+
+    const SmoothGroupList& getSmoothGroups() const { return smoothGroups; }
+    /// get smooth groups (ranges of faces) for writing
+    SmoothGroupList& getSmoothGroups() { return smoothGroups; }
+
+    /// get the baked ambient occlusion per vertex for reading, 1 is unoccluded, empty if not baked
+    const AmbientOcclusionList& getAmbientOcclusion() const { return ambientOcclusion; }
+    /// get the ambient occlusion per vertex for writing
+    AmbientOcclusionList& getAmbientOcclusion() { return ambientOcclusion; }
+
+    /**
+     * @brief re-compute the vertex normals from the faces
+     * faces inside a smooth group contribute to the normals of all their vertices,
+     * flat faces only to the normal of their first (provoking) vertex
+     */
+    void updateNormals();
 
-    const std::vector<float>& getFaceAreas() const { return faceAreas; }
+    /// get the heap memory held by the attribute arrays
+    MeshMemoryUsage getMemoryUsage() const;
 
-    const std::vector<std::pair<size_t, size_t>>& getSmoothGroups() const { return smoothGroups; }
+    /**
+     * @brief merge vertices closer than epsilon to each other
+     * every vertex is merged into the lowest index vertex within epsilon (after following
+     * chains of merges), normals, texture coordinates and ambient occlusion of merged vertices
+     * are averaged, faces are re-indexed, faces which become degenerate are removed and
+     * unreferenced vertices are compacted away; bounds and face areas are re-computed
+     * @param epsilon merge distance, 0 merges bitwise equal positions only
+     * @return the number of removed vertices
+     */
+    size_t weldVertices(float epsilon);
+
+    /**
+     * @brief refine the mesh with Loop subdivision
+     * every level splits each triangle into four; edges on the boundary, non-manifold edges,
+     * and edges between different smooth groups are kept as creases; vertex points keep
+     * their indices and the edge points follow them in face order; texture coordinates and
+     * ambient occlusion are interpolated linearly, bounds, face areas and normals are re-computed
+     * @param levels number of refinement steps
+     */
+    void subdivideLoop(unsigned levels = 1);
+
+    /**
+     * @brief remove broken faces and the vertices only they used
+     * invalid, degenerate, zero area and duplicate faces are found in parallel, the first of
+     * several faces with the same vertices is kept; areas are taken from the positions, smooth
+     * groups are remapped, vertices and their attributes are compacted, face areas and bounds
+     * are re-computed. normals are only re-computed for vertices which lost faces or had
+     * non-finite normals, or for all vertices if the mesh has none
+     * @param minArea faces with an area not above this are removed
+     * @return the number of removed elements per kind
+     */
+    MeshRepairReport repair(float minArea = 0.0f);
+
+    /**
+     * @brief sort vertices and faces along a space filling curve for memory locality
+     * vertices are sorted by the curve code of their position inside the bounding box,
+     * faces by the code of their centroid, but only inside their smooth group or run of
+     * flat faces; indices, vertex attributes and face areas are remapped
+     * @param curve the curve to sort along
+     */
+    void reorder(SpaceFillingCurve curve = SpaceFillingCurve::Hilbert);
+
+    /**
+     * @brief remove all vertices not referenced by any face
+     * normals, texture coordinates and ambient occlusion are compacted alongside
+     * @return the number of removed vertices
+     */
+    size_t removeUnreferencedVertices();
 
 private:
+    /// remove the faces whose flag in keep is 0, face areas and smooth groups are kept consistent
+    void removeFaces(const std::vector<uint8_t>& keep);
+
     /// the vertices of the mesh
-    std::vector<Vertex> vertices;
+    VertexList vertices;
     /// the triangle faces of the mesh
-    std::vector<TriangleIndices> faces;
+    FaceList faces;
     /// axis alignedbounding box containing all vertices
     AABB aabb;
 
     /// the normal vectors per vertex
-    std::vector<Vertex> normals;
+    NormalList normals;
     /// the texture coordinates per vertex
-    std::vector<TextureCoordinate> texCoords;
+    TextureCoordinateList texCoords;
     /// the area of each triangle
-    std::vector<float> faceAreas;
+    FaceAreaList faceAreas;
     /// smooth groups
-    std::vector<std::pair<size_t, size_t>> smoothGroups;
+    SmoothGroupList smoothGroups;
+    /// the fraction of the hemisphere above each vertex which is not occluded
+    AmbientOcclusionList ambientOcclusion;
+
+    /// peak memory on top of the final arrays during the last load
+    size_t peakLoadTransient{0};
 };
 
 
@@ -4,7 +4,13 @@
 #include <nanogui/nanogui.h>
 #include <nanogui/opengl.h>
 
+#include <functional>
+#include <vector>
+
 #include "mesh.h"
+#include "meshchunks.h"
+#include "occlusionculler.h"
+#include "ray.h"
 
 using namespace nanogui;
 
@@ -17,6 +23,12 @@ public:
 
     virtual void draw_contents() override;
 
+    /// picks with the left mouse button if a pick callback is set
+    virtual bool mouse_button_event(const Vector2i& p, int button, bool down, int modifiers) override;
+
+    /// called with the ray through the clicked pixel, in the coordinates of the uploaded mesh
+    void set_pick_callback(const std::function<void(const Ray&)>& callback) { pickCallback = callback; }
+
     void set_foreground_color(const Color& fg_color) { if (m_shader) m_shader->set_uniform("base_color", fg_color); }
 
     void set_wireframe(bool wireframe)
@@ -40,8 +52,23 @@ public:
             lastTime = static_cast<float>(glfwGetTime());
     }
     void set_auto_scale(bool auto_scale) { this->auto_scale = auto_scale; }
+    /// bytes of GPU buffers allocated for the uploaded mesh and the axes
+    size_t getGpuMemoryUsage() const { return gpuBytes + coordGpuBytes; }
     void set_auto_center(bool auto_center) { this->auto_center = auto_center; }
     void set_show_axes(bool show_coords) { this->show_axes = show_coords; }
+    /// only draw the meshlets of the mesh inside the view frustum and facing the camera
+    void set_frustum_culling(bool frustum_culling) { this->frustum_culling = frustum_culling; }
+    /// with culling also skip meshlets hidden behind the largest faces, except in wireframe mode
+    void set_occlusion_culling(bool occlusion_culling) { this->occlusion_culling = occlusion_culling; }
+    /// darken the mesh by its baked ambient occlusion, meshes without it stay unchanged
+    void set_ambient_occlusion(bool ambient_occlusion) { this->ambient_occlusion = ambient_occlusion; }
+    /**
+     * @brief color the uploaded mesh by one value per vertex, e.g. the errors of compareMeshes()
+     * 0 is blue and maxValue or more red, throws if the number of values differs from the vertices
+     */
+    void set_vertex_values(const std::vector<float>& values, float maxValue);
+    /// back to the foreground color, uploading a mesh does this too
+    void clear_vertex_values();
 
 private:
     bool wireframe{false};
@@ -50,14 +77,26 @@ private:
     bool auto_scale{true};
     bool auto_center{true};
     bool show_axes{true};
-    std::vector<std::pair<size_t, size_t>> smoothGroups;
+    bool frustum_culling{true};
+    bool occlusion_culling{true};
+    bool ambient_occlusion{true};
+    MeshChunks chunks;
+    OcclusionCuller occlusion;
+    /// face ranges to draw in the current frame
+    std::vector<MeshChunks::DrawRange> drawRanges;
     ref<Shader> m_shader;
     ref<Shader> m_coordShader;
     Mesh m_coordMesh;
     size_t numTriangles{0};
+    size_t numVertices{0};
+    size_t gpuBytes{0};
+    size_t coordGpuBytes{0};
     AABB aabb{};
     float time{0.0f};
     float lastTime{0.0f};
+    /// the transformation of the last frame, for picking
+    Matrix4f lastMvp{1.0f};
+    std::function<void(const Ray&)> pickCallback;
 };
 
 /// Some controls for the GUI
@@ -129,6 +168,30 @@ public:
                 canvas->set_show_axes(b);
         },
         [&]() -> bool { return show_axes; });
+        gui.add_variable<bool>(
+                    "Culling",
+                    [&](const bool& b) -> void {
+            frustum_culling = b;
+            for (auto& canvas : canvasObjects)
+                canvas->set_frustum_culling(b);
+        },
+        [&]() -> bool { return frustum_culling; });
+        gui.add_variable<bool>(
+                    "Occlusion",
+                    [&](const bool& b) -> void {
+            occlusion_culling = b;
+            for (auto& canvas : canvasObjects)
+                canvas->set_occlusion_culling(b);
+        },
+        [&]() -> bool { return occlusion_culling; });
+        gui.add_variable<bool>(
+                    "Ambient Occlusion",
+                    [&](const bool& b) -> void {
+            ambient_occlusion = b;
+            for (auto& canvas : canvasObjects)
+                canvas->set_ambient_occlusion(b);
+        },
+        [&]() -> bool { return ambient_occlusion; });
     }
 
     void addMeshCanvas(ref<MeshCanvas>& canvas) {
@@ -140,6 +203,9 @@ public:
         canvas->set_rotate(rotate);
         canvas->set_auto_center(auto_center);
         canvas->set_auto_scale(auto_scale);
+        canvas->set_frustum_culling(frustum_culling);
+        canvas->set_occlusion_culling(occlusion_culling);
+        canvas->set_ambient_occlusion(ambient_occlusion);
     }
 
 private:
@@ -155,6 +221,9 @@ private:
     bool auto_scale{false};
     bool auto_center{false};
     bool show_axes{true};
+    bool frustum_culling{true};
+    bool occlusion_culling{true};
+    bool ambient_occlusion{true};
 };
 
 #endif // MESHCANVAS_H
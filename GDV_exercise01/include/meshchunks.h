@@ -0,0 +1,107 @@
+#ifndef MESHCHUNKS_H
+#define MESHCHUNKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+#include "memorystats.h"
+#include "mesh.h"
+#include "occlusionculler.h"
+
+/**
+ * @brief a mesh split into spatially coherent chunks and meshlets of faces for culling
+ *
+ * build() sorts the faces of every smooth group and of every run of flat faces along the
+ * Morton curve of their centroids and cuts them into chunks with their own bounds. each
+ * chunk is split in parallel into meshlets of at most maxMeshletVertices vertices and
+ * maxMeshletTriangles faces, with a bounding sphere and a cone containing the normals of
+ * their faces. the faces in that order are what the renderer uploads.
+ *
+ * cull() first tests the bounds of all chunks against the frustum of a model-view-projection
+ * matrix, then the meshlets of the visible chunks against the frustum and, with backface
+ * culling, whether all their faces point away from the camera. with an OcclusionCuller the
+ * remaining chunks and meshlets are tested against its depth pyramid. neighboring visible meshlets
+ * are merged into draw ranges. the bounds are kept as separate arrays of each component,
+ * so the tests are branch-free loops the compiler vectorizes.
+ *
+ * the clustering only depends on the faces, build() reuses it as long as they are the
+ * same and only updates the bounds and cones, e.g. after the vertices were transformed.
+ */
+class MeshChunks {
+public:
+    static constexpr uint32_t maxMeshletVertices = 64;
+    static constexpr uint32_t maxMeshletTriangles = 124;
+
+    /// a range of faces in chunk order, either flat or smooth shaded
+    struct DrawRange {
+        size_t first;
+        size_t count;
+        bool smooth;
+    };
+
+    /**
+     * @brief split the faces of the mesh into chunks of up to facesPerChunk faces and into meshlets
+     * @return the faces in chunk order, they replace the faces of the mesh in the index buffer
+     */
+    FaceList build(const Mesh& mesh, size_t facesPerChunk = 1024);
+
+    /**
+     * @brief the face ranges of the meshlets intersecting the frustum of the matrix
+     * @param camera the camera position in the coordinates of the mesh
+     * @param backfaceCulling also reject meshlets whose faces all point away from the camera
+     * @param occlusion if set, also reject what is hidden behind its occluders, waits for its render()
+     * neighboring visible meshlets with the same shading form one range
+     */
+    void cull(const nanogui::Matrix4f& mvp, const Point3D& camera, bool backfaceCulling, std::vector<DrawRange>& ranges,
+              OcclusionCuller* occlusion = nullptr);
+
+    /// all chunks, merged into as few ranges as their shading allows
+    void all(std::vector<DrawRange>& ranges) const;
+
+    size_t numChunks() const { return chunks.size(); }
+    size_t numMeshlets() const { return meshletFaces.size(); }
+    /// number of meshlets and faces the last call of cull() found visible
+    size_t numVisibleMeshlets() const { return visibleMeshlets; }
+    size_t numVisibleFaces() const { return visibleFaces; }
+    /// number of chunks and meshlets the last call of cull() rejected as occluded
+    size_t numOccluded() const { return occluded; }
+
+private:
+    struct Chunk {
+        DrawRange faces;
+        /// the meshlets [firstMeshlet, endMeshlet) cover the faces of the chunk
+        uint32_t firstMeshlet, endMeshlet;
+    };
+
+    /// append a face range, extending the last range if possible
+    static void appendRange(const DrawRange& range, std::vector<DrawRange>& ranges);
+    /// fingerprint of the faces and smooth groups the clustering depends on
+    static uint64_t topologyHash(const Mesh& mesh);
+    /// sort the faces and cut them into chunks and meshlets
+    void cluster(const Mesh& mesh, size_t facesPerChunk);
+    /// faces in [first, first + count) of meshlet m
+    DrawRange meshletRange(size_t chunk, uint32_t meshlet) const;
+
+    std::vector<Chunk> chunks;
+    /// original index of each face in chunk order
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> faceOrder;
+    /// first face of each meshlet, the meshlet ends where the next one or its chunk ends
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> meshletFaces;
+    uint64_t clusteredHash{0};
+    size_t clusteredChunkSize{0};
+
+    CountedVector<float, MemoryCategory::AccelerationStructures> centerX, centerY, centerZ;
+    CountedVector<float, MemoryCategory::AccelerationStructures> halfX, halfY, halfZ;
+    /// bounding spheres of the meshlets
+    CountedVector<float, MemoryCategory::AccelerationStructures> sphereX, sphereY, sphereZ, sphereRadius;
+    /// normal cones of the meshlets: the axis and the sine of the opening angle, above 1 if the cone is useless
+    CountedVector<float, MemoryCategory::AccelerationStructures> coneX, coneY, coneZ, coneCutoff;
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> visible;
+    size_t visibleMeshlets{0};
+    size_t visibleFaces{0};
+    size_t occluded{0};
+};
+
+#endif // MESHCHUNKS_H
@@ -0,0 +1,63 @@
+#ifndef MESHDISTANCE_H
+#define MESHDISTANCE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "mesh.h"
+
+/// how two meshes are compared
+struct MeshDistanceSettings {
+    /// area weighted points sampled on each mesh
+    size_t samples{1'000'000};
+    uint64_t seed{0};
+    /// also return the distance of every vertex, for MeshCanvas::set_vertex_values
+    bool vertexErrors{true};
+};
+
+/// distances from the surface of one mesh to the surface of another
+struct SurfaceDistance {
+    /// number of surface samples the mean and the root mean square are taken over
+    size_t samples{0};
+    double mean{0.0};
+    double rms{0.0};
+    /// the largest distance of a sample or a vertex, the one-sided Hausdorff distance
+    float max{0.0f};
+};
+
+/// the result of compareMeshes() for the meshes a and b
+struct MeshDistance {
+    /// from the surface of a to b, and from b to a
+    SurfaceDistance forward, backward;
+    /// distance of every vertex of a to b and of every vertex of b to a, empty unless requested,
+    /// 0 for vertices no face uses
+    std::vector<float> vertexErrorsA, vertexErrorsB;
+
+    /// the symmetric Hausdorff distance
+    float hausdorff() const { return std::max(forward.max, backward.max); }
+    /// the root mean square distance over the samples of both directions
+    double rms() const;
+};
+
+/**
+ * @brief symmetric Hausdorff and RMS distance between two surfaces, e.g. a mesh and its decimated or compressed version
+ *
+ * points are sampled on each mesh by face area and their closest points are looked up in a BVH of
+ * the other mesh, spread over all cores. the samples are sorted by face so consecutive queries are
+ * close, and the distance of the previous query plus the way to the next point bounds the search
+ * of the next. the maximum also includes the vertices used by faces, where the largest deviations
+ * of a coarse mesh usually sit, vertices without faces are ignored. both meshes need up to date
+ * face areas and at least one face with area.
+ *
+ * @param bvhA, bvhB BVHs built over the faces of a and b
+ */
+MeshDistance compareMeshes(const Mesh& a, const TriangleBVH& bvhA, const Mesh& b, const TriangleBVH& bvhB,
+                           const MeshDistanceSettings& settings = {});
+
+/// compare two meshes with BVHs built for the purpose
+MeshDistance compareMeshes(const Mesh& a, const Mesh& b, const MeshDistanceSettings& settings = {});
+
+#endif // MESHDISTANCE_H
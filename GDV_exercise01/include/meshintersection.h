@@ -0,0 +1,63 @@
+#ifndef MESHINTERSECTION_H
+#define MESHINTERSECTION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "mesh.h"
+
+/// two intersecting faces, of the meshes a and b, or of the same mesh with a < b
+struct FacePair {
+    uint32_t a, b;
+
+    bool operator==(const FacePair& other) const = default;
+};
+
+/// a straight piece of the curve where two surfaces cross
+struct LineSegment {
+    Point3D start, end;
+};
+
+/// the result of intersectMeshes() and selfIntersections()
+struct MeshIntersection {
+    /// sorted by the first and then the second face
+    std::vector<FacePair> pairs;
+    /// where the faces of each pair cross, empty unless requested
+    std::vector<LineSegment> segments;
+
+    bool empty() const { return pairs.empty(); }
+};
+
+/**
+ * @brief all pairs of intersecting faces of two meshes
+ *
+ * both BVHs are descended together, always splitting the larger of two overlapping nodes. the
+ * overlapping node pairs of the top levels are dealt out to all cores. a face of one leaf is
+ * tested against all faces of the other leaf at once with plain loops the compiler vectorizes:
+ * pairs where one face lies strictly on one side of the plane of the other are rejected, and the
+ * rest get the interval test of Moeller (1997) along the line where the planes meet. faces which
+ * only touch count as intersecting. coplanar faces intersect if they overlap in an area, their
+ * segment is a single point of the overlap. faces without area never intersect.
+ *
+ * @param bvhA, bvhB BVHs built over the faces of a and b, refitted if the vertices were transformed
+ * @param segments also return the segment where the faces of each pair cross
+ */
+MeshIntersection intersectMeshes(const Mesh& a, const TriangleBVH& bvhA, const Mesh& b, const TriangleBVH& bvhB,
+                                 bool segments = false);
+
+/// intersect two meshes with BVHs built for the purpose
+MeshIntersection intersectMeshes(const Mesh& a, const Mesh& b, bool segments = false);
+
+/**
+ * @brief all pairs of faces of a mesh which cross each other, like intersectMeshes() against itself
+ * faces sharing a vertex only count if they cross in more than that vertex, e.g. where the surface
+ * folds over, faces sharing an edge never count. faces only share vertices with the same index,
+ * so the mesh should be welded first
+ */
+MeshIntersection selfIntersections(const Mesh& mesh, const TriangleBVH& bvh, bool segments = false);
+
+/// find the self-intersections with a BVH built for the purpose
+MeshIntersection selfIntersections(const Mesh& mesh, bool segments = false);
+
+#endif // MESHINTERSECTION_H
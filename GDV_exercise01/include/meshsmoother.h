@@ -0,0 +1,78 @@
+#ifndef MESHSMOOTHER_H
+#define MESHSMOOTHER_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "mesh.h"
+
+/// how the neighbors of a vertex are weighted by the smoother
+enum class SmoothingWeights {
+    /// every neighbor counts the same
+    Uniform,
+    /// cotangents of the angles opposite of the edge, negative weights of obtuse triangles are clamped to 0
+    Cotangent
+};
+
+/**
+ * @brief Laplacian and Taubin smoothing of the vertex positions of a mesh
+ *
+ * the vertex adjacency is built once as a sparse matrix in CSR layout with
+ * rows normalized to a sum of 1, every iteration is a matrix-vector product
+ * over the positions stored as separate x, y and z arrays. the weights are
+ * computed from the positions at build time and stay fixed while smoothing.
+ *
+ * vertices on the boundary or at non-manifold edges can be locked, locked
+ * vertices and vertices without faces keep their positions.
+ */
+class MeshSmoother {
+public:
+    MeshSmoother() = default;
+    MeshSmoother(const Mesh& mesh, SmoothingWeights weights, bool lockBoundary = true)
+    {
+        build(mesh, weights, lockBoundary);
+    }
+
+    /// build the weighted adjacency of the vertices of the given mesh
+    void build(const Mesh& mesh, SmoothingWeights weights, bool lockBoundary = true);
+
+    /**
+     * @brief move every vertex towards the weighted average of its neighbors
+     * p' = p + lambda * (average - p), bounds, face areas and normals are re-computed
+     * @param mesh a mesh with the faces the smoother was built for
+     * @param iterations number of smoothing steps
+     * @param lambda step size, between 0 and 1
+     */
+    void laplacian(Mesh& mesh, unsigned iterations, float lambda = 0.5f) const;
+
+    /**
+     * @brief Taubin smoothing, every iteration is a Laplacian step with lambda followed by
+     * one with the negative mu which inflates the mesh again, so it does not shrink
+     * @param mesh a mesh with the faces the smoother was built for
+     * @param iterations number of pairs of steps
+     * @param lambda shrinking step size, between 0 and 1
+     * @param mu inflating step size, negative with |mu| slightly larger than lambda
+     */
+    void taubin(Mesh& mesh, unsigned iterations, float lambda = 0.5f, float mu = -0.53f) const;
+
+    size_t numVertices() const { return rowStarts.empty() ? 0 : rowStarts.size() - 1; }
+    /// number of stored neighbor entries
+    size_t numEntries() const { return columns.size(); }
+    /// number of locked vertices
+    size_t numLocked() const { return lockedVertices; }
+
+private:
+    /// run the given sequence of step sizes iterations times
+    void smooth(Mesh& mesh, unsigned iterations, std::initializer_list<float> steps) const;
+
+    /// first entry of each row, the entries of vertex v are [rowStarts[v], rowStarts[v+1])
+    std::vector<uint32_t> rowStarts;
+    /// neighbor vertex per entry
+    std::vector<uint32_t> columns;
+    /// normalized weight per entry
+    std::vector<float> weights;
+    size_t lockedVertices{0};
+};
+
+#endif // MESHSMOOTHER_H
@@ -0,0 +1,94 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "aabb.h"
+#include "memorystats.h"
+#include "mesh.h"
+
+/**
+ * @brief software occlusion culling against a hierarchical depth buffer
+ *
+ * setOccluders() keeps the largest faces of a mesh. render() hands a model-view-projection
+ * matrix to a worker thread, which rasterizes the occluders into a small depth buffer and
+ * builds a pyramid of it where every texel holds the farthest depth of the four below it.
+ * the main thread can meanwhile do other work, e.g. frustum culling, and calls wait()
+ * before testing bounding boxes with visible().
+ *
+ * the rasterizer fills the pixel centers inside each triangle one row span at a time, the
+ * spans are plain loops the compiler vectorizes. back faces are skipped like the canvas culls
+ * them, so open surfaces seen from behind hide nothing. a box is occluded if its nearest depth
+ * is behind the farthest depth of all texels it covers on the pyramid level where it spans at
+ * most two texels per axis. boxes are only rejected by occluders in front of them at the
+ * pixel centers, so a box seen through gaps narrower than a pixel may be culled.
+ */
+class OcclusionCuller {
+public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    /// use the largest maxTriangles faces of the mesh as occluders, in the coordinates of the mesh
+    void setOccluders(const Mesh& mesh, size_t maxTriangles = 16384);
+
+    /**
+     * @brief start rendering the occluders with the matrix into a width x height depth buffer
+     * returns immediately, a render still running is waited for first
+     */
+    void render(const nanogui::Matrix4f& mvp, uint32_t width, uint32_t height);
+    /// wait until the last render() is done, re-throws exceptions of the worker
+    void wait();
+
+    /**
+     * @brief false if the box is certainly hidden behind the occluders of the last render()
+     * boxes crossing the near plane are always visible, only call this after wait()
+     */
+    bool visible(const AABB& box) const;
+
+    size_t numOccluders() const { return occluderX.size() / 3; }
+    /// time the worker needed for the last render()
+    double renderMilliseconds() const { return lastRenderTime; }
+
+private:
+    /// the worker thread waits for jobs until the culler is destroyed
+    void run();
+    void rasterize();
+    void buildPyramid();
+    /// fill the pixel centers inside a triangle with screen coordinates and depth
+    void rasterizeTriangle(const float* x, const float* y, const float* z);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool pending{false};
+    bool stop{false};
+    std::exception_ptr error;
+
+    nanogui::Matrix4f mvp{1.0f};
+    uint32_t width{0}, height{0};
+    /// written by the worker, read by renderMilliseconds() at any time
+    std::atomic<double> lastRenderTime{0.0};
+
+    /// three consecutive vertices per occluder triangle
+    CountedVector<float, MemoryCategory::AccelerationStructures> occluderX, occluderY, occluderZ;
+    /// clip coordinates of the occluder vertices
+    CountedVector<float, MemoryCategory::Temporary> clipX, clipY, clipZ, clipW;
+    /// pixel coordinates and depth of the occluder vertices in front of the camera
+    CountedVector<float, MemoryCategory::Temporary> screenX, screenY, screenZ;
+    /// the depth buffer followed by coarser levels, each texel the maximum of up to 2x2 texels of the level below
+    std::vector<CountedVector<float, MemoryCategory::AccelerationStructures>> levels;
+    std::vector<uint32_t> levelWidth, levelHeight;
+
+    /// started last, after everything it uses is constructed
+    std::thread worker;
+};
+
+#endif // OCCLUSIONCULLER_H
@@ -0,0 +1,158 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief small helpers to spread loops over all cores
+ *
+ * the helpers spawn plain std::threads per call, so they are meant for loops
+ * that run for at least a few hundred microseconds
+ */
+
+/// number of threads used by the parallel helpers
+inline size_t numThreads()
+{
+    static const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    return threads;
+}
+
+/// number of chunks parallelFor splits count items into if each chunk has at least minChunk items
+inline size_t chunkCount(size_t count, size_t minChunk = 4096)
+{
+    return std::clamp<size_t>((count + minChunk - 1) / std::max<size_t>(minChunk, 1), 1, numThreads());
+}
+
+/**
+ * @brief call f(chunk, begin, end) for each of the given number of chunks of [0, count)
+ * in parallel, chunk c covers [count*c/chunks, count*(c+1)/chunks)
+ *
+ * exceptions thrown by f are re-thrown on the calling thread after all chunks are done
+ */
+template <typename F>
+void parallelForChunks(size_t count, size_t chunks, F&& f)
+{
+    if (chunks <= 1) {
+        f(size_t{0}, size_t{0}, count);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto run = [&](size_t chunk) -> void {
+        try {
+            f(chunk, count * chunk / chunks, count * (chunk + 1) / chunks);
+        }
+        catch (...) {
+            std::lock_guard lock{errorMutex};
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t chunk = 1; chunk < chunks; ++chunk)
+        workers.emplace_back(run, chunk);
+    run(0);
+    for (auto& worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/// call f(begin, end) for consecutive ranges of [0, count) on all cores
+template <typename F>
+void parallelFor(size_t count, F&& f, size_t minChunk = 4096)
+{
+    if (!count)
+        return;
+    parallelForChunks(count, chunkCount(count, minChunk),
+                      [&](size_t, size_t begin, size_t end) -> void { f(begin, end); });
+}
+
+/// sort [first, last) by sorting one range per thread and merging them pairwise
+template <typename RandomIt, typename Compare = std::less<>>
+void parallelSort(RandomIt first, RandomIt last, Compare comp = {})
+{
+    const size_t count = static_cast<size_t>(last - first);
+    const size_t chunks = chunkCount(count, size_t{1} << 15);
+    if (chunks <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    auto bound = [&](size_t chunk) -> RandomIt { return first + count * std::min(chunk, chunks) / chunks; };
+
+    parallelForChunks(chunks, chunks, [&](size_t chunk, size_t, size_t) -> void {
+        std::sort(bound(chunk), bound(chunk + 1), comp);
+    });
+
+    for (size_t width = 1; width < chunks; width *= 2) {
+        const size_t merges = (chunks + 2 * width - 1) / (2 * width);
+        parallelForChunks(merges, merges, [&](size_t merge, size_t, size_t) -> void {
+            const size_t begin = merge * 2 * width;
+            if (begin + width < chunks)
+                std::inplace_merge(bound(begin), bound(begin + width), bound(begin + 2 * width), comp);
+        });
+    }
+}
+
+/**
+ * @brief stable LSD radix sort of [data, data + count) by the lowest keyBits bits of key(element)
+ * scratch must have room for count elements, every pass sorts 8 bits with per chunk histograms,
+ * passes in which all keys share the same digit are skipped
+ */
+template <typename T, typename Key>
+void parallelRadixSort(T* data, T* scratch, size_t count, Key&& key, unsigned keyBits = 64)
+{
+    constexpr size_t radix = 256;
+    const size_t chunks = chunkCount(count, size_t{1} << 14);
+    std::vector<std::array<size_t, radix>> offsets(chunks);
+
+    T* source = data;
+    T* target = scratch;
+    for (unsigned shift = 0; shift < keyBits; shift += 8) {
+        parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+            std::array<size_t, radix>& histogram = offsets[chunk];
+            histogram.fill(0);
+            for (size_t i = begin; i < end; ++i)
+                ++histogram[(key(source[i]) >> shift) & (radix - 1)];
+        });
+
+        // digit major, chunk minor exclusive prefix sum keeps the order stable
+        size_t total = 0;
+        bool sorted = false;
+        for (size_t digit = 0; digit < radix && !sorted; ++digit) {
+            size_t digitCount = 0;
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                const size_t n = offsets[chunk][digit];
+                offsets[chunk][digit] = total;
+                total += n;
+                digitCount += n;
+            }
+            sorted = digitCount == count;
+        }
+        if (sorted)
+            continue;
+
+        parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+            std::array<size_t, radix>& next = offsets[chunk];
+            for (size_t i = begin; i < end; ++i)
+                target[next[(key(source[i]) >> shift) & (radix - 1)]++] = source[i];
+        });
+        std::swap(source, target);
+    }
+
+    if (source != data)
+        parallelFor(count, [&](size_t begin, size_t end) -> void { std::copy(source + begin, source + end, data + begin); });
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,82 @@
+#ifndef PATHTRACER_H
+#define PATHTRACER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "camera.h"
+#include "memorystats.h"
+#include "mesh.h"
+#include "random.h"
+
+/// what the path tracer renders, the colors are linear
+struct PathTracerSettings {
+    uint32_t width{800};
+    uint32_t height{600};
+    /// diffuse bounces after the first hit
+    uint32_t maxBounces{6};
+    /// diffuse reflectance of the mesh, the foreground color of the canvas
+    Point3D albedo{0.376f, 0.013f, 0.038f};
+    /// radiance of the environment, the background color of the canvas
+    Point3D environment{0.456f, 0.351f, 0.141f};
+    /// direction towards the sun in world space, and its radiance
+    Point3D sunDirection{-0.4f, 1.0f, -0.6f};
+    Point3D sunRadiance{2.5f};
+    /// edge length of the square tiles the image is split into for the threads
+    uint32_t tileSize{16};
+};
+
+/**
+ * @brief progressive path tracer for a mesh seen through the camera of MeshCanvas
+ *
+ * the mesh is diffuse, lit by a uniform environment and a sun, and flat or smooth shaded like
+ * in the canvas. every renderPass() adds one sample to each pixel. the image is cut into
+ * tiles which are dealt out to one queue per thread, a thread that runs out of tiles steals
+ * from the end of the other queues. primary rays of 4x2 pixels are traced as a RayPacket,
+ * the diverging bounce and shadow rays one by one. every pixel and pass has its own random
+ * sequence, so the image does not depend on the number of threads.
+ *
+ * the mesh must outlive the tracer.
+ */
+class PathTracer {
+public:
+    PathTracer(const Mesh& mesh, const ViewSetup& view, const PathTracerSettings& settings = {});
+
+    /// add one sample to every pixel using all cores
+    void renderPass();
+
+    /// the mean of all samples, three floats per pixel with the rows from top to bottom
+    std::vector<float> image() const;
+
+    uint32_t numPasses() const { return passes; }
+    /// rays traced in all passes, counting primary, bounce and shadow rays
+    uint64_t numRays() const { return rays; }
+    const PathTracerSettings& getSettings() const { return settings; }
+
+private:
+    /// render one sample of every pixel of the tile, returns the number of rays
+    uint64_t renderTile(uint32_t tile);
+    /// the ray through a point on the image plane, in the coordinates of the mesh
+    Ray cameraRay(float x, float y) const;
+    /// radiance along a path starting with the given ray and its first hit
+    Point3D tracePath(Ray ray, RayHit hit, PCG32& random, uint64_t& rayCount) const;
+
+    const Mesh& mesh;
+    TriangleBVH bvh;
+    PathTracerSettings settings;
+    /// from clip space into the coordinates of the mesh
+    nanogui::Matrix4f inverseMvp;
+    /// the sun direction in the coordinates of the mesh
+    Point3D sun;
+    /// offset of secondary rays from the surface
+    float epsilon;
+    /// whether each face is smooth shaded
+    CountedVector<uint8_t, MemoryCategory::Temporary> smooth;
+    /// sum of the samples of each pixel
+    CountedVector<float, MemoryCategory::Temporary> accumulated;
+    uint32_t passes{0};
+    uint64_t rays{0};
+};
+
+#endif // PATHTRACER_H
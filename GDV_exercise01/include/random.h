@@ -0,0 +1,45 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <bit>
+#include <cstdint>
+
+/// finalizer of splitmix64, every bit of x affects every bit of the result
+inline uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/// PCG32 random number generator (O'Neill 2014, XSH RR variant), independent sequences per stream
+class PCG32 {
+public:
+    explicit PCG32(uint64_t seed = 0, uint64_t stream = 0) : increment{(stream << 1) | 1}
+    {
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next()
+    {
+        const uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        const uint32_t shifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        const uint32_t rotation = static_cast<uint32_t>(old >> 59);
+        return std::rotr(shifted, static_cast<int>(rotation));
+    }
+
+    /// uniform float in [0, 1)
+    float nextFloat() { return static_cast<float>(next() >> 8) * 0x1p-24f; }
+
+    /// uniform integer in [0, bound)
+    uint32_t nextBelow(uint32_t bound) { return static_cast<uint32_t>((uint64_t{next()} * bound) >> 32); }
+
+private:
+    uint64_t state{0};
+    uint64_t increment;
+};
+
+#endif // RANDOM_H
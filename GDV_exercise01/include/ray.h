@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+
+#include "aabb.h"
+
+/// the points origin + t * direction with t in [tMin, tMax]
+struct Ray {
+    Point3D origin;
+    Point3D direction;
+    float tMin{0.0f};
+    float tMax{std::numeric_limits<float>::infinity()};
+
+    Ray() = default;
+    Ray(const Point3D& origin, const Point3D& direction,
+        float tMin = 0.0f, float tMax = std::numeric_limits<float>::infinity())
+        : origin{origin}, direction{direction}, tMin{tMin}, tMax{tMax} {}
+
+    /// the point at parameter t
+    Point3D at(float t) const { return origin + direction * t; }
+};
+
+/// the closest intersection of a ray with a triangle mesh
+struct RayHit {
+    static constexpr uint32_t none = UINT32_MAX;
+
+    /// ray parameter of the hit point
+    float t{std::numeric_limits<float>::infinity()};
+    /// the face that was hit, or none
+    uint32_t face{none};
+    /// barycentric coordinates of the hit point, the weights of the second and third vertex
+    float u{0.0f}, v{0.0f};
+
+    bool found() const { return face != none; }
+};
+
+/**
+ * @brief Möller-Trumbore ray triangle intersection, both sides of the triangle are hit
+ * @return true and the ray parameter and barycentric coordinates if the ray hits the triangle inside [tMin, tMax]
+ */
+inline bool intersectTriangle(const Ray& ray, const Point3D& p0, const Point3D& p1, const Point3D& p2,
+                              float& t, float& u, float& v)
+{
+    const Point3D e1 = p1 - p0;
+    const Point3D e2 = p2 - p0;
+    const Point3D p = cross(ray.direction, e2);
+    const float determinant = dot(e1, p);
+    if (determinant == 0.0f)
+        return false;
+    const float invDeterminant = 1.0f / determinant;
+
+    const Point3D s = ray.origin - p0;
+    u = dot(s, p) * invDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    const Point3D q = cross(s, e1);
+    v = dot(ray.direction, q) * invDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    t = dot(e2, q) * invDeterminant;
+    return t >= ray.tMin && t <= ray.tMax;
+}
+
+/**
+ * @brief slab test of a ray against a bounding box
+ * @param invDirection component-wise reciprocal of the ray direction
+ * @return the ray parameter where the ray enters the box, infinity if it misses the box inside [tMin, tMax]
+ */
+inline float intersectAABB(const AABB& box, const Ray& ray, const Point3D& invDirection)
+{
+    const Point3D t0 = (box.min - ray.origin) * invDirection;
+    const Point3D t1 = (box.max - ray.origin) * invDirection;
+    const Point3D tNear = min(t0, t1);
+    const Point3D tFar = max(t0, t1);
+    const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, ray.tMin));
+    const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, ray.tMax));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+/**
+ * @brief a direction around the unit normal with a density proportional to the cosine
+ * @param r1, r2 uniform numbers in [0, 1), r1 picks the angle to the normal and r2 the angle around it
+ */
+inline Point3D cosineDirection(const Point3D& normal, float r1, float r2)
+{
+    // orthonormal basis (Duff et al. 2017)
+    const float sign = std::copysign(1.0f, normal.z);
+    const float a = -1.0f / (sign + normal.z);
+    const float b = normal.x * normal.y * a;
+    const Point3D tangent{1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x};
+    const Point3D bitangent{b, sign + normal.y * normal.y * a, -normal.y};
+
+    const float radius = std::sqrt(r1);
+    const float phi = 2.0f * std::numbers::pi_v<float> * r2;
+    return tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi))
+         + normal * std::sqrt(std::max(0.0f, 1.0f - r1));
+}
+
+/**
+ * @brief a packet of coherent rays, e.g. primary rays of neighboring pixels, traced together
+ *
+ * the rays and their closest hits are kept as separate arrays per component, so the box
+ * and triangle tests of all rays are branch-free loops the compiler vectorizes. unused
+ * rays have an empty interval and never hit anything.
+ */
+struct RayPacket {
+    static constexpr size_t size = 8;
+
+    float originX[size], originY[size], originZ[size];
+    float directionX[size], directionY[size], directionZ[size];
+    float tMin[size], tMax[size];
+    /// the closest hits: tMax is the ray parameter, face is RayHit::none for misses
+    uint32_t face[size];
+    float u[size], v[size];
+
+    RayPacket() { clear(); }
+
+    /// make all rays unused
+    void clear()
+    {
+        for (size_t i = 0; i < size; ++i) {
+            originX[i] = originY[i] = originZ[i] = directionX[i] = directionY[i] = 0.0f;
+            directionZ[i] = 1.0f;
+            tMin[i] = 1.0f;
+            tMax[i] = 0.0f;
+            face[i] = RayHit::none;
+            u[i] = v[i] = 0.0f;
+        }
+    }
+
+    void set(size_t i, const Ray& ray)
+    {
+        originX[i] = ray.origin.x;
+        originY[i] = ray.origin.y;
+        originZ[i] = ray.origin.z;
+        directionX[i] = ray.direction.x;
+        directionY[i] = ray.direction.y;
+        directionZ[i] = ray.direction.z;
+        tMin[i] = ray.tMin;
+        tMax[i] = ray.tMax;
+        face[i] = RayHit::none;
+    }
+
+    /// the closest hit of ray i after tracing
+    RayHit hit(size_t i) const
+    {
+        if (face[i] == RayHit::none)
+            return {};
+        return {tMax[i], face[i], u[i], v[i]};
+    }
+};
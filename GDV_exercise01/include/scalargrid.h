@@ -0,0 +1,62 @@
+#ifndef SCALARGRID_H
+#define SCALARGRID_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "memorystats.h"
+#include "point3d.h"
+
+/// sample type of a raw volume file
+enum class VoxelFormat { UInt8, UInt16, Float32 };
+
+/**
+ * @brief a dense regular grid of scalar samples, e.g. a CT or MRI volume
+ * the samples are stored with x running fastest, then y, then z
+ */
+class ScalarGrid {
+public:
+    ScalarGrid() = default;
+    /// a grid of the given number of samples along x, y and z, all set to value
+    explicit ScalarGrid(const std::array<uint32_t, 3>& dimensions, const Point3D& origin = Point3D{0.0f},
+                        float voxelSize = 1.0f, float value = 0.0f);
+
+    /**
+     * @brief load a headerless little endian volume like the classic CT and MRI data sets
+     * throws std::runtime_error if the file cannot be read or its size does not match
+     * @param dimensions number of samples along x, y and z
+     * @param voxelSize distance between neighboring samples, the grid starts at the origin
+     */
+    void loadRaw(const std::string& filename, const std::array<uint32_t, 3>& dimensions, VoxelFormat format,
+                 float voxelSize = 1.0f);
+
+    /// number of samples along x, y and z
+    const std::array<uint32_t, 3>& dimensions() const { return size; }
+    float voxelSize() const { return spacing; }
+    /// position of the sample (0, 0, 0)
+    const Point3D& origin() const { return start; }
+    /// position of a sample
+    Point3D position(uint32_t x, uint32_t y, uint32_t z) const
+    {
+        return start + Point3D{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)} * spacing;
+    }
+
+    /// get a sample for reading
+    float at(uint32_t x, uint32_t y, uint32_t z) const { return values[(size_t{z} * size[1] + y) * size[0] + x]; }
+    /// get a sample for writing
+    float& at(uint32_t x, uint32_t y, uint32_t z) { return values[(size_t{z} * size[1] + y) * size[0] + x]; }
+
+    /// get all samples for reading
+    const CountedVector<float, MemoryCategory::DistanceFields>& getValues() const { return values; }
+    /// get all samples for writing
+    CountedVector<float, MemoryCategory::DistanceFields>& getValues() { return values; }
+
+private:
+    std::array<uint32_t, 3> size{0, 0, 0};
+    Point3D start{0.0f};
+    float spacing{1.0f};
+    CountedVector<float, MemoryCategory::DistanceFields> values;
+};
+
+#endif // SCALARGRID_H
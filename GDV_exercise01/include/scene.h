@@ -0,0 +1,109 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "bvh.h"
+#include "frustum.h"
+#include "memorystats.h"
+#include "mesh.h"
+#include "transform.h"
+
+/// the closest intersection of a ray with the instances of a scene, face and barycentrics refer to the instance's mesh
+struct SceneHit : RayHit {
+    uint32_t instance{none};
+};
+
+/**
+ * @brief many meshes placed by instances with their own transformation
+ *
+ * every mesh gets a TriangleBVH (bottom level) once when it is added. update() builds
+ * the top level BVH over the world bounds of the instances as a linear BVH (Karras 2012):
+ * the instances are sorted by the Morton code of their centers, and all inner nodes
+ * and then all bounds are computed in parallel, so the top level can be rebuilt every
+ * frame. rays are transformed into the space of an instance before its mesh is traced.
+ */
+class Scene {
+public:
+    static constexpr uint32_t invalid = UINT32_MAX;
+
+    struct Instance {
+        uint32_t mesh;
+        Transform transform;
+        /// transforms world space into the space of the mesh
+        Transform inverse;
+        /// bounds of the transformed mesh, valid after update()
+        AABB bounds;
+    };
+
+    /// an inner node of the top level, children with the leaf bit set are positions in the sorted instances
+    struct TopNode {
+        static constexpr uint32_t leafBit = 0x80000000u;
+
+        AABB bounds;
+        uint32_t left{invalid};
+        uint32_t right{invalid};
+        uint32_t parent{invalid};
+        /// the range [first, last] of the sorted instances below this node
+        uint32_t first{0}, last{0};
+    };
+
+    /// add a mesh and build its BVH, returns the index instances use to reference it
+    uint32_t addMesh(Mesh mesh);
+    /// place a mesh in the scene, returns the index of the instance
+    uint32_t addInstance(uint32_t mesh, const Transform& transform = {});
+    /// move an instance, queries need an update() afterwards
+    void setTransform(uint32_t instance, const Transform& transform);
+
+    /// recompute the world bounds of all instances and rebuild the top level BVH
+    void update();
+
+    /// find the closest hit of the ray with any instance, returns whether there is one
+    bool intersect(const Ray& ray, SceneHit& hit) const;
+    /// checks whether the ray hits any instance inside [tMin, tMax]
+    bool occluded(const Ray& ray) const;
+    /// trace all rays in parallel, hits must have the same size as rays
+    void intersect(std::span<const Ray> rays, std::span<SceneHit> hits) const;
+    /// test all rays for occlusion in parallel, occluded must have the same size as rays
+    void occluded(std::span<const Ray> rays, std::span<uint8_t> occluded) const;
+
+    /// the instances whose bounds intersect the frustum, in the order of the top level
+    std::vector<uint32_t> cull(const Frustum& frustum) const;
+
+    size_t numMeshes() const { return meshes.size(); }
+    size_t numInstances() const { return instances.size(); }
+    const Mesh& getMesh(uint32_t mesh) const { return meshes.at(mesh)->mesh; }
+    const TriangleBVH& getMeshBVH(uint32_t mesh) const { return meshes.at(mesh)->bvh; }
+    const Instance& getInstance(uint32_t instance) const { return instances.at(instance); }
+    const CountedVector<TopNode, MemoryCategory::AccelerationStructures>& getTopNodes() const { return topNodes; }
+    /// bounds of all instances, valid after update()
+    AABB getBounds() const { return topNodes.empty() ? AABB{} : topNodes[0].bounds; }
+
+private:
+    struct SceneMesh {
+        Mesh mesh;
+        TriangleBVH bvh;
+    };
+
+    /// throws if instances were added or moved since the last update()
+    void checkUpdated() const;
+    /// bounds of a child reference of a top level node
+    const AABB& childBounds(uint32_t child) const;
+    /// closest hit with one instance, shortens current.tMax
+    bool intersectInstance(uint32_t instance, Ray& current, SceneHit& hit) const;
+
+    /// the meshes need stable addresses for their BVHs
+    std::vector<std::unique_ptr<SceneMesh>> meshes;
+    std::vector<Instance> instances;
+    CountedVector<TopNode, MemoryCategory::AccelerationStructures> topNodes;
+    /// instance indices sorted along the Morton curve, the leaves of the top level
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> sortedInstances;
+    /// parent of each leaf
+    CountedVector<uint32_t, MemoryCategory::AccelerationStructures> leafParents;
+    bool updated{true};
+};
+
+#endif // SCENE_H
@@ -0,0 +1,107 @@
+#ifndef SIGNEDDISTANCEFIELD_H
+#define SIGNEDDISTANCEFIELD_H
+
+#include <array>
+#include <cstdint>
+
+#include "bvh.h"
+#include "memorystats.h"
+#include "mesh.h"
+
+/// the grid a signed distance field is sampled on
+struct DistanceFieldSettings {
+    /// voxels along the longest side of the bounds of the mesh
+    uint32_t resolution{64};
+    /// voxels added around the bounds on every side, so the surface is closed inside the grid
+    uint32_t padding{2};
+    /**
+     * only blocks within this many voxel sizes of the surface store their voxels, the others
+     * hold the band distance with the sign of their center; 0 stores all blocks
+     */
+    float narrowBand{0.0f};
+};
+
+/**
+ * @brief signed distances from the voxels of a regular grid to the surface of a mesh
+ *
+ * the voxels are samples at the corners of the cells, with negative distances inside. they
+ * are stored in blocks of 8^3 voxels with x running fastest, so neighbors in all three
+ * directions are mostly in the same few cache lines. with a narrow band, blocks far from
+ * the surface store a single value, which makes the field sparse.
+ *
+ * the blocks are filled in parallel. distances come from closest point queries on a
+ * TriangleBVH, bounded by the distance of the previous voxel plus the voxel size since the
+ * distance changes by at most that much. the sign comes from the generalized winding
+ * number (Jacobson et al. 2013), which also works for meshes with holes, evaluated with the
+ * dipole approximation for BVH nodes far from the voxel (Barill et al. 2018). a voxel
+ * farther from the surface than the voxel size has the sign of the previous one, so the
+ * winding number is only needed near the surface.
+ */
+class SignedDistanceField {
+public:
+    static constexpr uint32_t blockSize = 8;
+    static constexpr uint32_t blockVoxels = blockSize * blockSize * blockSize;
+
+    SignedDistanceField() = default;
+    /// sample the mesh with a BVH built for the purpose
+    explicit SignedDistanceField(const Mesh& mesh, const DistanceFieldSettings& settings = {});
+
+    /**
+     * @brief sample the distances to the faces of the mesh
+     * throws std::runtime_error if the BVH is not built over the mesh, the mesh has no faces or
+     * the grid would be too large
+     */
+    void build(const Mesh& mesh, const TriangleBVH& bvh, const DistanceFieldSettings& settings = {});
+
+    /// number of voxels along x, y and z
+    const std::array<uint32_t, 3>& dimensions() const { return size; }
+    float voxelSize() const { return spacing; }
+    /// position of the voxel (0, 0, 0)
+    const Point3D& origin() const { return start; }
+    /// position of a voxel
+    Point3D position(uint32_t x, uint32_t y, uint32_t z) const
+    {
+        return start + Point3D{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)} * spacing;
+    }
+
+    /// the distance stored for a voxel, narrow band distances are clamped to the band
+    float at(uint32_t x, uint32_t y, uint32_t z) const
+    {
+        const uint32_t block = (z / blockSize * blocks[1] + y / blockSize) * blocks[0] + x / blockSize;
+        const uint32_t slot = blockSlots[block];
+        if (slot == uniform)
+            return uniformValues[block];
+        return values[size_t{slot} * blockVoxels + ((z % blockSize) * blockSize + y % blockSize) * blockSize + x % blockSize];
+    }
+
+    /// trilinear interpolation of the voxels, points outside are clamped to the grid
+    float sample(const Point3D& p) const;
+    /// gradient of the trilinear interpolation, points away from the surface outside of it
+    Point3D gradient(const Point3D& p) const;
+
+    size_t numBlocks() const { return blockSlots.size(); }
+    /// blocks which store their voxels
+    size_t numStoredBlocks() const { return values.size() / blockVoxels; }
+    /// winding number evaluations needed for the signs by the last build()
+    size_t numWindingNumbers() const { return windingNumbers; }
+
+private:
+    static constexpr uint32_t uniform = UINT32_MAX;
+
+    /// the cell containing p, clamped to the grid, and the position inside it
+    void locate(const Point3D& p, std::array<uint32_t, 3>& cell, Point3D& fraction) const;
+
+    std::array<uint32_t, 3> size{0, 0, 0};
+    std::array<uint32_t, 3> blocks{0, 0, 0};
+    Point3D start{0.0f};
+    float spacing{1.0f};
+    /// per block the index of its voxels in values, or uniform
+    CountedVector<uint32_t, MemoryCategory::DistanceFields> blockSlots;
+    /// per block the distance of all its voxels if it is uniform
+    CountedVector<float, MemoryCategory::DistanceFields> uniformValues;
+    /// the voxels of the stored blocks
+    CountedVector<float, MemoryCategory::DistanceFields> values;
+    size_t windingNumbers{0};
+};
+
+#endif // SIGNEDDISTANCEFIELD_H
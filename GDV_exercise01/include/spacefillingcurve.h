@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "aabb.h"
+
+/// the space filling curves Mesh::reorder can sort along
+enum class SpaceFillingCurve {
+    /// bit interleaving, cheap but with jumps between the octants
+    Morton,
+    /// every step of the curve moves to a neighboring cell
+    Hilbert
+};
+
+/// spread the lowest 21 bits of x so that there are two zero bits between each of them
+inline uint64_t spreadBits3(uint32_t x)
+{
+    uint64_t v = x & 0x1FFFFF;
+    v = (v | v << 32) & 0x1F00000000FFFFull;
+    v = (v | v << 16) & 0x1F0000FF0000FFull;
+    v = (v | v << 8) & 0x100F00F00F00F00Full;
+    v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+/// Morton code of a cell with coordinates of up to 21 bits, x is the most significant axis
+inline uint64_t mortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    return spreadBits3(x) << 2 | spreadBits3(y) << 1 | spreadBits3(z);
+}
+
+/**
+ * @brief Hilbert code of a cell with coordinates of the given number of bits (at most 21)
+ * Skilling's transform turns the coordinates into the transposed Hilbert index, which is
+ * then interleaved like a Morton code
+ */
+inline uint64_t hilbertCode(uint32_t x, uint32_t y, uint32_t z, unsigned bits = 21)
+{
+    uint32_t axes[3] = {x, y, z};
+    const uint32_t highest = 1u << (bits - 1);
+
+    // inverse undo of the excess work: invert the low bits of x if bit q of the axis is set,
+    // otherwise exchange them between x and the axis, written with masks instead of branches
+    for (uint32_t q = highest; q > 1; q >>= 1) {
+        const uint32_t p = q - 1;
+        for (uint32_t& axis : axes) {
+            const uint32_t set = 0u - ((axis & q) != 0);
+            const uint32_t t = (axes[0] ^ axis) & p & ~set;
+            axes[0] ^= (p & set) | t;
+            axis ^= t;
+        }
+    }
+
+    // gray encode
+    axes[1] ^= axes[0];
+    axes[2] ^= axes[1];
+    uint32_t t = 0;
+    for (uint32_t q = highest; q > 1; q >>= 1)
+        if (axes[2] & q)
+            t ^= q - 1;
+    for (uint32_t& axis : axes)
+        axis ^= t;
+
+    return mortonCode(axes[0], axes[1], axes[2]);
+}
+
+/// maps positions inside a bounding box to cells of a 2^bits grid and their curve codes
+class SpaceFillingCurveGrid {
+public:
+    SpaceFillingCurveGrid(const AABB& bounds, SpaceFillingCurve curve, unsigned bits = 21)
+        : origin{bounds.min}, curve{curve}, bits{bits}
+    {
+        const Point3D extents = bounds.extents();
+        const float cells = static_cast<float>((1u << bits) - 1);
+        scale = {extents.x > 0.0f ? cells / extents.x : 0.0f, extents.y > 0.0f ? cells / extents.y : 0.0f,
+                 extents.z > 0.0f ? cells / extents.z : 0.0f};
+    }
+
+    /// the code of the cell containing p, positions outside of the box are clamped, NaN maps to 0
+    uint64_t code(const Point3D& p) const
+    {
+        const float cells = static_cast<float>((1u << bits) - 1);
+        auto cell = [&](float value) -> uint32_t {
+            return static_cast<uint32_t>(value > 0.0f ? std::min(value, cells) : 0.0f);
+        };
+        const Point3D c = (p - origin) * scale;
+        return curve == SpaceFillingCurve::Hilbert ? hilbertCode(cell(c.x), cell(c.y), cell(c.z), bits)
+                                                   : mortonCode(cell(c.x), cell(c.y), cell(c.z));
+    }
+
+private:
+    Point3D origin;
+    Point3D scale;
+    SpaceFillingCurve curve;
+    unsigned bits;
+};
@@ -0,0 +1,61 @@
+#ifndef SURFACESAMPLER_H
+#define SURFACESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+/// a point on the surface of a mesh
+struct SurfaceSample {
+    Vertex position;
+    /// vertex normals interpolated inside smooth groups, the face normal on flat faces
+    Vertex normal;
+    /// index of the face the point lies on
+    uint32_t face;
+};
+
+/**
+ * @brief area weighted random points on the surface of a mesh
+ *
+ * faces are picked in O(1) from a Walker alias table over the face areas,
+ * points inside a face are uniformly distributed. the samples are generated
+ * in blocks with one random stream per block, so the result only depends on
+ * the seed and not on the number of threads.
+ *
+ * the sampler keeps a reference to the mesh, which must outlive it and must
+ * not change its faces.
+ */
+class SurfaceSampler {
+public:
+    /// build the alias table in O(faces), throws std::runtime_error if the mesh has no area
+    explicit SurfaceSampler(const Mesh& mesh);
+
+    /// total surface area of the mesh
+    double totalArea() const { return area; }
+
+    /// count independent uniformly distributed points on the surface
+    std::vector<SurfaceSample> sample(size_t count, uint64_t seed = 0) const;
+
+    /**
+     * @brief blue noise points which are at least radius apart (euclidean distance)
+     * uniform candidates are accepted in order if no accepted point lies within
+     * radius, the neighbors are looked up in a hash grid with cells of size radius
+     * @param radius minimum distance between two points
+     * @param seed
+     * @param oversampling candidates per radius^2 of surface area, more give a denser packing
+     */
+    std::vector<SurfaceSample> samplePoissonDisk(float radius, uint64_t seed = 0, float oversampling = 8.0f) const;
+
+private:
+    const Mesh& mesh;
+    double area{0.0};
+    /// probability of keeping the column's own face instead of its alias
+    std::vector<float> probabilities;
+    /// face picked if the column's own face is rejected
+    std::vector<uint32_t> aliases;
+    /// faces inside a smooth group get interpolated normals
+    std::vector<uint8_t> smooth;
+};
+
+#endif // SURFACESAMPLER_H
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+
+#include "aabb.h"
+
+/// affine transformation p -> x * p.x + y * p.y + z * p.z + translation, x, y and z are the columns of the linear part
+struct Transform {
+    Point3D x{1.0f, 0.0f, 0.0f};
+    Point3D y{0.0f, 1.0f, 0.0f};
+    Point3D z{0.0f, 0.0f, 1.0f};
+    Point3D translation{0.0f};
+
+    static Transform translate(const Point3D& t) { return {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, t}; }
+
+    static Transform scale(const Point3D& s) { return {{s.x, 0.0f, 0.0f}, {0.0f, s.y, 0.0f}, {0.0f, 0.0f, s.z}, {0.0f}}; }
+
+    /// rotation by angle (in radians) around the normalized axis
+    static Transform rotate(const Point3D& axis, float angle)
+    {
+        const float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+        const Point3D a = axis;
+        return {{c + a.x * a.x * t, a.y * a.x * t + a.z * s, a.z * a.x * t - a.y * s},
+                {a.x * a.y * t - a.z * s, c + a.y * a.y * t, a.z * a.y * t + a.x * s},
+                {a.x * a.z * t + a.y * s, a.y * a.z * t - a.x * s, c + a.z * a.z * t},
+                {0.0f}};
+    }
+
+    Point3D applyPoint(const Point3D& p) const { return x * p.x + y * p.y + z * p.z + translation; }
+
+    /// directions are not translated
+    Point3D applyVector(const Point3D& v) const { return x * v.x + y * v.y + z * v.z; }
+
+    /// bounds of the transformed box, computed from its center and half extents (Arvo 1990)
+    AABB apply(const AABB& box) const
+    {
+        if (!(box.min <= box.max))
+            return box;
+        const Point3D center = applyPoint(box.center());
+        const Point3D half = box.extents() * 0.5f;
+        const Point3D radius = abs(x) * half.x + abs(y) * half.y + abs(z) * half.z;
+        return {center - radius, center + radius};
+    }
+
+    /// first apply other, then this transformation
+    Transform operator*(const Transform& other) const
+    {
+        return {applyVector(other.x), applyVector(other.y), applyVector(other.z), applyPoint(other.translation)};
+    }
+
+    /// the inverse transformation, the linear part must not be singular
+    Transform inverse() const
+    {
+        // the rows of the inverse linear part are the cross products of the columns over the determinant
+        const float invDeterminant = 1.0f / dot(x, cross(y, z));
+        const Point3D r0 = cross(y, z) * invDeterminant;
+        const Point3D r1 = cross(z, x) * invDeterminant;
+        const Point3D r2 = cross(x, y) * invDeterminant;
+        Transform inverse{{r0.x, r1.x, r2.x}, {r0.y, r1.y, r2.y}, {r0.z, r1.z, r2.z}, {0.0f}};
+        inverse.translation = -inverse.applyVector(translation);
+        return inverse;
+    }
+};
@@ -0,0 +1,91 @@
+#include "ambientocclusion.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "parallel.h"
+#include "ray.h"
+
+namespace {
+
+/// the step of the second coordinate of the Fibonacci lattice, 1 / golden ratio
+constexpr float fibonacciStep = 0.618033988749895f;
+
+/// a uniform number in [0, 1) from a hash of x (lowbias32 by Chris Wellons)
+float hashToUnit(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return static_cast<float>(x >> 8) * 0x1.0p-24f;
+}
+
+} // namespace
+
+uint64_t bakeAmbientOcclusion(Mesh& mesh, const TriangleBVH& bvh, const AmbientOcclusionSettings& settings)
+{
+    if (bvh.getMesh() != &mesh)
+        throw std::runtime_error("the BVH for baking ambient occlusion must be built over the mesh");
+    if (!settings.rays)
+        throw std::runtime_error("baking ambient occlusion needs at least one ray per vertex");
+
+    const VertexList& vertices = mesh.getVertices();
+    const FaceList& faces = mesh.getFaces();
+
+    // the normals of the mesh may be flat or missing, the rays need the surface around the vertex
+    CountedVector<Point3D, MemoryCategory::Temporary> vertexNormals(vertices.size(), Point3D{0.0f});
+    for (const TriangleIndices& t : faces) {
+        const Point3D normal = cross(vertices[t.v2] - vertices[t.v1], vertices[t.v3] - vertices[t.v1]);
+        vertexNormals[t.v1] += normal;
+        vertexNormals[t.v2] += normal;
+        vertexNormals[t.v3] += normal;
+    }
+
+    const float extent = mesh.getBounds().extents().maxComponent();
+    const float epsilon = 1e-4f * std::max(extent, 1e-20f);
+    const float maxDistance = settings.maxDistance > 0.0f ? settings.maxDistance * extent
+                                                          : std::numeric_limits<float>::infinity();
+    const uint32_t rays = settings.rays;
+    const float invRays = 1.0f / static_cast<float>(rays);
+
+    AmbientOcclusionList occlusion(vertices.size());
+    std::atomic<uint64_t> traced{0};
+    parallelFor(vertices.size(), [&](size_t begin, size_t end) -> void {
+        uint64_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const float length = vertexNormals[i].norm();
+            if (!(length > 0.0f)) {
+                occlusion[i] = 1.0f;
+                continue;
+            }
+            const Point3D normal = vertexNormals[i] / length;
+            const Point3D origin = vertices[i] + normal * epsilon;
+            const float shiftU = hashToUnit(static_cast<uint32_t>(2 * i));
+            const float shiftV = hashToUnit(static_cast<uint32_t>(2 * i + 1));
+            uint32_t open = 0;
+            for (uint32_t r = 0; r < rays; ++r) {
+                float u = (static_cast<float>(r) + 0.5f) * invRays + shiftU;
+                float v = static_cast<float>(r) * fibonacciStep + shiftV;
+                u -= std::floor(u);
+                v -= std::floor(v);
+                open += !bvh.occluded(Ray{origin, cosineDirection(normal, u, v), 0.0f, maxDistance});
+            }
+            occlusion[i] = static_cast<float>(open) * invRays;
+            count += rays;
+        }
+        traced += count;
+    }, 64);
+
+    mesh.getAmbientOcclusion() = std::move(occlusion);
+    return traced;
+}
+
+uint64_t bakeAmbientOcclusion(Mesh& mesh, const AmbientOcclusionSettings& settings)
+{
+    const TriangleBVH bvh{mesh};
+    return bakeAmbientOcclusion(mesh, bvh, settings);
+}
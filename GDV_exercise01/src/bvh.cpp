@@ -0,0 +1,688 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+constexpr uint32_t binCount = 16;
+constexpr float traversalCost = 1.0f;
+constexpr float intersectionCost = 1.0f;
+/// below this depth the builder switches from SAH to median splits, which bounds the tree depth
+constexpr uint32_t sahDepthLimit = 64;
+/// entries of the traversal stack, deeper than any tree the builder creates, restructured trees are checked
+constexpr uint32_t stackSize = 128;
+/// leaves of a treelet, the optimal topology is searched over all 2^7 subsets
+constexpr uint32_t treeletSize = 7;
+
+struct Bin {
+    AABB bounds;
+    uint32_t count{0};
+};
+using Bins = std::array<std::array<Bin, binCount>, 3>;
+
+/// a range of the face order which becomes the subtree of node
+struct BuildTask {
+    uint32_t node;
+    uint32_t begin, end;
+    uint32_t depth;
+};
+
+float component(const Point3D& p, int axis) { return axis == 0 ? p.x : axis == 1 ? p.y : p.z; }
+
+/// squared distance from p to the box, 0 inside
+float distanceSquared(const AABB& box, const Point3D& p)
+{
+    const Point3D d = max(max(box.min - p, p - box.max), Point3D{0.0f});
+    return dot(d, d);
+}
+
+/// the point of the triangle closest to p, by the Voronoi regions of its corners and edges (Ericson 2005)
+Point3D closestPointOnTriangle(const Point3D& p, const Point3D& a, const Point3D& b, const Point3D& c)
+{
+    const Point3D ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return a;
+    const Point3D bp = p - b;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return b;
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+    const Point3D cp = p - c;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return c;
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    // inside the face, degenerate triangles end up here with a zero denominator
+    const float denominator = va + vb + vc;
+    if (!(denominator != 0.0f))
+        return a;
+    const float v = vb / denominator, w = vc / denominator;
+    return a + ab * v + ac * w;
+}
+
+} // namespace
+
+void TriangleBVH::build(const Mesh& newMesh)
+{
+    mesh = &newMesh;
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+    const size_t faceCount = faces.size();
+    if (faceCount >= invalid / 2)
+        throw std::runtime_error("the mesh has too many faces for 32 bit BVH indices");
+
+    nodes.clear();
+    leaves.clear();
+    referenceAreas.clear();
+    builtCost = 0.0f;
+    faceOrder.resize(faceCount);
+    faceOrder.shrink_to_fit();
+    if (!faceCount)
+        return;
+
+    CountedVector<AABB, MemoryCategory::Temporary> faceBounds(faceCount);
+    CountedVector<Point3D, MemoryCategory::Temporary> centroids(faceCount);
+    parallelFor(faceCount, [&](size_t begin, size_t end) -> void {
+        for (size_t f = begin; f < end; ++f) {
+            AABB bounds;
+            bounds.extend(vertices[faces[f].v1]);
+            bounds.extend(vertices[faces[f].v2]);
+            bounds.extend(vertices[faces[f].v3]);
+            faceBounds[f] = bounds;
+            centroids[f] = bounds.center();
+            faceOrder[f] = static_cast<uint32_t>(f);
+        }
+    });
+
+    // large ranges near the root are reduced and binned on all cores
+    auto reduceRange = [&](uint32_t begin, uint32_t end, AABB& bounds, AABB& centroidBounds) -> void {
+        const size_t chunks = chunkCount(end - begin, size_t{1} << 15);
+        std::vector<std::pair<AABB, AABB>> partial(chunks);
+        parallelForChunks(end - begin, chunks, [&](size_t chunk, size_t chunkBegin, size_t chunkEnd) -> void {
+            for (size_t i = begin + chunkBegin; i < begin + chunkEnd; ++i) {
+                partial[chunk].first.extend(faceBounds[faceOrder[i]]);
+                partial[chunk].second.extend(centroids[faceOrder[i]]);
+            }
+        });
+        bounds = centroidBounds = AABB{};
+        for (const auto& [chunkBounds, chunkCentroids] : partial) {
+            bounds.extend(chunkBounds);
+            centroidBounds.extend(chunkCentroids);
+        }
+    };
+    auto binRange = [&](uint32_t begin, uint32_t end, const Point3D& origin, const Point3D& scale) -> Bins {
+        const size_t chunks = chunkCount(end - begin, size_t{1} << 15);
+        std::vector<Bins> partial(chunks);
+        parallelForChunks(end - begin, chunks, [&](size_t chunk, size_t chunkBegin, size_t chunkEnd) -> void {
+            for (size_t i = begin + chunkBegin; i < begin + chunkEnd; ++i) {
+                const uint32_t f = faceOrder[i];
+                const Point3D c = (centroids[f] - origin) * scale;
+                for (int axis = 0; axis < 3; ++axis) {
+                    const uint32_t bin = std::min(binCount - 1, static_cast<uint32_t>(std::max(0.0f, component(c, axis))));
+                    Bin& b = partial[chunk][axis][bin];
+                    b.bounds.extend(faceBounds[f]);
+                    ++b.count;
+                }
+            }
+        });
+        Bins bins = partial[0];
+        for (size_t chunk = 1; chunk < chunks; ++chunk) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (uint32_t bin = 0; bin < binCount; ++bin) {
+                    bins[axis][bin].bounds.extend(partial[chunk][axis][bin].bounds);
+                    bins[axis][bin].count += partial[chunk][axis][bin].count;
+                }
+            }
+        }
+        return bins;
+    };
+
+    nodes.emplace_back();
+    std::vector<BuildTask> stack{{0, 0, static_cast<uint32_t>(faceCount), 0}};
+    while (!stack.empty()) {
+        const BuildTask task = stack.back();
+        stack.pop_back();
+        const uint32_t count = task.end - task.begin;
+
+        AABB bounds, centroidBounds;
+        reduceRange(task.begin, task.end, bounds, centroidBounds);
+        nodes[task.node].bounds = bounds;
+
+        auto makeLeaf = [&]() -> void {
+            nodes[task.node].left = task.begin;
+            nodes[task.node].count = count;
+            leaves.push_back(task.node);
+        };
+        if (count == 1) {
+            makeLeaf();
+            continue;
+        }
+
+        // the cheapest split between two bins on any axis
+        const Point3D extents = centroidBounds.extents();
+        const Point3D scale{extents.x > 0.0f ? binCount / extents.x : 0.0f, extents.y > 0.0f ? binCount / extents.y : 0.0f,
+                            extents.z > 0.0f ? binCount / extents.z : 0.0f};
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        if (task.depth < sahDepthLimit && (scale.x > 0.0f || scale.y > 0.0f || scale.z > 0.0f)) {
+            const Bins bins = binRange(task.begin, task.end, centroidBounds.min, scale);
+            const float invArea = bounds.surfaceArea() > 0.0f ? 1.0f / bounds.surfaceArea() : 0.0f;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (component(scale, axis) == 0.0f)
+                    continue;
+                // areas and counts of everything right of each split, then a sweep from the left
+                std::array<float, binCount> rightArea{};
+                std::array<uint32_t, binCount> rightCount{};
+                AABB right;
+                uint32_t rightFaces = 0;
+                for (uint32_t bin = binCount - 1; bin > 0; --bin) {
+                    right.extend(bins[axis][bin].bounds);
+                    rightFaces += bins[axis][bin].count;
+                    rightArea[bin] = right.surfaceArea();
+                    rightCount[bin] = rightFaces;
+                }
+                AABB left;
+                uint32_t leftFaces = 0;
+                for (uint32_t split = 1; split < binCount; ++split) {
+                    left.extend(bins[axis][split - 1].bounds);
+                    leftFaces += bins[axis][split - 1].count;
+                    if (!leftFaces || !rightCount[split])
+                        continue;
+                    const float cost = traversalCost
+                                     + intersectionCost * invArea
+                                           * (left.surfaceArea() * leftFaces + rightArea[split] * rightCount[split]);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+        }
+
+        const float leafCost = intersectionCost * count;
+        if (count <= maxLeafSize && (bestAxis < 0 || leafCost <= bestCost)) {
+            makeLeaf();
+            continue;
+        }
+
+        uint32_t* first = faceOrder.data() + task.begin;
+        uint32_t* last = faceOrder.data() + task.end;
+        uint32_t* middle = nullptr;
+        if (bestAxis >= 0) {
+            const float origin = component(centroidBounds.min, bestAxis);
+            const float axisScale = component(scale, bestAxis);
+            middle = std::partition(first, last, [&](uint32_t f) -> bool {
+                const float c = (component(centroids[f], bestAxis) - origin) * axisScale;
+                return std::min(binCount - 1, static_cast<uint32_t>(std::max(0.0f, c))) < bestSplit;
+            });
+        }
+        if (middle == nullptr || middle == first || middle == last) {
+            // no usable SAH split: median of the longest axis, which may be arbitrary for equal centroids
+            int axis = 0;
+            if (extents.y > component(extents, axis))
+                axis = 1;
+            if (extents.z > component(extents, axis))
+                axis = 2;
+            middle = first + count / 2;
+            std::nth_element(first, middle, last, [&](uint32_t a, uint32_t b) -> bool {
+                return component(centroids[a], axis) < component(centroids[b], axis);
+            });
+        }
+
+        const uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+        const uint32_t split = static_cast<uint32_t>(middle - faceOrder.data());
+        nodes[task.node].left = leftChild;
+        nodes[task.node].right = leftChild + 1;
+        nodes.push_back({AABB{}, invalid, invalid, 0, task.node});
+        nodes.push_back({AABB{}, invalid, invalid, 0, task.node});
+        stack.push_back({leftChild + 1, split, task.end, task.depth + 1});
+        stack.push_back({leftChild, task.begin, split, task.depth + 1});
+    }
+    nodes.shrink_to_fit();
+    leaves.shrink_to_fit();
+
+    referenceAreas.resize(nodes.size());
+    parallelFor(nodes.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t n = begin; n < end; ++n)
+            referenceAreas[n] = nodes[n].bounds.surfaceArea();
+    });
+    builtCost = sahCost();
+}
+
+AABB TriangleBVH::leafBounds(const Node& leaf) const
+{
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+    AABB bounds;
+    for (uint32_t i = leaf.left; i < leaf.left + leaf.count; ++i) {
+        const TriangleIndices& t = faces[faceOrder[i]];
+        bounds.extend(vertices[t.v1]);
+        bounds.extend(vertices[t.v2]);
+        bounds.extend(vertices[t.v3]);
+    }
+    return bounds;
+}
+
+TriangleBVH::RefitResult TriangleBVH::refit()
+{
+    if (!mesh || nodes.empty())
+        return RefitResult::Refitted;
+    if (faceOrder.size() != mesh->getFaces().size())
+        throw std::runtime_error("the faces of the mesh changed since the BVH was built");
+
+    // every leaf walks up to the root, the second child to arrive at a node computes its bounds
+    CountedVector<uint32_t, MemoryCategory::Temporary> arrivals(nodes.size(), 0);
+    parallelFor(leaves.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t n = leaves[i];
+            nodes[n].bounds = leafBounds(nodes[n]);
+            for (n = nodes[n].parent; n != invalid; n = nodes[n].parent) {
+                if (std::atomic_ref{arrivals[n]}.fetch_add(1, std::memory_order_acq_rel) == 0)
+                    break;
+                Node& node = nodes[n];
+                node.bounds = nodes[node.left].bounds;
+                node.bounds.extend(nodes[node.right].bounds);
+            }
+        }
+    }, 256);
+
+    if (sahCost() <= restructureThreshold * builtCost)
+        return RefitResult::Refitted;
+    if (restructure() && sahCost() <= restructureThreshold * builtCost)
+        return RefitResult::Restructured;
+    build(*mesh);
+    return RefitResult::Rebuilt;
+}
+
+bool TriangleBVH::closestPoint(const Point3D& p, ClosestPoint& result, float maxDistance) const
+{
+    if (nodes.empty())
+        return false;
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+
+    float best = maxDistance * maxDistance;
+    bool found = false;
+    std::array<std::pair<uint32_t, float>, stackSize> stack;
+    uint32_t size = 0;
+    stack[size++] = {0, distanceSquared(nodes[0].bounds, p)};
+    while (size) {
+        const auto [n, nodeDistance] = stack[--size];
+        if (nodeDistance > best)
+            continue;
+        const Node& node = nodes[n];
+        if (node.isLeaf()) {
+            for (uint32_t i = node.left; i < node.left + node.count; ++i) {
+                const TriangleIndices& t = faces[faceOrder[i]];
+                const Point3D candidate = closestPointOnTriangle(p, vertices[t.v1], vertices[t.v2], vertices[t.v3]);
+                const Point3D d = candidate - p;
+                const float candidateDistance = dot(d, d);
+                if (candidateDistance <= best) {
+                    best = candidateDistance;
+                    result = {candidate, candidateDistance, faceOrder[i]};
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // the nearer child is popped first
+        float leftDistance = distanceSquared(nodes[node.left].bounds, p);
+        float rightDistance = distanceSquared(nodes[node.right].bounds, p);
+        uint32_t nearChild = node.left, farChild = node.right;
+        if (rightDistance < leftDistance) {
+            std::swap(leftDistance, rightDistance);
+            std::swap(nearChild, farChild);
+        }
+        if (rightDistance <= best)
+            stack[size++] = {farChild, rightDistance};
+        if (leftDistance <= best)
+            stack[size++] = {nearChild, leftDistance};
+    }
+    return found;
+}
+
+float TriangleBVH::sahCost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+    const size_t chunks = chunkCount(nodes.size());
+    std::vector<double> partial(chunks, 0.0);
+    parallelForChunks(nodes.size(), chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        double sum = 0.0;
+        for (size_t n = begin; n < end; ++n) {
+            const Node& node = nodes[n];
+            sum += node.bounds.surfaceArea() * (node.isLeaf() ? intersectionCost * node.count : traversalCost);
+        }
+        partial[chunk] = sum;
+    });
+    const float rootArea = nodes[0].bounds.surfaceArea();
+    double sum = 0.0;
+    for (double chunkSum : partial)
+        sum += chunkSum;
+    return rootArea > 0.0f ? static_cast<float>(sum / rootArea) : 0.0f;
+}
+
+bool TriangleBVH::restructure()
+{
+    // nodes whose area grew past the threshold get their treelet optimized, children before parents
+    CountedVector<float, MemoryCategory::Temporary> costs(nodes.size());
+    auto update = [&](uint32_t n) -> void {
+        const Node& node = nodes[n];
+        const float area = node.bounds.surfaceArea();
+        if (node.isLeaf()) {
+            costs[n] = intersectionCost * node.count * area;
+            return;
+        }
+        costs[n] = traversalCost * area + costs[node.left] + costs[node.right];
+        if (area > restructureThreshold * referenceAreas[n])
+            optimizeTreelet(n, costs);
+    };
+
+    // the subtrees below a frontier of nodes are independent of each other, the nodes above it follow
+    std::vector<uint32_t> top, frontier{0};
+    while (frontier.size() < 8 * numThreads()) {
+        std::vector<uint32_t> next;
+        for (uint32_t n : frontier) {
+            if (nodes[n].isLeaf()) {
+                next.push_back(n);
+                continue;
+            }
+            top.push_back(n);
+            next.push_back(nodes[n].left);
+            next.push_back(nodes[n].right);
+        }
+        if (next.size() == frontier.size())
+            break;
+        frontier = std::move(next);
+    }
+    parallelFor(frontier.size(), [&](size_t begin, size_t end) -> void {
+        std::vector<uint32_t> stack, postOrder;
+        for (size_t i = begin; i < end; ++i) {
+            stack.push_back(frontier[i]);
+            while (!stack.empty()) {
+                const uint32_t n = stack.back();
+                stack.pop_back();
+                postOrder.push_back(n);
+                if (!nodes[n].isLeaf()) {
+                    stack.push_back(nodes[n].left);
+                    stack.push_back(nodes[n].right);
+                }
+            }
+            std::for_each(postOrder.rbegin(), postOrder.rend(), update);
+            postOrder.clear();
+        }
+    }, 1);
+    std::for_each(top.rbegin(), top.rend(), update);
+
+    // every treelet may have deepened the tree, the traversal stack has to hold it
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 1}};
+    while (!stack.empty()) {
+        const auto [n, depth] = stack.back();
+        stack.pop_back();
+        if (depth >= stackSize)
+            return false;
+        if (!nodes[n].isLeaf()) {
+            stack.emplace_back(nodes[n].left, depth + 1);
+            stack.emplace_back(nodes[n].right, depth + 1);
+        }
+    }
+    return true;
+}
+
+void TriangleBVH::optimizeTreelet(uint32_t root, CountedVector<float, MemoryCategory::Temporary>& costs)
+{
+    // grow the treelet by expanding the leaf with the largest area
+    std::array<uint32_t, treeletSize> treeletLeaves{nodes[root].left, nodes[root].right};
+    std::array<uint32_t, treeletSize - 1> internals{root};
+    uint32_t leafCount = 2, internalCount = 1;
+    while (leafCount < treeletSize) {
+        int expand = -1;
+        float largest = -1.0f;
+        for (uint32_t i = 0; i < leafCount; ++i) {
+            const Node& node = nodes[treeletLeaves[i]];
+            if (!node.isLeaf() && node.bounds.surfaceArea() > largest) {
+                largest = node.bounds.surfaceArea();
+                expand = static_cast<int>(i);
+            }
+        }
+        if (expand < 0)
+            break;
+        const uint32_t n = treeletLeaves[expand];
+        internals[internalCount++] = n;
+        treeletLeaves[expand] = nodes[n].left;
+        treeletLeaves[leafCount++] = nodes[n].right;
+    }
+    if (leafCount < 3)
+        return;
+
+    // optimal cost of every subset of the treelet leaves, a subset's partitions are smaller numbers
+    constexpr uint32_t subsets = 1u << treeletSize;
+    std::array<AABB, subsets> bounds;
+    std::array<float, subsets> cost;
+    std::array<uint8_t, subsets> bestPartition{};
+    const uint32_t full = (1u << leafCount) - 1;
+    for (uint32_t s = 1; s <= full; ++s) {
+        const uint32_t lowest = static_cast<uint32_t>(std::countr_zero(s));
+        bounds[s] = bounds[s & (s - 1)];
+        bounds[s].extend(nodes[treeletLeaves[lowest]].bounds);
+        if (std::has_single_bit(s)) {
+            cost[s] = costs[treeletLeaves[lowest]];
+            continue;
+        }
+        // only partitions containing the lowest leaf, the others are the same split mirrored
+        float best = std::numeric_limits<float>::infinity();
+        for (uint32_t p = (s - 1) & s; p > 0; p = (p - 1) & s) {
+            if (!(p & (1u << lowest)))
+                continue;
+            const float c = cost[p] + cost[s ^ p];
+            if (c < best) {
+                best = c;
+                bestPartition[s] = static_cast<uint8_t>(p);
+            }
+        }
+        cost[s] = traversalCost * bounds[s].surfaceArea() + best;
+    }
+    if (!(cost[full] < costs[root] * 0.999f))
+        return;
+
+    // rebuild the treelet with its own inner nodes, the root keeps its index
+    uint32_t nextInternal = 1;
+    auto assign = [&](auto&& self, uint32_t s, uint32_t n) -> void {
+        const uint32_t parts[2] = {bestPartition[s], s ^ bestPartition[s]};
+        uint32_t children[2];
+        for (int k = 0; k < 2; ++k) {
+            if (std::has_single_bit(parts[k])) {
+                children[k] = treeletLeaves[std::countr_zero(parts[k])];
+            }
+            else {
+                children[k] = internals[nextInternal++];
+                self(self, parts[k], children[k]);
+            }
+            nodes[children[k]].parent = n;
+        }
+        Node& node = nodes[n];
+        node.left = children[0];
+        node.right = children[1];
+        node.bounds = bounds[s];
+        referenceAreas[n] = bounds[s].surfaceArea();
+        costs[n] = cost[s];
+    };
+    assign(assign, full, root);
+}
+
+bool TriangleBVH::intersect(const Ray& ray, RayHit& hit) const
+{
+    if (nodes.empty())
+        return false;
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+    const Point3D invDirection{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+
+    Ray current = ray;
+    bool found = false;
+    std::array<std::pair<uint32_t, float>, stackSize> stack;
+    uint32_t size = 0;
+    const float rootEntry = intersectAABB(nodes[0].bounds, current, invDirection);
+    if (rootEntry != std::numeric_limits<float>::infinity())
+        stack[size++] = {0, rootEntry};
+
+    while (size) {
+        const auto [n, entry] = stack[--size];
+        if (entry > current.tMax)
+            continue;
+        const Node& node = nodes[n];
+        if (node.isLeaf()) {
+            for (uint32_t i = node.left; i < node.left + node.count; ++i) {
+                const TriangleIndices& t = faces[faceOrder[i]];
+                float tHit, u, v;
+                if (intersectTriangle(current, vertices[t.v1], vertices[t.v2], vertices[t.v3], tHit, u, v)) {
+                    current.tMax = tHit;
+                    hit = {tHit, faceOrder[i], u, v};
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // the nearer child is popped first
+        float leftEntry = intersectAABB(nodes[node.left].bounds, current, invDirection);
+        float rightEntry = intersectAABB(nodes[node.right].bounds, current, invDirection);
+        uint32_t nearChild = node.left, farChild = node.right;
+        if (rightEntry < leftEntry) {
+            std::swap(leftEntry, rightEntry);
+            std::swap(nearChild, farChild);
+        }
+        if (rightEntry != std::numeric_limits<float>::infinity())
+            stack[size++] = {farChild, rightEntry};
+        if (leftEntry != std::numeric_limits<float>::infinity())
+            stack[size++] = {nearChild, leftEntry};
+    }
+    return found;
+}
+
+bool TriangleBVH::intersect(RayPacket& packet) const
+{
+    if (nodes.empty())
+        return false;
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+    constexpr size_t lanes = RayPacket::size;
+    float invX[lanes], invY[lanes], invZ[lanes];
+    for (size_t i = 0; i < lanes; ++i) {
+        invX[i] = 1.0f / packet.directionX[i];
+        invY[i] = 1.0f / packet.directionY[i];
+        invZ[i] = 1.0f / packet.directionZ[i];
+    }
+
+    uint32_t anyHit = 0;
+    std::array<uint32_t, stackSize> stack;
+    uint32_t size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const Node& node = nodes[stack[--size]];
+
+        // the slab test of all rays at once
+        uint32_t entered = 0;
+        for (size_t i = 0; i < lanes; ++i) {
+            const float x0 = (node.bounds.min.x - packet.originX[i]) * invX[i];
+            const float x1 = (node.bounds.max.x - packet.originX[i]) * invX[i];
+            const float y0 = (node.bounds.min.y - packet.originY[i]) * invY[i];
+            const float y1 = (node.bounds.max.y - packet.originY[i]) * invY[i];
+            const float z0 = (node.bounds.min.z - packet.originZ[i]) * invZ[i];
+            const float z1 = (node.bounds.max.z - packet.originZ[i]) * invZ[i];
+            const float enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), packet.tMin[i]));
+            const float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), packet.tMax[i]));
+            entered |= static_cast<uint32_t>(enter <= exit);
+        }
+        if (!entered)
+            continue;
+
+        if (node.isLeaf()) {
+            // Möller-Trumbore for all rays at once, hits only replace the closest hit where they are closer
+            for (uint32_t f = node.left; f < node.left + node.count; ++f) {
+                const TriangleIndices& t = faces[faceOrder[f]];
+                const Point3D& p0 = vertices[t.v1];
+                const Point3D e1 = vertices[t.v2] - p0;
+                const Point3D e2 = vertices[t.v3] - p0;
+                const uint32_t face = faceOrder[f];
+                for (size_t i = 0; i < lanes; ++i) {
+                    const float px = packet.directionY[i] * e2.z - packet.directionZ[i] * e2.y;
+                    const float py = packet.directionZ[i] * e2.x - packet.directionX[i] * e2.z;
+                    const float pz = packet.directionX[i] * e2.y - packet.directionY[i] * e2.x;
+                    const float determinant = e1.x * px + e1.y * py + e1.z * pz;
+                    const float invDeterminant = 1.0f / determinant;
+                    const float sx = packet.originX[i] - p0.x, sy = packet.originY[i] - p0.y, sz = packet.originZ[i] - p0.z;
+                    const float u = (sx * px + sy * py + sz * pz) * invDeterminant;
+                    const float qx = sy * e1.z - sz * e1.y, qy = sz * e1.x - sx * e1.z, qz = sx * e1.y - sy * e1.x;
+                    const float v = (packet.directionX[i] * qx + packet.directionY[i] * qy + packet.directionZ[i] * qz)
+                                  * invDeterminant;
+                    const float tHit = (e2.x * qx + e2.y * qy + e2.z * qz) * invDeterminant;
+                    const uint32_t hit = static_cast<uint32_t>(determinant != 0.0f) & (u >= 0.0f) & (v >= 0.0f)
+                                       & (u + v <= 1.0f) & (tHit >= packet.tMin[i]) & (tHit <= packet.tMax[i]);
+                    packet.tMax[i] = hit ? tHit : packet.tMax[i];
+                    packet.u[i] = hit ? u : packet.u[i];
+                    packet.v[i] = hit ? v : packet.v[i];
+                    // a select on the integer would keep gcc from vectorizing the loop
+                    packet.face[i] ^= (packet.face[i] ^ face) & (0u - hit);
+                    anyHit |= hit;
+                }
+            }
+            continue;
+        }
+
+        // the child nearer along the first ray is popped first
+        const Point3D towardsRight = nodes[node.right].bounds.center() - nodes[node.left].bounds.center();
+        const bool rightFirst = towardsRight.x * packet.directionX[0] + towardsRight.y * packet.directionY[0]
+                                    + towardsRight.z * packet.directionZ[0] < 0.0f;
+        stack[size++] = rightFirst ? node.left : node.right;
+        stack[size++] = rightFirst ? node.right : node.left;
+    }
+    return anyHit != 0;
+}
+
+bool TriangleBVH::occluded(const Ray& ray) const
+{
+    if (nodes.empty())
+        return false;
+    const FaceList& faces = mesh->getFaces();
+    const VertexList& vertices = mesh->getVertices();
+    const Point3D invDirection{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+
+    std::array<uint32_t, stackSize> stack;
+    uint32_t size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const Node& node = nodes[stack[--size]];
+        if (intersectAABB(node.bounds, ray, invDirection) == std::numeric_limits<float>::infinity())
+            continue;
+        if (node.isLeaf()) {
+            for (uint32_t i = node.left; i < node.left + node.count; ++i) {
+                const TriangleIndices& t = faces[faceOrder[i]];
+                float tHit, u, v;
+                if (intersectTriangle(ray, vertices[t.v1], vertices[t.v2], vertices[t.v3], tHit, u, v))
+                    return true;
+            }
+            continue;
+        }
+        stack[size++] = node.right;
+        stack[size++] = node.left;
+    }
+    return false;
+}
@@ -0,0 +1,609 @@
+#include "gltf.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+#include "binaryio.h"
+#include "mesh.h"
+#include "parallel.h"
+
+namespace {
+
+/// a parsed JSON value, objects keep their members in file order
+struct JsonValue {
+    enum class Type { Null, Boolean, Number, String, Array, Object };
+
+    Type type{Type::Null};
+    bool boolean{false};
+    double number{0.0};
+    std::string string;
+    /// array items or object member values
+    std::vector<JsonValue> items;
+    /// object member names, parallel to items
+    std::vector<std::string> keys;
+
+    /// member with the given name or nullptr
+    const JsonValue* find(std::string_view key) const
+    {
+        for (size_t i = 0; i < keys.size(); ++i)
+            if (keys[i] == key)
+                return &items[i];
+        return nullptr;
+    }
+
+    /// numeric member with the given name or the fallback if it does not exist
+    double numberOr(std::string_view key, double fallback) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == Type::Number ? value->number : fallback;
+    }
+};
+
+/// recursive descent parser for the JSON chunk
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : text{text} {}
+
+    JsonValue parse()
+    {
+        JsonValue value = parseValue(0);
+        skipWhitespace();
+        if (position != text.size())
+            fail("unexpected characters after the document");
+        return value;
+    }
+
+private:
+    static constexpr size_t maxDepth = 256;
+
+    [[noreturn]] void fail(const char* what) const
+    {
+        throw std::runtime_error(std::string{"invalid JSON at offset "} + std::to_string(position) + ": " + what);
+    }
+
+    void skipWhitespace()
+    {
+        while (position < text.size()
+               && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+            ++position;
+    }
+
+    void expect(char c)
+    {
+        skipWhitespace();
+        if (position >= text.size() || text[position] != c)
+            fail("unexpected character");
+        ++position;
+    }
+
+    bool consume(std::string_view word)
+    {
+        if (text.substr(position, word.size()) != word)
+            return false;
+        position += word.size();
+        return true;
+    }
+
+    JsonValue parseValue(size_t depth)
+    {
+        if (depth > maxDepth)
+            fail("nesting too deep");
+        skipWhitespace();
+        if (position >= text.size())
+            fail("unexpected end");
+
+        JsonValue value;
+        const char c = text[position];
+        if (c == '{') {
+            value.type = JsonValue::Type::Object;
+            ++position;
+            skipWhitespace();
+            if (position < text.size() && text[position] == '}') {
+                ++position;
+                return value;
+            }
+            do {
+                skipWhitespace();
+                value.keys.push_back(parseString());
+                expect(':');
+                value.items.push_back(parseValue(depth + 1));
+                skipWhitespace();
+            } while (position < text.size() && text[position] == ',' && ++position);
+            expect('}');
+        }
+        else if (c == '[') {
+            value.type = JsonValue::Type::Array;
+            ++position;
+            skipWhitespace();
+            if (position < text.size() && text[position] == ']') {
+                ++position;
+                return value;
+            }
+            do {
+                value.items.push_back(parseValue(depth + 1));
+                skipWhitespace();
+            } while (position < text.size() && text[position] == ',' && ++position);
+            expect(']');
+        }
+        else if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+        }
+        else if (consume("true") || consume("false")) {
+            value.type = JsonValue::Type::Boolean;
+            value.boolean = c == 't';
+        }
+        else if (consume("null")) {
+            value.type = JsonValue::Type::Null;
+        }
+        else {
+            value.type = JsonValue::Type::Number;
+            const auto [end, error] = std::from_chars(text.data() + position, text.data() + text.size(), value.number);
+            if (error != std::errc{})
+                fail("invalid value");
+            position = end - text.data();
+        }
+        return value;
+    }
+
+    std::string parseString()
+    {
+        if (position >= text.size() || text[position] != '"')
+            fail("expected a string");
+        ++position;
+        std::string result;
+        while (true) {
+            if (position >= text.size())
+                fail("unterminated string");
+            const char c = text[position++];
+            if (c == '"')
+                return result;
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (position >= text.size())
+                fail("unterminated string");
+            switch (const char escaped = text[position++]) {
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': {
+                // names are only used for messages, surrogate pairs are encoded one by one
+                uint32_t code = 0;
+                const auto [end, error] = std::from_chars(text.data() + position,
+                                                          text.data() + std::min(position + 4, text.size()), code, 16);
+                if (error != std::errc{} || end != text.data() + position + 4)
+                    fail("invalid unicode escape");
+                position += 4;
+                if (code < 0x80) {
+                    result += static_cast<char>(code);
+                }
+                else if (code < 0x800) {
+                    result += static_cast<char>(0xC0 | (code >> 6));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else {
+                    result += static_cast<char>(0xE0 | (code >> 12));
+                    result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: result += escaped; break;
+            }
+        }
+    }
+
+    std::string_view text;
+    size_t position{0};
+};
+
+template <typename C>
+inline float toFloat(C value, bool normalized)
+{
+    if constexpr (std::is_floating_point_v<C>)
+        return value;
+    else if (!normalized)
+        return static_cast<float>(value);
+    else if constexpr (std::is_signed_v<C>)
+        return std::max(static_cast<float>(value) / static_cast<float>(std::numeric_limits<C>::max()), -1.0f);
+    else
+        return static_cast<float>(value) / static_cast<float>(std::numeric_limits<C>::max());
+}
+
+/// the component type is a template parameter, so the inner loop has no branches and can be vectorized
+template <typename C>
+void convertFloats(const GLBAccessor& accessor, size_t begin, size_t end, float* out, size_t outComponents)
+{
+    const size_t components = std::min(outComponents, accessor.components);
+    for (size_t i = begin; i < end; ++i) {
+        const uint8_t* element = accessor.data + i * accessor.stride;
+        float* o = out + (i - begin) * outComponents;
+        for (size_t c = 0; c < components; ++c)
+            o[c] = toFloat(readLittleEndian<C>(element + c * sizeof(C)), accessor.normalized);
+        for (size_t c = components; c < outComponents; ++c)
+            o[c] = 0.0f;
+    }
+}
+
+template <typename C>
+void convertIndices(const GLBAccessor& accessor, size_t begin, size_t end, uint32_t* out)
+{
+    for (size_t i = begin; i < end; ++i)
+        out[i - begin] = readLittleEndian<C>(accessor.data + i * accessor.stride);
+}
+
+constexpr uint32_t glbMagic = 0x46546C67;     // "glTF"
+constexpr uint32_t jsonChunkType = 0x4E4F534A; // "JSON"
+constexpr uint32_t binChunkType = 0x004E4942;  // "BIN\0"
+
+} // namespace
+
+size_t componentSize(GLTFComponentType type)
+{
+    switch (type) {
+    case GLTFComponentType::Int8:
+    case GLTFComponentType::UInt8: return 1;
+    case GLTFComponentType::Int16:
+    case GLTFComponentType::UInt16: return 2;
+    case GLTFComponentType::UInt32:
+    case GLTFComponentType::Float32: return 4;
+    }
+    return 0;
+}
+
+bool GLBAccessor::isPacked(GLTFComponentType type, size_t componentsOfT, size_t sizeOfT, size_t alignOfT) const
+{
+    return std::endian::native == std::endian::little && componentType == type && components == componentsOfT
+        && !normalized && stride == sizeOfT && componentsOfT * componentSize(type) == sizeOfT
+        && reinterpret_cast<uintptr_t>(data) % alignOfT == 0;
+}
+
+void GLBAccessor::readFloats(size_t begin, size_t end, float* out, size_t outComponents) const
+{
+    switch (componentType) {
+    case GLTFComponentType::Int8: convertFloats<int8_t>(*this, begin, end, out, outComponents); break;
+    case GLTFComponentType::UInt8: convertFloats<uint8_t>(*this, begin, end, out, outComponents); break;
+    case GLTFComponentType::Int16: convertFloats<int16_t>(*this, begin, end, out, outComponents); break;
+    case GLTFComponentType::UInt16: convertFloats<uint16_t>(*this, begin, end, out, outComponents); break;
+    case GLTFComponentType::UInt32: convertFloats<uint32_t>(*this, begin, end, out, outComponents); break;
+    case GLTFComponentType::Float32: convertFloats<float>(*this, begin, end, out, outComponents); break;
+    }
+}
+
+void GLBAccessor::readIndices(size_t begin, size_t end, uint32_t* out) const
+{
+    switch (componentType) {
+    case GLTFComponentType::UInt8: convertIndices<uint8_t>(*this, begin, end, out); break;
+    case GLTFComponentType::UInt16: convertIndices<uint16_t>(*this, begin, end, out); break;
+    case GLTFComponentType::UInt32: convertIndices<uint32_t>(*this, begin, end, out); break;
+    default: throw std::runtime_error("glTF indices have to be unsigned integers");
+    }
+}
+
+GLBFile::GLBFile(const std::string& filename) : file{filename}
+{
+    auto fail = [&](const std::string& what) -> void {
+        throw std::runtime_error("failed to parse the GLB file " + filename + "\n" + what);
+    };
+
+    // 12 byte header followed by the JSON chunk and the optional binary chunk
+    const uint8_t* data = file.data();
+    if (file.size() < 20 || readLittleEndian<uint32_t>(data) != glbMagic)
+        fail("not a binary glTF file");
+    if (readLittleEndian<uint32_t>(data + 4) != 2)
+        fail("only glTF 2.0 is supported");
+    const size_t length = std::min<size_t>(readLittleEndian<uint32_t>(data + 8), file.size());
+
+    std::string_view json;
+    std::span<const uint8_t> bin;
+    for (size_t offset = 12; offset + 8 <= length;) {
+        const size_t chunkLength = readLittleEndian<uint32_t>(data + offset);
+        const uint32_t chunkType = readLittleEndian<uint32_t>(data + offset + 4);
+        if (chunkLength > length - offset - 8)
+            fail("chunk exceeds the file");
+        if (chunkType == jsonChunkType && json.empty())
+            json = {reinterpret_cast<const char*>(data + offset + 8), chunkLength};
+        else if (chunkType == binChunkType && bin.empty())
+            bin = {data + offset + 8, chunkLength};
+        offset += 8 + chunkLength;
+    }
+    if (json.empty())
+        fail("missing JSON chunk");
+
+    JsonValue root;
+    try {
+        root = JsonParser{json}.parse();
+    }
+    catch (const std::exception& e) {
+        fail(e.what());
+    }
+
+    auto array = [&](const JsonValue& object, std::string_view key) -> const std::vector<JsonValue>& {
+        static const std::vector<JsonValue> empty;
+        const JsonValue* value = object.find(key);
+        return value && value->type == JsonValue::Type::Array ? value->items : empty;
+    };
+    auto index = [&](const JsonValue& value, size_t count) -> size_t {
+        if (value.type != JsonValue::Type::Number || value.number < 0 || value.number >= static_cast<double>(count))
+            fail("index out of range");
+        return static_cast<size_t>(value.number);
+    };
+
+    // counts, offsets and lengths must be whole numbers which convert to size_t exactly
+    auto size = [&](const JsonValue& object, std::string_view key, size_t fallback) -> size_t {
+        const double value = object.numberOr(key, static_cast<double>(fallback));
+        if (!(value >= 0.0 && value < 0x1p53) || value != std::floor(value))
+            fail(std::string{key} + " must be a non-negative integer");
+        return static_cast<size_t>(value);
+    };
+
+    const auto& buffers = array(root, "buffers");
+    const auto& bufferViews = array(root, "bufferViews");
+    const auto& accessors = array(root, "accessors");
+
+    auto accessor = [&](const JsonValue& indexValue) -> GLBAccessor {
+        const JsonValue& description = accessors[index(indexValue, accessors.size())];
+        if (description.find("sparse"))
+            fail("sparse accessors are not supported");
+        const JsonValue* viewIndex = description.find("bufferView");
+        if (!viewIndex)
+            fail("accessors without a buffer view are not supported");
+        const JsonValue& view = bufferViews[index(*viewIndex, bufferViews.size())];
+        if (view.numberOr("buffer", -1) != 0 || buffers.empty() || buffers[0].find("uri"))
+            fail("only the embedded binary buffer is supported");
+
+        GLBAccessor result;
+        result.componentType = static_cast<GLTFComponentType>(description.numberOr("componentType", 0));
+        if (!componentSize(result.componentType))
+            fail("unknown accessor component type");
+        const JsonValue* type = description.find("type");
+        const std::string typeName = type ? type->string : "";
+        if (typeName == "SCALAR")
+            result.components = 1;
+        else if (typeName == "VEC2")
+            result.components = 2;
+        else if (typeName == "VEC3")
+            result.components = 3;
+        else if (typeName == "VEC4")
+            result.components = 4;
+        else
+            fail("unsupported accessor type " + typeName);
+        const JsonValue* normalized = description.find("normalized");
+        result.normalized = normalized && normalized->boolean;
+        result.count = size(description, "count", 0);
+
+        const size_t elementSize = result.components * componentSize(result.componentType);
+        const size_t viewOffset = size(view, "byteOffset", 0);
+        const size_t viewLength = size(view, "byteLength", 0);
+        const size_t accessorOffset = size(description, "byteOffset", 0);
+        result.stride = size(view, "byteStride", elementSize);
+        if (viewOffset > bin.size() || viewLength > bin.size() - viewOffset)
+            fail("buffer view exceeds the binary chunk");
+        // the last element must end inside the view, compared without overflowing
+        if (result.count
+            && (result.stride < elementSize || accessorOffset > viewLength || elementSize > viewLength - accessorOffset
+                || result.count - 1 > (viewLength - accessorOffset - elementSize) / result.stride))
+            fail("accessor exceeds its buffer view");
+        result.data = bin.data() + viewOffset + accessorOffset;
+        return result;
+    };
+
+    for (const JsonValue& mesh : array(root, "meshes")) {
+        const JsonValue* name = mesh.find("name");
+        for (const JsonValue& description : array(mesh, "primitives")) {
+            GLBPrimitive& primitive = primitives.emplace_back();
+            primitive.meshName = name ? name->string : std::string{};
+            primitive.mode = static_cast<uint32_t>(description.numberOr("mode", 4));
+            if (const JsonValue* indices = description.find("indices"))
+                primitive.indices = accessor(*indices);
+            if (const JsonValue* attributes = description.find("attributes")) {
+                if (const JsonValue* position = attributes->find("POSITION"))
+                    primitive.positions = accessor(*position);
+                if (const JsonValue* normal = attributes->find("NORMAL"))
+                    primitive.normals = accessor(*normal);
+                if (const JsonValue* texCoord = attributes->find("TEXCOORD_0"))
+                    primitive.texCoords = accessor(*texCoord);
+            }
+            if (!primitive.positions)
+                fail("primitive without positions");
+        }
+    }
+}
+
+namespace {
+
+/// faces and vertices one primitive added to a mesh
+struct PrimitiveRange {
+    size_t firstVertex, endVertex;
+    size_t firstFace, endFace;
+    bool hasNormals;
+};
+
+/// copy packed attributes in bulk, convert everything else
+template <typename T, typename List>
+void readAttribute(const GLBAccessor& accessor, List& list, size_t first)
+{
+    static_assert(sizeof(T) % sizeof(float) == 0);
+    constexpr size_t components = sizeof(T) / sizeof(float);
+    const bool packed = accessor.isPackedAs<T>(GLTFComponentType::Float32);
+    parallelFor(accessor.count, [&](size_t begin, size_t end) -> void {
+        if (packed)
+            std::memcpy(&list[first + begin], &accessor.as<T>()[begin], (end - begin) * sizeof(T));
+        else
+            accessor.readFloats(begin, end, &list[first + begin].x, components);
+    }, size_t{1} << 16);
+}
+
+/// append the triangles of one primitive, faces of strips and fans are generated in order
+PrimitiveRange appendPrimitive(Mesh& mesh, const GLBPrimitive& primitive)
+{
+    auto& vertices = mesh.getVertices();
+    auto& faces = mesh.getFaces();
+    auto& normals = mesh.getNormals();
+    auto& texCoords = mesh.getTextureCoordinates();
+
+    PrimitiveRange range{vertices.size(), vertices.size(), faces.size(), faces.size(), primitive.normals.has_value()};
+    const GLBAccessor& positions = *primitive.positions;
+    const size_t count = positions.count;
+    if (positions.components != 3 || (primitive.normals && primitive.normals->count != count)
+        || (primitive.texCoords && primitive.texCoords->count != count))
+        throw std::runtime_error("glTF primitive with inconsistent attributes");
+
+    // all attribute arrays stay as long as the vertex array, missing attributes are zero
+    range.endVertex = range.firstVertex + count;
+    vertices.resize(range.endVertex);
+    readAttribute<Vertex>(positions, vertices, range.firstVertex);
+    normals.resize(range.endVertex);
+    if (primitive.normals)
+        readAttribute<Vertex>(*primitive.normals, normals, range.firstVertex);
+    if (primitive.texCoords || !texCoords.empty()) {
+        texCoords.resize(range.endVertex);
+        if (primitive.texCoords) {
+            readAttribute<TextureCoordinate>(*primitive.texCoords, texCoords, range.firstVertex);
+            // glTF puts the origin of the texture at the top left, OBJ at the bottom left
+            parallelFor(count, [&](size_t begin, size_t end) -> void {
+                for (size_t i = range.firstVertex + begin; i < range.firstVertex + end; ++i)
+                    texCoords[i].y = 1.0f - texCoords[i].y;
+            });
+        }
+    }
+
+    const size_t indexCount = primitive.indices ? primitive.indices->count : count;
+    const auto base = static_cast<uint32_t>(range.firstVertex);
+    if (primitive.mode == 4) {
+        // triangle lists are converted in parallel, packed uint32 indices only get the offset added
+        faces.resize(range.firstFace + indexCount / 3);
+        // primitives without a whole triangle have no first face to write to
+        uint32_t* out = indexCount >= 3 ? &faces[range.firstFace].v1 : nullptr;
+        parallelFor(indexCount / 3 * 3, [&](size_t begin, size_t end) -> void {
+            if (!primitive.indices) {
+                for (size_t i = begin; i < end; ++i)
+                    out[i] = base + static_cast<uint32_t>(i);
+                return;
+            }
+            if (primitive.indices->isPackedAs<uint32_t>(GLTFComponentType::UInt32)) {
+                const auto indices = primitive.indices->as<uint32_t>();
+                for (size_t i = begin; i < end; ++i)
+                    out[i] = base + indices[i];
+            }
+            else {
+                primitive.indices->readIndices(begin, end, out + begin);
+                for (size_t i = begin; i < end; ++i)
+                    out[i] += base;
+            }
+        }, size_t{1} << 16);
+    }
+    else {
+        std::vector<uint32_t> indices(indexCount);
+        if (primitive.indices)
+            primitive.indices->readIndices(0, indexCount, indices.data());
+        else
+            for (size_t i = 0; i < indexCount; ++i)
+                indices[i] = static_cast<uint32_t>(i);
+        for (size_t i = 2; i < indexCount; ++i) {
+            if (primitive.mode == 6)
+                faces.push_back({base + indices[0], base + indices[i - 1], base + indices[i]});
+            else if (i % 2 == 0)
+                faces.push_back({base + indices[i - 2], base + indices[i - 1], base + indices[i]});
+            else // keep the winding of odd strip triangles
+                faces.push_back({base + indices[i - 1], base + indices[i - 2], base + indices[i]});
+        }
+    }
+    range.endFace = faces.size();
+
+    std::vector<uint8_t> chunkOk(chunkCount(range.endFace - range.firstFace), 1);
+    parallelForChunks(range.endFace - range.firstFace, chunkOk.size(),
+                      [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t i = range.firstFace + begin; i < range.firstFace + end; ++i)
+            if (std::max({faces[i].v1, faces[i].v2, faces[i].v3}) >= range.endVertex)
+                chunkOk[chunk] = 0;
+    });
+    if (!std::all_of(chunkOk.begin(), chunkOk.end(), [](uint8_t ok) { return ok; }))
+        throw std::runtime_error("glTF primitive with a vertex index out of range");
+
+    return range;
+}
+
+/// compute the derived data after all primitives were appended
+void finishMesh(Mesh& mesh, const std::vector<PrimitiveRange>& ranges)
+{
+    auto& normals = mesh.getNormals();
+    if (std::none_of(ranges.begin(), ranges.end(), [](const PrimitiveRange& r) { return r.hasNormals; }))
+        normals.clear();
+
+    // primitives with normals are shaded smooth, glTF asks for flat shading of the others
+    for (const PrimitiveRange& range : ranges)
+        if (range.hasNormals && range.endFace > range.firstFace)
+            mesh.getSmoothGroups().emplace_back(range.firstFace, range.endFace);
+
+    mesh.updateBounds();
+    mesh.updateFaceAreas();
+    if (std::all_of(ranges.begin(), ranges.end(), [](const PrimitiveRange& r) { return r.hasNormals; }))
+        return;
+
+    NormalList fileNormals = std::move(normals);
+    mesh.updateNormals();
+    for (const PrimitiveRange& range : ranges)
+        if (range.hasNormals)
+            std::copy(fileNormals.begin() + range.firstVertex, fileNormals.begin() + range.endVertex,
+                      normals.begin() + range.firstVertex);
+}
+
+} // namespace
+
+void Mesh::loadGLB(const std::string& filename)
+{
+    clear();
+
+    const MemoryPeakScope memoryScope;
+
+    const GLBFile file{filename};
+    std::vector<PrimitiveRange> ranges;
+    try {
+        for (const GLBPrimitive& primitive : file.getPrimitives())
+            if (primitive.isTriangles())
+                ranges.push_back(appendPrimitive(*this, primitive));
+        finishMesh(*this, ranges);
+    }
+    catch (const std::exception& e) {
+        clear();
+        throw std::runtime_error("failed to load the GLB file " + filename + "\n" + e.what());
+    }
+
+    peakLoadTransient = memoryScope.transient(getMemoryUsage().resident());
+
+    std::cout << "Loaded GLB file: " << filename << " containing " << ranges.size() << " primitives with "
+              << vertices.size() << " vertices and " << faces.size() << " faces." << std::endl;
+}
+
+std::vector<Mesh> Mesh::loadGLBSubmeshes(const std::string& filename)
+{
+    const GLBFile file{filename};
+    std::vector<Mesh> meshes;
+    for (const GLBPrimitive& primitive : file.getPrimitives()) {
+        if (!primitive.isTriangles())
+            continue;
+        Mesh& mesh = meshes.emplace_back();
+        try {
+            finishMesh(mesh, {appendPrimitive(mesh, primitive)});
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("failed to load the GLB file " + filename + "\n" + e.what());
+        }
+    }
+
+    std::cout << "Loaded GLB file: " << filename << " containing " << meshes.size() << " submeshes." << std::endl;
+    return meshes;
+}
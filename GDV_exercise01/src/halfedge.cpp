@@ -0,0 +1,317 @@
+#include "halfedge.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "parallel.h"
+
+void HalfEdgeMesh::build(const Mesh& mesh)
+{
+    const FaceList& faces = mesh.getFaces();
+    const size_t count = faces.size() * 3;
+    if (count >= invalid)
+        throw std::runtime_error("the mesh has too many faces for 32 bit half-edge indices");
+
+    origins.resize(count);
+    twins.assign(count, invalid);
+    faceDeleted.assign(faces.size(), 0);
+    positions.assign(mesh.getVertices().begin(), mesh.getVertices().end());
+    texCoords = mesh.getTextureCoordinates();
+    ambientOcclusion = mesh.getAmbientOcclusion();
+    smoothGroups = mesh.getSmoothGroups();
+
+    // sort all half-edges by their undirected edge, twins end up next to each other
+    struct EdgeKey {
+        uint64_t edge;
+        uint32_t h;
+    };
+    CountedVector<EdgeKey, MemoryCategory::Temporary> keys(count);
+
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t f = begin; f < end; ++f) {
+            const uint32_t corners[3] = {faces[f].v1, faces[f].v2, faces[f].v3};
+            for (uint32_t k = 0; k < 3; ++k) {
+                const uint32_t h = static_cast<uint32_t>(3 * f + k);
+                const uint32_t a = corners[k], b = corners[(k + 1) % 3];
+                origins[h] = a;
+                keys[h] = {(uint64_t{std::min(a, b)} << 32) | std::max(a, b), h};
+            }
+        }
+    });
+
+    parallelSort(keys.begin(), keys.end(), [](const EdgeKey& a, const EdgeKey& b) -> bool {
+        return a.edge < b.edge || (a.edge == b.edge && a.h < b.h);
+    });
+
+    // match each run of equal edges, every chunk handles the runs starting inside of it
+    const size_t chunks = chunkCount(count, size_t{1} << 16);
+    std::vector<size_t> nonManifoldPerChunk(chunks);
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        while (begin > 0 && begin < count && keys[begin].edge == keys[begin - 1].edge)
+            ++begin;
+        for (size_t i = begin; i < end;) {
+            size_t j = i + 1;
+            while (j < count && keys[j].edge == keys[i].edge)
+                ++j;
+
+            const bool degenerate = (keys[i].edge >> 32) == (keys[i].edge & 0xFFFFFFFF);
+            if (j - i == 2 && !degenerate) {
+                const uint32_t h0 = keys[i].h, h1 = keys[i + 1].h;
+                if (from(h0) == to(h1)) {
+                    twins[h0] = h1;
+                    twins[h1] = h0;
+                }
+                else
+                    ++nonManifoldPerChunk[chunk];
+            }
+            else if (j - i > 2 || degenerate)
+                ++nonManifoldPerChunk[chunk];
+            i = j;
+        }
+    });
+    nonManifoldEdges = std::accumulate(nonManifoldPerChunk.begin(), nonManifoldPerChunk.end(), size_t{0});
+    keys = {};
+
+    // pick one outgoing half-edge per vertex, preferring boundary half-edges
+    vertexHalfEdges.assign(positions.size(), invalid);
+    std::vector<uint32_t> valence(positions.size());
+    for (uint32_t h = 0; h < count; ++h) {
+        const uint32_t v = origins[h];
+        uint32_t& current = vertexHalfEdges[v];
+        if (current == invalid || (twins[h] == invalid && twins[current] != invalid))
+            current = h;
+        ++valence[v];
+    }
+
+    // a vertex is manifold if circulating around it reaches all of its half-edges
+    vertexNonManifold.assign(positions.size(), 0);
+    std::vector<size_t> nonManifoldVerticesPerChunk(chunkCount(positions.size()));
+    parallelForChunks(positions.size(), nonManifoldVerticesPerChunk.size(),
+                      [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t reached = 0;
+            forEachOutgoing(static_cast<uint32_t>(v), [&](uint32_t) -> void { ++reached; });
+            if (reached != valence[v]) {
+                vertexNonManifold[v] = 1;
+                ++nonManifoldVerticesPerChunk[chunk];
+            }
+        }
+    });
+    nonManifoldVertices = std::accumulate(nonManifoldVerticesPerChunk.begin(),
+                                          nonManifoldVerticesPerChunk.end(), size_t{0});
+}
+
+Mesh HalfEdgeMesh::toMesh() const
+{
+    Mesh mesh;
+    VertexList& vertices = mesh.getVertices();
+    FaceList& faces = mesh.getFaces();
+
+    // keep the order of the remaining vertices and faces
+    std::vector<uint32_t> vertexRemap(positions.size(), invalid);
+    std::vector<size_t> keptFacesBefore(numFaces() + 1, 0);
+    for (uint32_t f = 0; f < numFaces(); ++f) {
+        keptFacesBefore[f + 1] = keptFacesBefore[f] + (faceDeleted[f] ? 0 : 1);
+        if (!faceDeleted[f])
+            for (uint32_t k = 0; k < 3; ++k)
+                vertexRemap[origins[3 * f + k]] = 0;
+    }
+    // attributes are only kept if there is one per vertex
+    const bool hasTexCoords = texCoords.size() == positions.size();
+    const bool hasAmbientOcclusion = ambientOcclusion.size() == positions.size();
+    for (uint32_t v = 0; v < positions.size(); ++v) {
+        if (vertexRemap[v] != invalid) {
+            vertexRemap[v] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(positions[v]);
+            if (hasTexCoords)
+                mesh.getTextureCoordinates().push_back(texCoords[v]);
+            if (hasAmbientOcclusion)
+                mesh.getAmbientOcclusion().push_back(ambientOcclusion[v]);
+        }
+    }
+
+    faces.reserve(keptFacesBefore.back());
+    for (uint32_t f = 0; f < numFaces(); ++f) {
+        if (!faceDeleted[f])
+            faces.push_back({vertexRemap[origins[3 * f]], vertexRemap[origins[3 * f + 1]],
+                             vertexRemap[origins[3 * f + 2]]});
+    }
+
+    for (const auto& [start, end] : smoothGroups) {
+        const size_t newStart = keptFacesBefore[std::min(start, numFaces())];
+        const size_t newEnd = keptFacesBefore[std::min(end, numFaces())];
+        if (newEnd > newStart)
+            mesh.getSmoothGroups().emplace_back(newStart, newEnd);
+    }
+
+    mesh.updateBounds();
+    mesh.updateFaceAreas();
+    mesh.updateNormals();
+    return mesh;
+}
+
+bool HalfEdgeMesh::isBoundaryVertex(uint32_t v) const
+{
+    const uint32_t h = vertexHalfEdges[v];
+    return h != invalid && twins[h] == invalid;
+}
+
+std::vector<uint32_t> HalfEdgeMesh::oneRing(uint32_t v) const
+{
+    std::vector<uint32_t> ring;
+    const uint32_t start = vertexHalfEdges[v];
+    if (start == invalid)
+        return ring;
+
+    uint32_t h = start;
+    do {
+        ring.push_back(to(h));
+        const uint32_t incoming = prev(h);
+        if (twins[incoming] == invalid) {
+            // reached the boundary, the last neighbor is only connected by the incoming edge
+            if (from(incoming) != ring.front())
+                ring.push_back(from(incoming));
+            break;
+        }
+        h = twins[incoming];
+    } while (h != start);
+    return ring;
+}
+
+std::array<uint32_t, 3> HalfEdgeMesh::faceNeighbors(uint32_t f) const
+{
+    std::array<uint32_t, 3> neighbors;
+    for (uint32_t k = 0; k < 3; ++k) {
+        const uint32_t t = twins[3 * f + k];
+        neighbors[k] = t == invalid ? invalid : face(t);
+    }
+    return neighbors;
+}
+
+std::vector<std::vector<uint32_t>> HalfEdgeMesh::boundaryLoops() const
+{
+    std::vector<std::vector<uint32_t>> loops;
+    std::vector<uint8_t> visited(numHalfEdges(), 0);
+
+    for (uint32_t start = 0; start < numHalfEdges(); ++start) {
+        if (visited[start] || twins[start] != invalid || faceDeleted[face(start)])
+            continue;
+
+        std::vector<uint32_t>& loop = loops.emplace_back();
+        uint32_t h = start;
+        while (h != invalid && !visited[h]) {
+            visited[h] = 1;
+            loop.push_back(h);
+
+            // rotate around the target vertex until the outgoing boundary half-edge is found
+            uint32_t outgoing = next(h);
+            for (size_t steps = 0; twins[outgoing] != invalid; ++steps) {
+                outgoing = next(twins[outgoing]);
+                if (outgoing == next(h) || steps > numHalfEdges()) {
+                    outgoing = invalid;
+                    break;
+                }
+            }
+            h = outgoing;
+        }
+    }
+    return loops;
+}
+
+bool HalfEdgeMesh::canCollapse(uint32_t h) const
+{
+    if (faceDeleted[face(h)])
+        return false;
+
+    const uint32_t a = from(h), b = to(h);
+    if (a == b || vertexNonManifold[a] || vertexNonManifold[b])
+        return false;
+
+    // collapsing an interior edge between two boundary vertices pinches the surface
+    const uint32_t t = twins[h];
+    if (t != invalid && isBoundaryVertex(a) && isBoundaryVertex(b))
+        return false;
+
+    // link condition: the only shared neighbors are the vertices opposite to the edge
+    const uint32_t c = from(prev(h));
+    const uint32_t d = t != invalid ? from(prev(t)) : invalid;
+    std::vector<uint32_t> ringA = oneRing(a), ringB = oneRing(b);
+    std::sort(ringA.begin(), ringA.end());
+    std::sort(ringB.begin(), ringB.end());
+
+    std::vector<uint32_t> shared;
+    std::set_intersection(ringA.begin(), ringA.end(), ringB.begin(), ringB.end(),
+                          std::back_inserter(shared));
+    for (uint32_t v : shared)
+        if (v != c && v != d)
+            return false;
+    return shared.size() == (t != invalid ? 2u : 1u);
+}
+
+void HalfEdgeMesh::updateOutgoing(uint32_t v, uint32_t candidate)
+{
+    if (candidate == invalid || faceDeleted[face(candidate)]) {
+        vertexHalfEdges[v] = invalid;
+        return;
+    }
+
+    // rotate towards the boundary (if any), so circulating visits all faces
+    uint32_t h = candidate;
+    while (twins[h] != invalid) {
+        h = next(twins[h]);
+        if (h == candidate)
+            break;
+    }
+    vertexHalfEdges[v] = h;
+}
+
+bool HalfEdgeMesh::collapseEdge(uint32_t h, const Vertex& position)
+{
+    if (!canCollapse(h))
+        return false;
+
+    const uint32_t a = from(h), b = to(h);
+    const uint32_t t = twins[h];
+
+    std::vector<uint32_t> outgoingB;
+    forEachOutgoing(b, [&](uint32_t o) -> void { outgoingB.push_back(o); });
+    for (uint32_t o : outgoingB)
+        origins[o] = a;
+
+    // remove a face adjacent to the edge and connect its two other neighbors,
+    // returns an outgoing half-edge of the opposite vertex and one of a
+    auto removeFace = [&](uint32_t e) -> std::pair<uint32_t, uint32_t> {
+        const uint32_t n = next(e), p = prev(e);
+        const uint32_t tn = twins[n], tp = twins[p];
+        if (tn != invalid)
+            twins[tn] = tp;
+        if (tp != invalid)
+            twins[tp] = tn;
+        twins[e] = twins[n] = twins[p] = invalid;
+        faceDeleted[face(e)] = 1;
+
+        const uint32_t opposite = from(p);
+        updateOutgoing(opposite, tn != invalid ? tn : (tp != invalid ? next(tp) : invalid));
+        return {opposite, tp != invalid ? tp : (tn != invalid ? next(tn) : invalid)};
+    };
+
+    std::vector<uint32_t> candidatesA;
+    candidatesA.push_back(removeFace(h).second);
+    if (t != invalid)
+        candidatesA.push_back(removeFace(t).second);
+    candidatesA.push_back(vertexHalfEdges[a]);
+    candidatesA.insert(candidatesA.end(), outgoingB.begin(), outgoingB.end());
+
+    uint32_t candidate = invalid;
+    for (uint32_t c : candidatesA) {
+        if (c != invalid && !faceDeleted[face(c)]) {
+            candidate = c;
+            break;
+        }
+    }
+    updateOutgoing(a, candidate);
+    vertexHalfEdges[b] = invalid;
+    positions[a] = position;
+    return true;
+}
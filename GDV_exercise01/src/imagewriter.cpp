@@ -0,0 +1,127 @@
+#include "imagewriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+
+// stb_image_write comes with glfw, which does not compile it into the library
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace {
+
+void checkSize(uint32_t width, uint32_t height, const std::vector<float>& rgb)
+{
+    if (!width || !height || rgb.size() != size_t{width} * height * 3)
+        throw std::runtime_error("the image needs three values for each of its pixels");
+}
+
+/// append an EXR header attribute
+void putAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+{
+    out.insert(out.end(), name, name + std::char_traits<char>::length(name) + 1);
+    out.insert(out.end(), type, type + std::char_traits<char>::length(type) + 1);
+    uint8_t size[4];
+    writeLittleEndian(size, static_cast<int32_t>(value.size()));
+    out.insert(out.end(), size, size + 4);
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value)
+{
+    uint8_t bytes[sizeof(T)];
+    writeLittleEndian(bytes, value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+void writePNG(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb)
+{
+    checkSize(width, height, rgb);
+    std::vector<uint8_t> pixels(rgb.size());
+    for (size_t i = 0; i < rgb.size(); ++i) {
+        const float c = std::clamp(rgb[i], 0.0f, 1.0f);
+        const float srgb = c <= 0.0031308f ? 12.92f * c : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        pixels[i] = static_cast<uint8_t>(std::lround(srgb * 255.0f));
+    }
+    if (!stbi_write_png(filename.c_str(), static_cast<int>(width), static_cast<int>(height), 3, pixels.data(),
+                        static_cast<int>(width * 3)))
+        throw std::runtime_error("failed to write the PNG file " + filename);
+}
+
+void writeEXR(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb)
+{
+    checkSize(width, height, rgb);
+
+    // magic number and version 2 for a single part scanline file
+    std::vector<uint8_t> out{0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0};
+
+    // the channels must be sorted by name, each is 32 bit float, linear, not subsampled
+    std::vector<uint8_t> channels;
+    for (const char* name : {"B", "G", "R"}) {
+        channels.push_back(static_cast<uint8_t>(name[0]));
+        channels.push_back(0);
+        put(channels, int32_t{2});
+        put(channels, uint32_t{0});
+        put(channels, int32_t{1});
+        put(channels, int32_t{1});
+    }
+    channels.push_back(0);
+    std::vector<uint8_t> window;
+    for (int32_t value : {0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1})
+        put(window, value);
+    std::vector<uint8_t> one, center;
+    put(one, 1.0f);
+    put(center, 0.0f);
+    put(center, 0.0f);
+    putAttribute(out, "channels", "chlist", channels);
+    putAttribute(out, "compression", "compression", {0});
+    putAttribute(out, "dataWindow", "box2i", window);
+    putAttribute(out, "displayWindow", "box2i", window);
+    putAttribute(out, "lineOrder", "lineOrder", {0});
+    putAttribute(out, "pixelAspectRatio", "float", one);
+    putAttribute(out, "screenWindowCenter", "v2f", center);
+    putAttribute(out, "screenWindowWidth", "float", one);
+    out.push_back(0);
+
+    // one block per scanline, the offset table points at each
+    const uint32_t lineBytes = width * 3 * sizeof(float);
+    const uint64_t firstBlock = out.size() + uint64_t{height} * sizeof(uint64_t);
+    for (uint32_t y = 0; y < height; ++y)
+        put(out, firstBlock + uint64_t{y} * (8 + lineBytes));
+    out.reserve(out.size() + size_t{height} * (8 + lineBytes));
+    for (uint32_t y = 0; y < height; ++y) {
+        put(out, static_cast<int32_t>(y));
+        put(out, lineBytes);
+        for (int channel = 2; channel >= 0; --channel)
+            for (uint32_t x = 0; x < width; ++x)
+                put(out, rgb[(size_t{y} * width + x) * 3 + channel]);
+    }
+
+    std::ofstream file{filename, std::ios::binary};
+    if (!file)
+        throw std::runtime_error("failed to open the EXR file " + filename + " for writing");
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    if (!file)
+        throw std::runtime_error("failed to write the EXR file " + filename);
+}
+
+void writeImage(const std::string& filename, uint32_t width, uint32_t height, const std::vector<float>& rgb)
+{
+    std::string extension = std::filesystem::path{filename}.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) -> char { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".png")
+        writePNG(filename, width, height, rgb);
+    else if (extension == ".exr")
+        writeEXR(filename, width, height, rgb);
+    else
+        throw std::runtime_error("unknown image format of " + filename + ", use .png or .exr");
+}
@@ -21,6 +21,8 @@
 #include <memory>
 #include <vector>
 
+#include "ambientocclusion.h"
+#include "memorywindow.h"
 #include "mesh.h"
 #include "meshcanvas.h"
 
@@ -55,7 +57,18 @@ public:
             m_display_controls = new MeshCanvasControls{gui, {10, 10}};
             m_display_controls->addMeshCanvas(m_leftCanvas);
             m_display_controls->addMeshCanvas(m_rightCanvas);
+            // baking takes a while on large meshes, so only on request
+            gui.add_button("Bake AO", [this]() -> void {
+                bakeAmbientOcclusion(mesh);
+                m_leftCanvas->uploadMesh(mesh);
+                m_exercise_controls->bakeMeshOcclusion();
+            });
             m_exercise_controls = new Exercise01Controls{gui, {400, 10}, mesh, m_rightCanvas};
+            m_memory_stats = new MemoryStatsWindow{gui, {10, 420}};
+            m_memory_stats->addMesh(mesh);
+            m_memory_stats->addMesh(m_exercise_controls->getTransformedMesh());
+            m_memory_stats->addMeshCanvas(m_leftCanvas);
+            m_memory_stats->addMeshCanvas(m_rightCanvas);
         }
 
         resize_event(framebuffer_size());
@@ -81,6 +94,7 @@ private:
     ref<MeshCanvas> m_rightCanvas;
     ref<MeshCanvasControls> m_display_controls;
     ref<Exercise01Controls> m_exercise_controls;
+    ref<MemoryStatsWindow> m_memory_stats;
 
     Mesh mesh;
 };
@@ -0,0 +1,100 @@
+#include "mappedfile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+#if defined(_WIN32)
+        fileHandle = std::exchange(other.fileHandle, nullptr);
+        mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#else
+        fileDescriptor = std::exchange(other.fileDescriptor, -1);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::open(const std::string& filename)
+{
+    close();
+    auto fail = [&](const char* what) -> void {
+        close();
+        throw std::runtime_error(std::string{what} + filename
+                                 + "\nmake sure you run the program in the correct folder!");
+    };
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        fail("failed to open the file ");
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+        fail("failed to get the size of the file ");
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (!length)
+        return;
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+        fail("failed to map the file ");
+    bytes = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes)
+        fail("failed to map the file ");
+#else
+    fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        fail("failed to open the file ");
+
+    struct stat status;
+    if (fstat(fileDescriptor, &status) != 0)
+        fail("failed to get the size of the file ");
+    length = static_cast<size_t>(status.st_size);
+    if (!length)
+        return;
+
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping == MAP_FAILED)
+        fail("failed to map the file ");
+    bytes = static_cast<const uint8_t*>(mapping);
+    madvise(mapping, length, MADV_SEQUENTIAL);
+#endif
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    fileHandle = mappingHandle = nullptr;
+#else
+    if (bytes)
+        munmap(const_cast<uint8_t*>(bytes), length);
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    bytes = nullptr;
+    length = 0;
+}
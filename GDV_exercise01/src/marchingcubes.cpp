@@ -0,0 +1,266 @@
+#include "marchingcubes.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+
+namespace {
+
+/// at most 5 triangles per cell, checked when the table is built
+constexpr uint32_t maxTriangles = 5;
+
+/// the triangles of a cell case as indices of the cell edges
+struct CellCase {
+    uint8_t count{0};
+    std::array<uint8_t, 3 * maxTriangles> edges{};
+};
+
+/**
+ * the corners of a cell are numbered by their x, y and z offset in bits 0, 1 and 2; edge
+ * 4 * axis + k runs along axis from the corner whose other two offsets are the bits of k
+ */
+uint8_t edgeIndex(uint32_t corner, uint32_t axis)
+{
+    const uint32_t k = axis == 0 ? (corner >> 1) & 3 : axis == 1 ? (corner & 1) | ((corner >> 1) & 2) : corner & 3;
+    return static_cast<uint8_t>(4 * axis + k);
+}
+
+std::array<CellCase, 256> buildCases()
+{
+    std::array<CellCase, 256> cases{};
+    for (uint32_t mask = 0; mask < 256; ++mask) {
+        // next[e] is the crossing after the one on edge e, the loops go counter-clockwise seen from outside
+        std::array<int, 12> next;
+        next.fill(-1);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            for (uint32_t side = 0; side < 2; ++side) {
+                // the face corners counter-clockwise seen from outside of the cell
+                const uint32_t u = 1u << ((axis + 1) % 3), v = 1u << ((axis + 2) % 3), base = side << axis;
+                std::array<uint32_t, 4> corners{base, base | u, base | u | v, base | v};
+                if (!side)
+                    std::swap(corners[1], corners[3]);
+
+                std::array<std::pair<uint8_t, bool>, 4> crossings;
+                size_t count = 0;
+                for (size_t i = 0; i < 4; ++i) {
+                    const uint32_t a = corners[i], b = corners[(i + 1) % 4];
+                    const bool insideA = (mask >> a) & 1, insideB = (mask >> b) & 1;
+                    if (insideA == insideB)
+                        continue;
+                    const uint32_t along = a ^ b;
+                    crossings[count++] = {edgeIndex(a & ~along, along == 1 ? 0 : along == 2 ? 1 : 2), insideB};
+                }
+                // from every crossing into the inside to the next crossing out of it, around one inside corner
+                for (size_t i = 0; i < count; ++i)
+                    if (crossings[i].second)
+                        next[crossings[i].first] = crossings[(i + 1) % count].first;
+            }
+        }
+
+        CellCase& cell = cases[mask];
+        std::array<bool, 12> used{};
+        for (int first = 0; first < 12; ++first) {
+            if (next[first] < 0 || used[first])
+                continue;
+            std::array<uint8_t, 12> loop;
+            size_t length = 0;
+            for (int e = first; !used[e]; e = next[e]) {
+                used[e] = true;
+                loop[length++] = static_cast<uint8_t>(e);
+            }
+            for (size_t i = 1; i + 1 < length; ++i) {
+                if (cell.count == maxTriangles)
+                    throw std::logic_error("a marching cubes case has too many triangles");
+                cell.edges[3 * cell.count] = loop[0];
+                cell.edges[3 * cell.count + 1] = loop[i];
+                cell.edges[3 * cell.count + 2] = loop[i + 1];
+                ++cell.count;
+            }
+        }
+    }
+    return cases;
+}
+
+const std::array<CellCase, 256>& cellCases()
+{
+    static const std::array<CellCase, 256> cases = buildCases();
+    return cases;
+}
+
+template <typename Field>
+Mesh extract(const Field& field, float isoValue)
+{
+    Mesh mesh;
+    const auto [nx, ny, nz] = field.dimensions();
+    if (nx < 2 || ny < 2 || nz < 2)
+        return mesh;
+    const std::array<CellCase, 256>& cases = cellCases();
+    const size_t planeSize = size_t{nx} * ny;
+    const uint32_t layers = nz - 1;
+    const size_t slabs = std::min<size_t>(chunkCount(size_t{layers} * planeSize, 1 << 16), layers);
+    auto slabStart = [&](size_t slab) -> uint32_t { return static_cast<uint32_t>(layers * slab / slabs); };
+
+    auto loadPlane = [&](uint32_t z, std::vector<float>& plane) -> void {
+        for (uint32_t y = 0; y < ny; ++y)
+            for (uint32_t x = 0; x < nx; ++x)
+                plane[size_t{y} * nx + x] = field.at(x, y, z);
+    };
+    auto crosses = [&](float a, float b) -> bool { return (a < isoValue) != (b < isoValue); };
+    auto cellMask = [&](const std::vector<float>& bottom, const std::vector<float>& top, size_t i) -> uint32_t {
+        const float corners[8] = {bottom[i], bottom[i + 1], bottom[i + nx], bottom[i + nx + 1],
+                                  top[i], top[i + 1], top[i + nx], top[i + nx + 1]};
+        uint32_t mask = 0;
+        for (uint32_t c = 0; c < 8; ++c)
+            mask |= static_cast<uint32_t>(corners[c] < isoValue) << c;
+        return mask;
+    };
+
+    // counting pass: the vertices on the edges a slab owns and the faces of its cells
+    std::vector<size_t> vertexStart(slabs + 1, 0), faceStart(slabs + 1, 0);
+    parallelForChunks(slabs, slabs, [&](size_t slab, size_t, size_t) -> void {
+        std::vector<float> bottom(planeSize), top(planeSize);
+        size_t vertices = 0, faces = 0;
+        auto countLevel = [&](const std::vector<float>& plane) -> void {
+            for (size_t i = 0; i < planeSize; ++i) {
+                const uint32_t x = static_cast<uint32_t>(i % nx);
+                vertices += x + 1 < nx && crosses(plane[i], plane[i + 1]);
+                vertices += i + nx < planeSize && crosses(plane[i], plane[i + nx]);
+            }
+        };
+        const uint32_t z0 = slabStart(slab), z1 = slabStart(slab + 1);
+        loadPlane(z0, bottom);
+        for (uint32_t z = z0; z < z1; ++z) {
+            loadPlane(z + 1, top);
+            countLevel(bottom);
+            for (size_t i = 0; i < planeSize; ++i) {
+                vertices += crosses(bottom[i], top[i]);
+                if (i % nx + 1 < nx && i + nx < planeSize)
+                    faces += cases[cellMask(bottom, top, i)].count;
+            }
+            std::swap(bottom, top);
+        }
+        if (slab + 1 == slabs)
+            countLevel(bottom);
+        vertexStart[slab + 1] = vertices;
+        faceStart[slab + 1] = faces;
+    });
+    for (size_t slab = 0; slab < slabs; ++slab) {
+        vertexStart[slab + 1] += vertexStart[slab];
+        faceStart[slab + 1] += faceStart[slab];
+    }
+    if (vertexStart[slabs] > UINT32_MAX)
+        throw std::runtime_error("the iso surface has too many vertices");
+
+    VertexList& vertices = mesh.getVertices();
+    NormalList& normals = mesh.getNormals();
+    FaceList& faces = mesh.getFaces();
+    vertices.resize(vertexStart[slabs]);
+    normals.resize(vertexStart[slabs]);
+    faces.resize(faceStart[slabs]);
+
+    // central differences, one-sided on the border of the grid
+    auto gradient = [&](uint32_t x, uint32_t y, uint32_t z) -> Point3D {
+        const uint32_t x0 = x ? x - 1 : 0, x1 = std::min(x + 1, nx - 1);
+        const uint32_t y0 = y ? y - 1 : 0, y1 = std::min(y + 1, ny - 1);
+        const uint32_t z0 = z ? z - 1 : 0, z1 = std::min(z + 1, nz - 1);
+        return {(field.at(x1, y, z) - field.at(x0, y, z)) / static_cast<float>(x1 - x0),
+                (field.at(x, y1, z) - field.at(x, y0, z)) / static_cast<float>(y1 - y0),
+                (field.at(x, y, z1) - field.at(x, y, z0)) / static_cast<float>(z1 - z0)};
+    };
+    auto addVertex = [&](uint32_t index, uint32_t x, uint32_t y, uint32_t z, uint32_t axis, float a, float b) -> void {
+        const uint32_t x1 = x + (axis == 0), y1 = y + (axis == 1), z1 = z + (axis == 2);
+        const float t = (isoValue - a) / (b - a);
+        const Point3D p0 = field.position(x, y, z);
+        const Point3D g0 = gradient(x, y, z);
+        vertices[index] = p0 + (field.position(x1, y1, z1) - p0) * t;
+        normals[index] = normalize(g0 + (gradient(x1, y1, z1) - g0) * t);
+    };
+
+    parallelForChunks(slabs, slabs, [&](size_t slab, size_t, size_t) -> void {
+        std::vector<float> bottom(planeSize), top(planeSize);
+        // vertex indices on the x and y edges of the bottom and top sample layer and on the z edges between them
+        std::vector<uint32_t> xEdges[2] = {std::vector<uint32_t>(planeSize), std::vector<uint32_t>(planeSize)};
+        std::vector<uint32_t> yEdges[2] = {std::vector<uint32_t>(planeSize), std::vector<uint32_t>(planeSize)};
+        std::vector<uint32_t> zEdges(planeSize);
+
+        // the edges of a sample layer in order, only the owning slab writes their vertices
+        auto numberLevel = [&](uint32_t z, const std::vector<float>& plane, std::vector<uint32_t>& xCache,
+                               std::vector<uint32_t>& yCache, uint32_t next, bool owned) -> uint32_t {
+            for (uint32_t y = 0; y < ny; ++y) {
+                for (uint32_t x = 0; x < nx; ++x) {
+                    const size_t i = size_t{y} * nx + x;
+                    if (x + 1 < nx && crosses(plane[i], plane[i + 1])) {
+                        if (owned)
+                            addVertex(next, x, y, z, 0, plane[i], plane[i + 1]);
+                        xCache[i] = next++;
+                    }
+                    if (y + 1 < ny && crosses(plane[i], plane[i + nx])) {
+                        if (owned)
+                            addVertex(next, x, y, z, 1, plane[i], plane[i + nx]);
+                        yCache[i] = next++;
+                    }
+                }
+            }
+            return next;
+        };
+
+        const uint32_t z0 = slabStart(slab), z1 = slabStart(slab + 1);
+        uint32_t nextVertex = static_cast<uint32_t>(vertexStart[slab]);
+        size_t nextFace = faceStart[slab];
+        loadPlane(z0, bottom);
+        nextVertex = numberLevel(z0, bottom, xEdges[0], yEdges[0], nextVertex, true);
+        for (uint32_t z = z0; z < z1; ++z) {
+            loadPlane(z + 1, top);
+            for (uint32_t y = 0; y < ny; ++y) {
+                for (uint32_t x = 0; x < nx; ++x) {
+                    const size_t i = size_t{y} * nx + x;
+                    if (crosses(bottom[i], top[i])) {
+                        addVertex(nextVertex, x, y, z, 2, bottom[i], top[i]);
+                        zEdges[i] = nextVertex++;
+                    }
+                }
+            }
+            // the first sample layer of the next slab is numbered by that slab, from its first vertex on
+            if (z + 1 < z1 || slab + 1 == slabs)
+                nextVertex = numberLevel(z + 1, top, xEdges[1], yEdges[1], nextVertex, true);
+            else
+                numberLevel(z + 1, top, xEdges[1], yEdges[1], static_cast<uint32_t>(vertexStart[slab + 1]), false);
+
+            for (uint32_t y = 0; y + 1 < ny; ++y) {
+                for (uint32_t x = 0; x + 1 < nx; ++x) {
+                    const size_t i = size_t{y} * nx + x;
+                    const CellCase& cell = cases[cellMask(bottom, top, i)];
+                    uint32_t corners[3 * maxTriangles];
+                    for (uint32_t c = 0; c < 3u * cell.count; ++c) {
+                        const uint32_t edge = cell.edges[c], k = edge % 4, low = k & 1, high = k >> 1;
+                        switch (edge / 4) {
+                        case 0: corners[c] = xEdges[high][i + low * nx]; break;
+                        case 1: corners[c] = yEdges[high][i + low]; break;
+                        default: corners[c] = zEdges[i + low + high * nx]; break;
+                        }
+                    }
+                    for (uint32_t t = 0; t < cell.count; ++t)
+                        faces[nextFace++] = {corners[3 * t], corners[3 * t + 1], corners[3 * t + 2]};
+                }
+            }
+            std::swap(bottom, top);
+            std::swap(xEdges[0], xEdges[1]);
+            std::swap(yEdges[0], yEdges[1]);
+        }
+    });
+
+    if (!faces.empty())
+        mesh.getSmoothGroups().emplace_back(0, faces.size());
+    mesh.updateBounds();
+    mesh.updateFaceAreas();
+    return mesh;
+}
+
+} // namespace
+
+Mesh marchingCubes(const ScalarGrid& grid, float isoValue) { return extract(grid, isoValue); }
+
+Mesh marchingCubes(const SignedDistanceField& field, float isoValue) { return extract(field, isoValue); }
@@ -0,0 +1,51 @@
+#include "memorystats.h"
+
+#include <array>
+#include <cstdio>
+
+namespace {
+std::array<MemoryCounter, static_cast<size_t>(MemoryCategory::Count)> counters;
+MemoryCounter total;
+} // namespace
+
+MemoryCounter& memoryCounter(MemoryCategory category)
+{
+    return counters.at(static_cast<size_t>(category));
+}
+
+MemoryCounter& totalMemoryCounter() { return total; }
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::Vertices: return "vertices";
+    case MemoryCategory::Faces: return "faces";
+    case MemoryCategory::Normals: return "normals";
+    case MemoryCategory::TextureCoordinates: return "texture coordinates";
+    case MemoryCategory::FaceAreas: return "face areas";
+    case MemoryCategory::SmoothGroups: return "smooth groups";
+    case MemoryCategory::AmbientOcclusion: return "ambient occlusion";
+    case MemoryCategory::AccelerationStructures: return "acceleration structures";
+    case MemoryCategory::DistanceFields: return "distance fields";
+    case MemoryCategory::Temporary: return "temporary";
+    case MemoryCategory::Count: break;
+    }
+    return "unknown";
+}
+
+std::string formatBytes(size_t bytes)
+{
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < std::size(units)) {
+        value /= 1024.0;
+        ++unit;
+    }
+    char buffer[32];
+    if (unit == 0)
+        std::snprintf(buffer, sizeof(buffer), "%zu B", bytes);
+    else
+        std::snprintf(buffer, sizeof(buffer), "%.2f %s", value, units[unit]);
+    return buffer;
+}
@@ -1,16 +1,106 @@
 #include "mesh.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 
-void Mesh::loadOBJ(const std::string& filename)
+#include "parallel.h"
+
+namespace {
+
+/// indices of an OBJ face corner, missing texture coordinates and normals are none
+struct CornerKey {
+    static constexpr uint32_t none = UINT32_MAX;
+
+    uint32_t v{none}, vt{none}, vn{none};
+
+    bool operator==(const CornerKey& other) const = default;
+};
+
+/**
+ * @brief open addressing (linear probing) map from OBJ face corners to mesh vertex indices
+ * the table only holds 4 byte indices into the list of distinct corners, which is ordered
+ * by vertex index and doubles as the list of vertices to create
+ */
+class CornerMap {
+public:
+    const CountedVector<CornerKey, MemoryCategory::Temporary>& getCorners() const { return corners; }
+
+    /// get the index of the corner, assign the next index if it is new
+    uint32_t insert(const CornerKey& key)
+    {
+        if (2 * (corners.size() + 1) > table.size())
+            grow();
+        const size_t mask = table.size() - 1;
+        size_t slot = hash(key) & mask;
+        for (; table[slot] != CornerKey::none; slot = (slot + 1) & mask)
+            if (corners[table[slot]] == key)
+                return table[slot];
+        table[slot] = static_cast<uint32_t>(corners.size());
+        corners.push_back(key);
+        return table[slot];
+    }
+
+private:
+    static size_t hash(const CornerKey& key)
+    {
+        uint64_t h = key.v * 0x9E3779B97F4A7C15ull;
+        h ^= (key.vt + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4Full;
+        h ^= (key.vn + (h << 6) + (h >> 2)) * 0x165667B19E3779F9ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    void grow()
+    {
+        table.assign(std::max<size_t>(1024, table.size() * 2), CornerKey::none);
+        const size_t mask = table.size() - 1;
+        for (uint32_t i = 0; i < corners.size(); ++i) {
+            size_t slot = hash(corners[i]) & mask;
+            while (table[slot] != CornerKey::none)
+                slot = (slot + 1) & mask;
+            table[slot] = i;
+        }
+    }
+
+    CountedVector<uint32_t, MemoryCategory::Temporary> table;
+    CountedVector<CornerKey, MemoryCategory::Temporary> corners;
+};
+
+} // namespace
+
+void Mesh::load(const std::string& filename)
+{
+    std::string extension = std::filesystem::path{filename}.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".obj")
+        loadOBJ(filename);
+    else if (extension == ".ply")
+        loadPLY(filename);
+    else if (extension == ".stl")
+        loadSTL(filename);
+    else if (extension == ".glb")
+        loadGLB(filename);
+    else if (extension == ".gdvm")
+        loadCompressed(filename);
+    else
+        throw std::runtime_error("unknown mesh file format " + filename);
+}
+
+void Mesh::loadOBJ(const std::string& filename, OBJVertexMode mode)
 {
     clear();
 
+    // the peak memory of the load is measured from here
+    const MemoryPeakScope memoryScope;
+
     std::ifstream file{filename};
     file.exceptions(std::ios::badbit);
     std::string buffer;
@@ -27,9 +117,12 @@ void Mesh::loadOBJ(const std::string& filename)
         }
     };
 
-    std::vector<Vertex> objNormals;
-    std::vector<TextureCoordinate> objTexCoords;
-    std::vector<std::optional<TriangleIndices>> normalIndices, textureIndices;
+    const bool split = mode == OBJVertexMode::SplitAttributes;
+
+    CountedVector<Vertex, MemoryCategory::Temporary> objPositions, objNormals;
+    CountedVector<TextureCoordinate, MemoryCategory::Temporary> objTexCoords;
+    CountedVector<std::optional<TriangleIndices>, MemoryCategory::Temporary> normalIndices, textureIndices;
+    CornerMap corners;
 
     size_t currentSmoothGroup = 0;
 
@@ -59,6 +152,10 @@ void Mesh::loadOBJ(const std::string& filename)
                 if (subtype == 'n') {
                     objNormals.push_back(v);
                 }
+                else if (split) {
+                    aabb.extend(v);
+                    objPositions.push_back(v);
+                }
                 else {
                     aabb.extend(v);
                     vertices.push_back(v);
@@ -109,18 +206,27 @@ void Mesh::loadOBJ(const std::string& filename)
             readIndices(t.v3, tt.v3, tn.v3);
             check();
 
+            auto corner = [&](uint32_t v, uint32_t vt, uint32_t vn) -> uint32_t {
+                return corners.insert({v, hasTexture ? vt : CornerKey::none, hasNormal ? vn : CornerKey::none});
+            };
+
             while (in) {
-                if (hasNormal) {
+                if (split) {
+                    faces.push_back({corner(t.v1, tt.v1, tn.v1), corner(t.v2, tt.v2, tn.v2),
+                                     corner(t.v3, tt.v3, tn.v3)});
+                }
+                else if (hasNormal) {
                     if (normalIndices.size() < faces.size())
                         normalIndices.resize(faces.size());
                     normalIndices.emplace_back(tn);
                 }
-                if (hasTexture) {
+                if (!split && hasTexture) {
                     if (textureIndices.size() < faces.size())
                         textureIndices.resize(faces.size());
                     textureIndices.emplace_back(tt);
                 }
-                faces.push_back(t);
+                if (!split)
+                    faces.push_back(t);
 
                 t.v2 = t.v3;
                 tn.v2 = tn.v3;
@@ -144,9 +250,29 @@ void Mesh::loadOBJ(const std::string& filename)
 
     file.close();
 
-    // compute face areas, and normals (and texture coordinates, if any) per vertex
-    {
-        std::vector<float> weights(vertices.size());
+    if (split) {
+        // every distinct corner becomes a vertex with exactly the attributes of the file
+        const auto& distinct = corners.getCorners();
+        vertices.resize(distinct.size());
+        bool hasTexCoords = false;
+        for (size_t i = 0; i < distinct.size(); ++i) {
+            vertices[i] = objPositions.at(distinct[i].v);
+            hasTexCoords |= distinct[i].vt != CornerKey::none;
+        }
+        updateFaceAreas();
+        updateNormals();
+        if (hasTexCoords)
+            texCoords.resize(vertices.size());
+        for (size_t i = 0; i < distinct.size(); ++i) {
+            if (distinct[i].vn != CornerKey::none)
+                normals[i] = objNormals.at(distinct[i].vn);
+            if (distinct[i].vt != CornerKey::none)
+                texCoords[i] = objTexCoords.at(distinct[i].vt);
+        }
+    }
+    else {
+        // compute face areas, and normals (and texture coordinates, if any) per vertex
+        CountedVector<float, MemoryCategory::Temporary> weights(vertices.size());
 
         faceAreas.resize(faces.size());
         normals.resize(vertices.size());
@@ -215,11 +341,202 @@ void Mesh::loadOBJ(const std::string& filename)
         }
     }
 
+    peakLoadTransient = memoryScope.transient(getMemoryUsage().resident());
+
     std::cout << "Loaded OBJ file: " << filename << " containing " << vertices.size()
               << " vertices, " << objNormals.size() << " vertex normals, " << objTexCoords.size()
               << " texture coordinates, and " << faces.size() << " faces." << std::endl;
 }
 
+void Mesh::updateFaceAreas()
+{
+    faceAreas.resize(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const TriangleIndices& t = faces[i];
+            const Vertex& v1 = vertices[t.v1];
+            faceAreas[i] = cross(vertices[t.v2] - v1, vertices[t.v3] - v1).norm() * 0.5f;
+        }
+    });
+}
+
+void Mesh::updateNormals()
+{
+    normals.assign(vertices.size(), Vertex{});
+
+    bool shadeFlat = true;
+    auto currentSmoothGroup = smoothGroups.cbegin();
+
+    for (size_t i = 0; i < faces.size(); ++i) {
+        if (currentSmoothGroup != smoothGroups.end()) {
+            if (i == currentSmoothGroup->first)
+                shadeFlat = false;
+            if (i == currentSmoothGroup->second) {
+                shadeFlat = true;
+                ++currentSmoothGroup;
+                if (currentSmoothGroup != smoothGroups.end() && i == currentSmoothGroup->first)
+                    shadeFlat = false;
+            }
+        }
+
+        const TriangleIndices& t = faces[i];
+        const Vertex v1v2 = normalize(vertices[t.v2] - vertices[t.v1]);
+        const Vertex v1v3 = normalize(vertices[t.v3] - vertices[t.v1]);
+        const Vertex v2v3 = normalize(vertices[t.v3] - vertices[t.v2]);
+        const Vertex up = normalize(cross(v1v2, v1v3));
+
+        // weight = angle covered by the triangle
+        normals[t.v1] += up * std::acos(std::clamp(dot(v1v2, v1v3), -1.0f, 1.0f));
+        if (!shadeFlat) {
+            normals[t.v2] += up * std::acos(std::clamp(-dot(v1v2, v2v3), -1.0f, 1.0f));
+            normals[t.v3] += up * std::acos(std::clamp(dot(v2v3, v1v3), -1.0f, 1.0f));
+        }
+    }
+
+    parallelFor(normals.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            normals[i] = normalize(normals[i]);
+    });
+}
+
+size_t Mesh::removeUnreferencedVertices()
+{
+    constexpr uint32_t unused = UINT32_MAX;
+    const size_t count = vertices.size();
+    CountedVector<uint32_t, MemoryCategory::Temporary> remap(count, unused);
+    // all faces store the same value, the atomic stores only make the concurrent writes well defined
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            for (uint32_t v : {faces[i].v1, faces[i].v2, faces[i].v3})
+                std::atomic_ref{remap[v]}.store(0, std::memory_order_relaxed);
+    });
+
+    // new indices from per chunk counts of the referenced vertices
+    const size_t chunks = chunkCount(count);
+    std::vector<uint32_t> keptBefore(chunks + 1, 0);
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        keptBefore[chunk + 1] = static_cast<uint32_t>(std::count(remap.begin() + begin, remap.begin() + end, 0u));
+    });
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+        keptBefore[chunk + 1] += keptBefore[chunk];
+    const uint32_t kept = keptBefore[chunks];
+    const size_t removed = count - kept;
+    if (!removed)
+        return 0;
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        uint32_t next = keptBefore[chunk];
+        for (size_t i = begin; i < end; ++i)
+            if (remap[i] != unused)
+                remap[i] = next++;
+    });
+
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            faces[i] = {remap[faces[i].v1], remap[faces[i].v2], remap[faces[i].v3]};
+    });
+
+    // copying into exactly sized arrays also releases the unused capacity
+    auto compact = [&](auto& attribute) -> void {
+        if (attribute.size() != count)
+            return;
+        std::remove_reference_t<decltype(attribute)> compacted(kept);
+        parallelFor(count, [&](size_t begin, size_t end) -> void {
+            for (size_t i = begin; i < end; ++i)
+                if (remap[i] != unused)
+                    compacted[remap[i]] = attribute[i];
+        });
+        attribute = std::move(compacted);
+    };
+    compact(normals);
+    compact(texCoords);
+    compact(ambientOcclusion);
+    compact(vertices);
+
+    return removed;
+}
+
+void Mesh::removeFaces(const std::vector<uint8_t>& keep)
+{
+    // keptBefore[i] is the new index of face i, counted per chunk and then offset
+    const size_t count = faces.size();
+    const size_t chunks = chunkCount(count);
+    CountedVector<size_t, MemoryCategory::Temporary> keptBefore(count + 1, 0);
+    std::vector<size_t> chunkOffsets(chunks + 1, 0);
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        size_t kept = 0;
+        for (size_t i = begin; i < end; ++i) {
+            keptBefore[i] = kept;
+            kept += keep[i] ? 1 : 0;
+        }
+        chunkOffsets[chunk + 1] = kept;
+    });
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+        chunkOffsets[chunk + 1] += chunkOffsets[chunk];
+    keptBefore[count] = chunkOffsets[chunks];
+    if (keptBefore[count] == count)
+        return;
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            keptBefore[i] += chunkOffsets[chunk];
+    });
+
+    const bool hasAreas = faceAreas.size() == count;
+    FaceList keptFaces(keptBefore[count]);
+    FaceAreaList keptAreas(hasAreas ? keptBefore[count] : 0);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            if (keep[i]) {
+                keptFaces[keptBefore[i]] = faces[i];
+                if (hasAreas)
+                    keptAreas[keptBefore[i]] = faceAreas[i];
+            }
+        }
+    });
+    faces = std::move(keptFaces);
+    if (hasAreas)
+        faceAreas = std::move(keptAreas);
+
+    SmoothGroupList remapped;
+    for (const auto& [start, end] : smoothGroups) {
+        const size_t newStart = keptBefore.at(start), newEnd = keptBefore.at(end);
+        if (newEnd > newStart)
+            remapped.emplace_back(newStart, newEnd);
+    }
+    smoothGroups = std::move(remapped);
+}
+
+MeshMemoryUsage Mesh::getMemoryUsage() const
+{
+    MeshMemoryUsage usage;
+    usage.vertices = vertices.capacity() * sizeof(Vertex);
+    usage.faces = faces.capacity() * sizeof(TriangleIndices);
+    usage.normals = normals.capacity() * sizeof(Vertex);
+    usage.texCoords = texCoords.capacity() * sizeof(TextureCoordinate);
+    usage.faceAreas = faceAreas.capacity() * sizeof(float);
+    usage.smoothGroups = smoothGroups.capacity() * sizeof(std::pair<size_t, size_t>);
+    usage.ambientOcclusion = ambientOcclusion.capacity() * sizeof(float);
+    usage.peakLoadTransient = peakLoadTransient;
+    return usage;
+}
+
+std::ostream& operator<<(std::ostream& os, const MeshMemoryUsage& usage)
+{
+    auto row = [&](const char* name, size_t bytes) -> void {
+        os << "  " << std::left << std::setw(22) << name << std::right << std::setw(12)
+           << formatBytes(bytes) << '\n';
+    };
+    row("vertices", usage.vertices);
+    row("faces", usage.faces);
+    row("normals", usage.normals);
+    row("texture coordinates", usage.texCoords);
+    row("face areas", usage.faceAreas);
+    row("smooth groups", usage.smoothGroups);
+    row("ambient occlusion", usage.ambientOcclusion);
+    row("resident", usage.resident());
+    row("peak load transient", usage.peakLoadTransient);
+    return os;
+}
+
 void Mesh::updateBounds()
 {
     aabb = {};
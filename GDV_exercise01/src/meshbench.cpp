@@ -0,0 +1,707 @@
+/*
+    src/meshbench.cpp -- command line benchmark for the mesh processing code.
+
+    usage: meshbench [mesh files...]
+    without arguments the bunny from the meshes folder is used, the compression
+    benchmark additionally runs on a synthetic terrain.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ambientocclusion.h"
+#include "bvh.h"
+#include "halfedge.h"
+#include "marchingcubes.h"
+#include "memorystats.h"
+#include "mesh.h"
+#include "meshchunks.h"
+#include "meshdistance.h"
+#include "meshintersection.h"
+#include "meshsmoother.h"
+#include "occlusionculler.h"
+#include "parallel.h"
+#include "scene.h"
+#include "signeddistancefield.h"
+#include "surfacesampler.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+Mesh benchmarkLoad(const std::string& filename, OBJVertexMode mode)
+{
+    Mesh mesh;
+    const auto start = Clock::now();
+    mesh.loadOBJ(filename, mode);
+    const double loadTime = millisecondsSince(start);
+
+    std::cout << "[load" << (mode == OBJVertexMode::SplitAttributes ? " split" : "") << "] "
+              << filename << ": " << loadTime << " ms\n"
+              << mesh.getMemoryUsage();
+    return mesh;
+}
+
+void benchmarkHalfEdge(const Mesh& mesh)
+{
+    const auto start = Clock::now();
+    HalfEdgeMesh halfEdges{mesh};
+    const double buildTime = millisecondsSince(start);
+
+    std::cout << "[half-edge] build: " << buildTime << " ms, " << halfEdges.boundaryLoops().size()
+              << " boundary loops, " << halfEdges.numNonManifoldEdges() << " non-manifold edges, "
+              << halfEdges.numNonManifoldVertices() << " non-manifold vertices\n";
+}
+
+void benchmarkWeld(Mesh mesh, float epsilon)
+{
+    const size_t before = mesh.getVertices().size();
+    const auto start = Clock::now();
+    const size_t removed = mesh.weldVertices(epsilon);
+    const double weldTime = millisecondsSince(start);
+
+    std::cout << "[weld] epsilon " << epsilon << ": " << weldTime << " ms, removed " << removed
+              << " of " << before << " vertices\n";
+}
+
+void benchmarkSaveOBJ(const Mesh& mesh)
+{
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.obj";
+    for (bool parallel : {false, true}) {
+        const auto start = Clock::now();
+        mesh.saveOBJ(path.string(), parallel);
+        const double saveTime = millisecondsSince(start);
+        const double megabytes = static_cast<double>(std::filesystem::file_size(path)) / 1e6;
+
+        std::cout << "[save OBJ" << (parallel ? " parallel" : "") << "] " << saveTime << " ms, "
+                  << megabytes / saveTime * 1000.0 << " MB/s\n";
+    }
+    std::filesystem::remove(path);
+}
+
+void benchmarkPLY(const Mesh& mesh)
+{
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.ply";
+    auto start = Clock::now();
+    mesh.savePLY(path.string());
+    const double saveTime = millisecondsSince(start);
+    const double megabytes = static_cast<double>(std::filesystem::file_size(path)) / 1e6;
+
+    start = Clock::now();
+    Mesh loaded;
+    loaded.loadPLY(path.string());
+    const double loadTime = millisecondsSince(start);
+    std::filesystem::remove(path);
+
+    std::cout << "[save PLY] " << saveTime << " ms, " << megabytes / saveTime * 1000.0 << " MB/s\n"
+              << "[load PLY] " << loadTime << " ms, " << megabytes / loadTime * 1000.0 << " MB/s\n";
+}
+
+void benchmarkSTL(const Mesh& mesh)
+{
+    // write an unindexed binary STL like CAD tools do, so the import has to deduplicate all corners
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.stl";
+    {
+        std::ofstream file{path, std::ios::binary};
+        const std::string header(80, ' ');
+        const auto count = static_cast<uint32_t>(mesh.getFaces().size());
+        file.write(header.data(), 80);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        const float normal[3]{};
+        const uint16_t attributes = 0;
+        for (const TriangleIndices& t : mesh.getFaces()) {
+            file.write(reinterpret_cast<const char*>(normal), sizeof(normal));
+            for (uint32_t index : {t.v1, t.v2, t.v3})
+                file.write(reinterpret_cast<const char*>(&mesh.getVertices()[index]), sizeof(Vertex));
+            file.write(reinterpret_cast<const char*>(&attributes), sizeof(attributes));
+        }
+    }
+
+    const auto start = Clock::now();
+    Mesh loaded;
+    loaded.loadSTL(path.string());
+    const double loadTime = millisecondsSince(start);
+    std::filesystem::remove(path);
+
+    std::cout << "[load STL] " << loadTime << " ms, "
+              << static_cast<double>(loaded.getFaces().size()) / loadTime / 1000.0 << " M triangles/s\n";
+}
+
+/// write a GLB file with one indexed triangle primitive and one empty primitive, like exporters emit for empty nodes
+void writeGLB(const Mesh& mesh, const std::filesystem::path& path)
+{
+    const bool hasNormals = mesh.getNormals().size() == mesh.getVertices().size();
+    const size_t vertexBytes = mesh.getVertices().size() * sizeof(Vertex);
+    const size_t normalBytes = hasNormals ? vertexBytes : 0;
+    const size_t indexBytes = mesh.getFaces().size() * sizeof(TriangleIndices);
+    const size_t binBytes = vertexBytes + normalBytes + indexBytes;
+
+    const std::string vertexCount = std::to_string(mesh.getVertices().size());
+    std::string json = R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":)" + std::to_string(binBytes)
+                     + R"(}],"bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":)" + std::to_string(vertexBytes)
+                     + R"(},{"buffer":0,"byteOffset":)" + std::to_string(vertexBytes + normalBytes)
+                     + R"(,"byteLength":)" + std::to_string(indexBytes);
+    if (hasNormals)
+        json += R"(},{"buffer":0,"byteOffset":)" + std::to_string(vertexBytes) + R"(,"byteLength":)"
+              + std::to_string(normalBytes);
+    json += R"(}],"accessors":[{"bufferView":0,"componentType":5126,"type":"VEC3","count":)" + vertexCount
+          + R"(},{"bufferView":1,"componentType":5125,"type":"SCALAR","count":)"
+          + std::to_string(mesh.getFaces().size() * 3)
+          + R"(},{"bufferView":0,"componentType":5126,"type":"VEC3","count":0})";
+    if (hasNormals)
+        json += R"(,{"bufferView":2,"componentType":5126,"type":"VEC3","count":)" + vertexCount + "}";
+    json += R"(],"meshes":[{"name":"meshbench","primitives":[{"attributes":{"POSITION":0)";
+    if (hasNormals)
+        json += R"(,"NORMAL":3)";
+    json += R"(},"indices":1},{"attributes":{"POSITION":2}}]}]})";
+    json.resize((json.size() + 3) / 4 * 4, ' ');
+
+    std::ofstream file{path, std::ios::binary};
+    auto write = [&](uint32_t value) -> void { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    write(0x46546C67u); // "glTF"
+    write(2);
+    write(static_cast<uint32_t>(12 + 8 + json.size() + 8 + binBytes));
+    write(static_cast<uint32_t>(json.size()));
+    write(0x4E4F534Au); // "JSON"
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    write(static_cast<uint32_t>(binBytes));
+    write(0x004E4942u); // "BIN"
+    file.write(reinterpret_cast<const char*>(mesh.getVertices().data()), static_cast<std::streamsize>(vertexBytes));
+    if (hasNormals)
+        file.write(reinterpret_cast<const char*>(mesh.getNormals().data()), static_cast<std::streamsize>(normalBytes));
+    file.write(reinterpret_cast<const char*>(mesh.getFaces().data()), static_cast<std::streamsize>(indexBytes));
+}
+
+void benchmarkGLB(const Mesh& mesh)
+{
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.glb";
+    writeGLB(mesh, path);
+    const double megabytes = static_cast<double>(std::filesystem::file_size(path)) / 1e6;
+
+    const auto start = Clock::now();
+    Mesh loaded;
+    loaded.loadGLB(path.string());
+    const double loadTime = millisecondsSince(start);
+    std::filesystem::remove(path);
+
+    const bool same = std::equal(loaded.getVertices().begin(), loaded.getVertices().end(),
+                                 mesh.getVertices().begin(), mesh.getVertices().end())
+                   && std::equal(loaded.getFaces().begin(), loaded.getFaces().end(), mesh.getFaces().begin(),
+                                 mesh.getFaces().end(), [](const TriangleIndices& a, const TriangleIndices& b) -> bool {
+                                     return a.v1 == b.v1 && a.v2 == b.v2 && a.v3 == b.v3;
+                                 });
+    std::cout << "[load GLB] " << loadTime << " ms, " << megabytes / loadTime * 1000.0 << " MB/s, "
+              << (same ? "identical" : "DIFFERENT") << " vertices and faces\n";
+}
+
+void benchmarkCompression(const Mesh& mesh, const std::string& name)
+{
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.gdvm";
+    auto start = Clock::now();
+    mesh.saveCompressed(path.string());
+    const double saveTime = millisecondsSince(start);
+    const auto compressedBytes = static_cast<double>(std::filesystem::file_size(path));
+
+    start = Clock::now();
+    Mesh loaded;
+    loaded.loadCompressed(path.string());
+    const double loadTime = millisecondsSince(start);
+    std::filesystem::remove(path);
+
+    // the size of the plain attribute arrays, which is what a raw binary dump would have to read
+    const auto rawBytes = static_cast<double>(mesh.getVertices().size() * sizeof(Vertex)
+                                              + mesh.getFaces().size() * sizeof(TriangleIndices)
+                                              + mesh.getNormals().size() * sizeof(Vertex)
+                                              + mesh.getTextureCoordinates().size() * sizeof(TextureCoordinate));
+    // reading the compressed file and decoding it is faster than reading the raw arrays from
+    // any drive slower than this
+    const double breakEven = (rawBytes - compressedBytes) / 1e6 / loadTime * 1000.0;
+
+    std::cout << "[compression] " << name << ": ratio " << rawBytes / compressedBytes << ", encode " << saveTime
+              << " ms, decode " << loadTime << " ms (" << rawBytes / 1e6 / loadTime * 1000.0
+              << " MB/s decoded), faster than raw reads below " << breakEven << " MB/s\n";
+}
+
+/// a smooth height field with normals and texture coordinates, (n+1)^2 vertices and 2n^2 faces
+Mesh syntheticTerrain(uint32_t n)
+{
+    Mesh mesh;
+    auto& vertices = mesh.getVertices();
+    auto& texCoords = mesh.getTextureCoordinates();
+    auto& faces = mesh.getFaces();
+    const float step = 1.0f / static_cast<float>(n);
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            const float u = static_cast<float>(x) * step, v = static_cast<float>(y) * step;
+            vertices.push_back({u, v, 0.05f * std::sin(20.0f * u) * std::cos(17.0f * v)});
+            texCoords.push_back({u, v});
+        }
+    }
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const uint32_t a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            faces.push_back({a, b, d});
+            faces.push_back({a, d, c});
+        }
+    }
+    mesh.getSmoothGroups().emplace_back(0, faces.size());
+    mesh.updateBounds();
+    mesh.updateFaceAreas();
+    mesh.updateNormals();
+    return mesh;
+}
+
+void benchmarkSubdivision(Mesh mesh, unsigned levels)
+{
+    const auto start = Clock::now();
+    mesh.subdivideLoop(levels);
+    const double subdivideTime = millisecondsSince(start);
+
+    std::cout << "[subdivide] " << levels << " Loop levels: " << subdivideTime << " ms, "
+              << mesh.getFaces().size() << " faces, " << formatBytes(mesh.getMemoryUsage().resident()) << "\n";
+}
+
+void benchmarkSmoothing(const Mesh& mesh)
+{
+    for (SmoothingWeights weights : {SmoothingWeights::Uniform, SmoothingWeights::Cotangent}) {
+        Mesh smoothed = mesh;
+        const auto start = Clock::now();
+        const MeshSmoother smoother{smoothed, weights};
+        const double buildTime = millisecondsSince(start);
+        const auto smoothStart = Clock::now();
+        smoother.taubin(smoothed, 10);
+        const double smoothTime = millisecondsSince(smoothStart);
+
+        std::cout << "[smooth" << (weights == SmoothingWeights::Cotangent ? " cotangent" : "") << "] build: "
+                  << buildTime << " ms, " << smoother.numEntries() << " entries, 10 Taubin iterations: "
+                  << smoothTime << " ms\n";
+    }
+}
+
+void benchmarkSampling(const Mesh& mesh)
+{
+    const SurfaceSampler sampler{mesh};
+    const size_t count = 4'000'000;
+    const auto start = Clock::now();
+    const std::vector<SurfaceSample> samples = sampler.sample(count);
+    const double sampleTime = millisecondsSince(start);
+
+    const float radius = 0.01f * mesh.getBounds().extents().maxComponent();
+    const auto poissonStart = Clock::now();
+    const std::vector<SurfaceSample> blueNoise = sampler.samplePoissonDisk(radius);
+    const double poissonTime = millisecondsSince(poissonStart);
+
+    std::cout << "[sample] " << count << " points: " << sampleTime << " ms, "
+              << static_cast<double>(count) / sampleTime / 1000.0 << " M points/s, Poisson disk: "
+              << blueNoise.size() << " points in " << poissonTime << " ms\n";
+}
+
+void benchmarkBVH(Mesh mesh)
+{
+    const auto start = Clock::now();
+    TriangleBVH bvh{mesh};
+    const double buildTime = millisecondsSince(start);
+
+    // rays from a sphere around the mesh towards random points inside its bounds
+    const AABB bounds = mesh.getBounds();
+    const float radius = bounds.extents().norm();
+    std::vector<Ray> rays(1'000'000);
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+    std::normal_distribution<float> normal;
+    for (Ray& ray : rays) {
+        const Point3D target = bounds.min + bounds.extents() * Point3D{uniform(rng), uniform(rng), uniform(rng)};
+        ray.origin = bounds.center() + normalize(Point3D{normal(rng), normal(rng), normal(rng)}) * radius;
+        ray.direction = target - ray.origin;
+    }
+    const size_t chunks = chunkCount(rays.size(), 1024);
+    std::vector<size_t> chunkHits(chunks);
+    const auto traceStart = Clock::now();
+    parallelForChunks(rays.size(), chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            RayHit hit;
+            chunkHits[chunk] += bvh.intersect(rays[i], hit);
+        }
+    });
+    const double traceTime = millisecondsSince(traceStart);
+    const size_t hits = std::accumulate(chunkHits.begin(), chunkHits.end(), size_t{0});
+
+    std::cout << "[bvh] build: " << buildTime << " ms, " << bvh.getNodes().size() << " nodes, SAH cost "
+              << bvh.sahCost() << ", " << rays.size() << " rays: " << traceTime << " ms, "
+              << static_cast<double>(rays.size()) / traceTime / 1000.0 << " M rays/s, " << hits << " hits\n";
+
+    // a rigid rotation and a deformation which moves half of the mesh
+    const Point3D center = bounds.center();
+    for (Vertex& v : mesh.getVertices()) {
+        const Point3D p = v - center;
+        v = center + Point3D{0.866f * p.x + 0.5f * p.z, p.y, -0.5f * p.x + 0.866f * p.z};
+    }
+    const char* results[] = {"refitted", "restructured", "rebuilt"};
+    const auto refitStart = Clock::now();
+    TriangleBVH::RefitResult result = bvh.refit();
+    std::cout << "[bvh] rotation: " << results[static_cast<int>(result)] << " in " << millisecondsSince(refitStart)
+              << " ms, SAH cost " << bvh.sahCost() << '\n';
+
+    for (Vertex& v : mesh.getVertices())
+        if (v.x > center.x)
+            v.y += 0.2f * radius;
+    const auto deformStart = Clock::now();
+    result = bvh.refit();
+    std::cout << "[bvh] deformation: " << results[static_cast<int>(result)] << " in "
+              << millisecondsSince(deformStart) << " ms, SAH cost " << bvh.sahCost() << '\n';
+}
+
+void benchmarkScene(const Mesh& mesh)
+{
+    // a grid of randomly rotated and scaled instances of the mesh
+    Scene scene;
+    const uint32_t meshIndex = scene.addMesh(mesh);
+    const AABB bounds = mesh.getBounds();
+    const float spacing = 1.5f * bounds.extents().maxComponent();
+    std::mt19937 rng{7};
+    std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+    const int side = 40;
+    for (int i = 0; i < side * side * side / 2; ++i) {
+        const Point3D cell{static_cast<float>(i % side), static_cast<float>(i / side % side), static_cast<float>(i / side / side)};
+        scene.addInstance(meshIndex, Transform::translate(cell * spacing)
+                                         * Transform::rotate({0.0f, 1.0f, 0.0f}, 6.28f * uniform(rng))
+                                         * Transform::scale(Point3D{0.5f + 0.5f * uniform(rng)})
+                                         * Transform::translate(-bounds.center()));
+    }
+    const auto start = Clock::now();
+    scene.update();
+    const double updateTime = millisecondsSince(start);
+
+    // primary rays of a camera looking at the grid from outside
+    const AABB sceneBounds = scene.getBounds();
+    const Point3D eye = sceneBounds.center() - Point3D{0.0f, 0.0f, 1.5f * sceneBounds.extents().z};
+    const int width = 1000, height = 1000;
+    std::vector<Ray> rays;
+    rays.reserve(width * height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            rays.emplace_back(eye, Point3D{(x + 0.5f) / width - 0.5f, (y + 0.5f) / height - 0.5f, 1.0f});
+    std::vector<SceneHit> hits(rays.size());
+    const auto traceStart = Clock::now();
+    scene.intersect(rays, hits);
+    const double traceTime = millisecondsSince(traceStart);
+    const size_t found = std::count_if(hits.begin(), hits.end(), [](const SceneHit& hit) -> bool { return hit.found(); });
+
+    const Point3D center = sceneBounds.center();
+    const nanogui::Matrix4f view = nanogui::Matrix4f::look_at({eye.x, eye.y, eye.z}, {center.x, center.y, center.z},
+                                                              {0.0f, 1.0f, 0.0f});
+    const nanogui::Matrix4f projection = nanogui::Matrix4f::perspective(0.5f, 0.1f, 10.0f * spacing * side, 1.0f);
+    const auto cullStart = Clock::now();
+    const std::vector<uint32_t> visible = scene.cull(Frustum::fromMatrix(projection * view));
+    const double cullTime = millisecondsSince(cullStart);
+
+    std::cout << "[scene] " << scene.numInstances() << " instances, top level update: " << updateTime << " ms, "
+              << rays.size() << " rays: " << traceTime << " ms, " << static_cast<double>(rays.size()) / traceTime / 1000.0
+              << " M rays/s, " << found << " hits, frustum culling: " << visible.size() << " visible in " << cullTime
+              << " ms\n";
+}
+
+void benchmarkChunks(const Mesh& mesh)
+{
+    MeshChunks chunks;
+    const auto start = Clock::now();
+    const FaceList faces = chunks.build(mesh);
+    const double buildTime = millisecondsSince(start);
+
+    // a camera close above the terrain, tilted towards the horizon
+    const nanogui::Matrix4f mvp = nanogui::Matrix4f::perspective(0.8f, 0.01f, 0.5f, 1.5f)
+                                * nanogui::Matrix4f::rotate({1.0f, 0.0f, 0.0f}, -1.0f)
+                                * nanogui::Matrix4f::translate({-0.5f, -0.2f, -0.1f});
+    std::vector<MeshChunks::DrawRange> ranges;
+    const int frames = 100;
+    const auto cullStart = Clock::now();
+    for (int frame = 0; frame < frames; ++frame)
+        chunks.cull(mvp, {0.5f, 0.2f, 0.1f}, true, ranges);
+    const double cullTime = millisecondsSince(cullStart) / frames;
+    size_t drawn = 0;
+    for (const MeshChunks::DrawRange& range : ranges)
+        drawn += range.count;
+
+    std::cout << "[chunks] build: " << buildTime << " ms, " << chunks.numChunks() << " chunks, "
+              << chunks.numMeshlets() << " meshlets, culling: " << cullTime << " ms, " << chunks.numVisibleMeshlets()
+              << " visible, " << drawn << " of " << faces.size() << " faces in " << ranges.size() << " draws\n";
+}
+
+void benchmarkOcclusion(Mesh mesh)
+{
+    // a wall standing on the terrain in front of a camera looking along it
+    VertexList& vertices = mesh.getVertices();
+    const uint32_t wall = static_cast<uint32_t>(vertices.size());
+    vertices.insert(vertices.end(), {{0.1f, 0.3f, -0.1f}, {0.7f, 0.3f, -0.1f}, {0.7f, 0.3f, 0.2f}, {0.1f, 0.3f, 0.2f}});
+    mesh.getFaces().insert(mesh.getFaces().end(), {{wall, wall + 1, wall + 2}, {wall, wall + 2, wall + 3}});
+    mesh.updateBounds();
+
+    MeshChunks chunks;
+    chunks.build(mesh);
+    OcclusionCuller occlusion;
+    occlusion.setOccluders(mesh);
+    const Point3D camera{0.4f, 0.02f, 0.06f};
+    const nanogui::Matrix4f mvp = nanogui::Matrix4f::perspective(0.9f, 0.005f, 5.0f, 2.0f)
+                                * nanogui::Matrix4f::rotate({1.0f, 0.0f, 0.0f}, -1.45f)
+                                * nanogui::Matrix4f::translate({-camera.x, -camera.y, -camera.z});
+    std::vector<MeshChunks::DrawRange> ranges;
+    chunks.cull(mvp, camera, true, ranges);
+    const size_t withoutOcclusion = chunks.numVisibleFaces();
+
+    const int frames = 100;
+    double renderTime = 0.0;
+    const auto start = Clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        occlusion.render(mvp, 256, 128);
+        chunks.cull(mvp, camera, true, ranges, &occlusion);
+        renderTime += occlusion.renderMilliseconds();
+    }
+    const double frameTime = millisecondsSince(start) / frames;
+
+    std::cout << "[occlusion] " << occlusion.numOccluders() << " occluders, worker: " << renderTime / frames
+              << " ms, culling: " << frameTime << " ms per frame, " << chunks.numVisibleFaces() << " instead of "
+              << withoutOcclusion << " faces drawn, " << chunks.numOccluded() << " chunks and meshlets occluded\n";
+}
+
+void benchmarkAmbientOcclusion(Mesh mesh)
+{
+    const TriangleBVH bvh{mesh};
+    const AmbientOcclusionSettings settings;
+    const auto start = Clock::now();
+    const uint64_t rays = bakeAmbientOcclusion(mesh, bvh, settings);
+    const double bakeTime = millisecondsSince(start);
+
+    const AmbientOcclusionList& occlusion = mesh.getAmbientOcclusion();
+    const double mean = std::accumulate(occlusion.begin(), occlusion.end(), 0.0) / static_cast<double>(occlusion.size());
+    std::cout << "[ambient occlusion] " << mesh.getVertices().size() << " vertices, " << settings.rays
+              << " rays each: " << bakeTime << " ms, " << static_cast<double>(rays) / bakeTime / 1000.0
+              << " M rays/s, mean " << mean << "\n";
+}
+
+void benchmarkDistanceField(const Mesh& mesh)
+{
+    const TriangleBVH bvh{mesh};
+    for (const DistanceFieldSettings settings : {DistanceFieldSettings{64, 2, 0.0f}, DistanceFieldSettings{128, 2, 0.0f},
+                                                 DistanceFieldSettings{256, 2, 3.0f}}) {
+        SignedDistanceField field;
+        const auto start = Clock::now();
+        field.build(mesh, bvh, settings);
+        const double buildTime = millisecondsSince(start);
+
+        const auto& size = field.dimensions();
+        const double voxels = static_cast<double>(size[0]) * size[1] * size[2];
+        std::cout << "[sdf] " << size[0] << " x " << size[1] << " x " << size[2];
+        if (settings.narrowBand > 0.0f)
+            std::cout << ", band of " << settings.narrowBand << " voxels";
+        std::cout << ": " << buildTime << " ms, " << voxels / buildTime / 1000.0 << " M voxels/s, "
+                  << field.numStoredBlocks() << " of " << field.numBlocks() << " blocks stored, "
+                  << field.numWindingNumbers() << " winding numbers\n";
+    }
+}
+
+void benchmarkMarchingCubes(const Mesh& mesh)
+{
+    const SignedDistanceField field{mesh, DistanceFieldSettings{256, 2, 3.0f}};
+    const auto start = Clock::now();
+    const Mesh surface = marchingCubes(field);
+    const double extractTime = millisecondsSince(start);
+
+    const auto& size = field.dimensions();
+    const double cells = static_cast<double>(size[0] - 1) * (size[1] - 1) * (size[2] - 1);
+    std::cout << "[marching cubes] " << size[0] << " x " << size[1] << " x " << size[2] << " distance field: "
+              << extractTime << " ms, " << cells / extractTime / 1000.0 << " M cells/s, "
+              << surface.getVertices().size() << " vertices, " << surface.getFaces().size() << " faces\n";
+}
+
+/// how far the quantized positions of a compressed mesh move the surface
+void benchmarkMeshDistance(const Mesh& mesh, uint32_t positionBits)
+{
+    const auto path = std::filesystem::temp_directory_path() / "meshbench.gdvm";
+    mesh.saveCompressed(path.string(), positionBits);
+    Mesh loaded;
+    loaded.loadCompressed(path.string());
+    std::filesystem::remove(path);
+
+    auto start = Clock::now();
+    const TriangleBVH bvh{mesh}, loadedBvh{loaded};
+    const double buildTime = millisecondsSince(start);
+    start = Clock::now();
+    const MeshDistance distance = compareMeshes(mesh, bvh, loaded, loadedBvh);
+    const double compareTime = millisecondsSince(start);
+
+    const double queries = static_cast<double>(distance.forward.samples + distance.backward.samples
+                                               + distance.vertexErrorsA.size() + distance.vertexErrorsB.size());
+    const float extent = mesh.getBounds().extents().maxComponent();
+    std::cout << "[distance] " << positionBits << " bit positions of " << mesh.getFaces().size()
+              << " faces: Hausdorff " << distance.hausdorff() / extent << ", RMS " << distance.rms() / extent
+              << " of the extent, BVHs " << buildTime << " ms, compared in " << compareTime << " ms, "
+              << queries / compareTime / 1000.0 << " M queries/s\n";
+}
+
+void benchmarkIntersection(const Mesh& mesh)
+{
+    // a copy rotated about the center of the bounds crosses the mesh along a long curve
+    Mesh rotated = mesh;
+    const Point3D center = mesh.getBounds().center();
+    for (Vertex& v : rotated.getVertices()) {
+        const Point3D p = v - center;
+        v = center + Point3D{0.866f * p.x + 0.5f * p.z, p.y, -0.5f * p.x + 0.866f * p.z};
+    }
+    rotated.updateBounds();
+    const TriangleBVH bvh{mesh}, rotatedBvh{rotated};
+
+    auto start = Clock::now();
+    const MeshIntersection crossing = intersectMeshes(mesh, bvh, rotated, rotatedBvh, true);
+    const double crossingTime = millisecondsSince(start);
+    double length = 0.0;
+    for (const LineSegment& segment : crossing.segments)
+        length += distance(segment.start, segment.end);
+
+    start = Clock::now();
+    const MeshIntersection self = selfIntersections(mesh, bvh);
+    const double selfTime = millisecondsSince(start);
+
+    std::cout << "[intersection] rotated copy: " << crossingTime << " ms, " << crossing.pairs.size()
+              << " face pairs, curve length " << length / mesh.getBounds().extents().maxComponent()
+              << " of the extent, self-intersections: " << selfTime << " ms, " << self.pairs.size()
+              << " face pairs\n";
+}
+
+void benchmarkRepair(Mesh mesh)
+{
+    // every tenth face again, plus one collapsed copy of it
+    FaceList& faces = mesh.getFaces();
+    const size_t count = faces.size();
+    for (size_t i = 0; i < count; i += 10) {
+        faces.push_back(faces[i]);
+        faces.push_back({faces[i].v1, faces[i].v1, faces[i].v2});
+    }
+    mesh.updateFaceAreas();
+
+    const auto start = Clock::now();
+    const MeshRepairReport report = mesh.repair();
+    const double repairTime = millisecondsSince(start);
+
+    std::cout << "[repair] " << repairTime << " ms\n" << report;
+}
+
+/// randomly permute the vertices and faces, like an exporter without any spatial order
+void shuffleMesh(Mesh& mesh)
+{
+    std::mt19937 random{42};
+    std::vector<uint32_t> permutation(mesh.getVertices().size());
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::shuffle(permutation.begin(), permutation.end(), random);
+
+    auto permute = [&](auto& attribute) -> void {
+        if (attribute.size() != permutation.size())
+            return;
+        auto shuffled = attribute;
+        for (size_t i = 0; i < permutation.size(); ++i)
+            shuffled[permutation[i]] = attribute[i];
+        attribute = std::move(shuffled);
+    };
+    permute(mesh.getVertices());
+    permute(mesh.getNormals());
+    permute(mesh.getTextureCoordinates());
+    permute(mesh.getAmbientOcclusion());
+    for (TriangleIndices& t : mesh.getFaces())
+        t = {permutation[t.v1], permutation[t.v2], permutation[t.v3]};
+    // all faces of the synthetic terrain are in one smooth group, so they may be shuffled too
+    std::shuffle(mesh.getFaces().begin(), mesh.getFaces().end(), random);
+    mesh.updateFaceAreas();
+}
+
+/// time the kernels which walk over all vertices or faces
+void benchmarkKernels(Mesh& mesh, const std::string& label)
+{
+    auto time = [](auto&& f) -> double {
+        const auto start = Clock::now();
+        f();
+        return millisecondsSince(start);
+    };
+    const double bounds = time([&]() -> void { mesh.updateBounds(); });
+    const double areas = time([&]() -> void { mesh.updateFaceAreas(); });
+    const double normals = time([&]() -> void { mesh.updateNormals(); });
+    const double halfEdges = time([&]() -> void { HalfEdgeMesh{mesh}; });
+
+    std::cout << "[reorder] " << label << ": bounds " << bounds << " ms, face areas " << areas << " ms, normals "
+              << normals << " ms, half-edges " << halfEdges << " ms\n";
+}
+
+void benchmarkReorder(const Mesh& mesh)
+{
+    Mesh shuffled = mesh;
+    shuffleMesh(shuffled);
+    benchmarkKernels(shuffled, "shuffled");
+    for (SpaceFillingCurve curve : {SpaceFillingCurve::Morton, SpaceFillingCurve::Hilbert}) {
+        Mesh reordered = shuffled;
+        const auto start = Clock::now();
+        reordered.reorder(curve);
+        const double reorderTime = millisecondsSince(start);
+        const std::string name = curve == SpaceFillingCurve::Hilbert ? "Hilbert" : "Morton";
+        std::cout << "[reorder] " << name << " sort: " << reorderTime << " ms\n";
+        benchmarkKernels(reordered, name);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> files{argv + 1, argv + argc};
+    if (files.empty())
+        files.emplace_back("../meshes/bunny.obj");
+
+    try {
+        for (const auto& file : files) {
+            benchmarkLoad(file, OBJVertexMode::SplitAttributes);
+            const Mesh mesh = benchmarkLoad(file, OBJVertexMode::MergePositions);
+            benchmarkHalfEdge(mesh);
+            benchmarkWeld(mesh, 1e-5f * mesh.getBounds().extents().maxComponent());
+            benchmarkRepair(mesh);
+            benchmarkSaveOBJ(mesh);
+            benchmarkPLY(mesh);
+            benchmarkSTL(mesh);
+            benchmarkGLB(mesh);
+            benchmarkCompression(mesh, file);
+            benchmarkSubdivision(mesh, 2);
+            benchmarkSmoothing(mesh);
+            benchmarkSampling(mesh);
+            benchmarkBVH(mesh);
+            benchmarkScene(mesh);
+            benchmarkDistanceField(mesh);
+            benchmarkMarchingCubes(mesh);
+            benchmarkIntersection(mesh);
+        }
+        const Mesh terrain = syntheticTerrain(1000);
+        benchmarkCompression(terrain, "synthetic terrain with 2M faces");
+        benchmarkMeshDistance(terrain, 10);
+        benchmarkReorder(terrain);
+        benchmarkChunks(terrain);
+        benchmarkOcclusion(terrain);
+        benchmarkAmbientOcclusion(terrain);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Caught a fatal error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::cout << "[memory] still tracked after all meshes were freed: "
+              << formatBytes(totalMemoryCounter().current) << std::endl;
+    return 0;
+}
@@ -1,7 +1,19 @@
 #include "meshcanvas.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+#include "camera.h"
+
+namespace {
+
+/// width of the depth buffer for occlusion culling, its height follows the aspect ratio
+constexpr float occlusionWidth = 256.0f;
+
+} // namespace
 
 MeshCanvas::MeshCanvas(Widget* parent) : Canvas{parent}
 {
@@ -13,9 +25,13 @@ uniform mat4 model;
 
 in vec3 position;
 in vec3 normal;
+in float ao;
+in float value;
 out vec3 ws_pos;
 out vec3 ws_normal;
 flat out vec3 ws_normal_flat;
+out float occlusion;
+out float vertex_value;
 
 void main() {
     vec4 pos = mvp * vec4(position, 1.0);
@@ -24,6 +40,8 @@ void main() {
     gl_Position = pos;
     ws_normal = transpose(inverse(mat3(model))) * normal;
     ws_normal_flat = ws_normal;
+    occlusion = ao;
+    vertex_value = value;
 }
 )";
     static const std::string fragment_shader = R"(
@@ -33,10 +51,15 @@ uniform vec4 base_color;
 uniform vec3 camera_pos;
 uniform bool shade_flat;
 uniform bool shade_normal;
+uniform bool shade_ao;
+uniform bool color_map;
+uniform float value_scale;
 
 in vec3 ws_pos;
 in vec3 ws_normal;
 flat in vec3 ws_normal_flat;
+in float occlusion;
+in float vertex_value;
 out vec4 color;
 
 void main() {
@@ -44,8 +67,16 @@ void main() {
     vec3 normal = normalize(shade_flat ? ws_normal_flat : ws_normal);
     if (shade_normal)
         color = vec4(normal*0.5+vec3(0.5),1.0);
+    else if (color_map) {
+        // blue over green and yellow to red
+        float t = clamp(vertex_value*value_scale, 0.0, 1.0);
+        vec3 ramp = clamp(vec3(1.5)-abs(vec3(4.0*t-3.0, 4.0*t-2.0, 4.0*t-1.0)), 0.0, 1.0);
+        color = vec4(ramp*dot(cam_dir, normal), 1.0);
+    }
     else
         color = base_color*dot(cam_dir, normal);
+    if (shade_ao)
+        color.rgb *= occlusion;
 }
 )";
     m_shader = new Shader(render_pass(), "mesh_shader", vertex_shader, fragment_shader);
@@ -60,20 +91,62 @@ void main() {
                          m_coordMesh.getVertices().data());
     m_coordShader->set_buffer("normal", VariableType::Float32, {m_coordMesh.getNormals().size(), 3},
                          m_coordMesh.getNormals().data());
+    const std::vector<float> coordOcclusion(m_coordMesh.getVertices().size(), 1.0f);
+    m_coordShader->set_buffer("ao", VariableType::Float32, {coordOcclusion.size()}, coordOcclusion.data());
+    m_coordShader->set_uniform("shade_ao", false);
+    const std::vector<float> coordValues(m_coordMesh.getVertices().size(), 0.0f);
+    m_coordShader->set_buffer("value", VariableType::Float32, {coordValues.size()}, coordValues.data());
+    m_coordShader->set_uniform("color_map", false);
+    m_coordShader->set_uniform("value_scale", 1.0f);
+    coordGpuBytes = m_coordMesh.getFaces().size() * sizeof(TriangleIndices)
+                  + m_coordMesh.getVertices().size() * sizeof(Vertex)
+                  + m_coordMesh.getNormals().size() * sizeof(Vertex)
+                  + m_coordMesh.getVertices().size() * sizeof(float) * 2;
 }
 
 void MeshCanvas::uploadMesh(const Mesh& mesh)
 {
-    m_shader->set_buffer("indices", VariableType::UInt32, {mesh.getFaces().size() * 3},
-                         mesh.getFaces().data());
+    const FaceList faces = chunks.build(mesh);
+    occlusion.setOccluders(mesh);
+    m_shader->set_buffer("indices", VariableType::UInt32, {faces.size() * 3}, faces.data());
     m_shader->set_buffer("position", VariableType::Float32, {mesh.getVertices().size(), 3},
                          mesh.getVertices().data());
     m_shader->set_buffer("normal", VariableType::Float32, {mesh.getNormals().size(), 3},
                          mesh.getNormals().data());
+    // meshes without baked ambient occlusion are unoccluded everywhere
+    const AmbientOcclusionList& ambientOcclusion = mesh.getAmbientOcclusion();
+    const bool baked = ambientOcclusion.size() == mesh.getVertices().size();
+    const std::vector<float> unoccluded(baked ? 0 : mesh.getVertices().size(), 1.0f);
+    m_shader->set_buffer("ao", VariableType::Float32, {mesh.getVertices().size()},
+                         baked ? ambientOcclusion.data() : unoccluded.data());
+    // a new mesh starts without values to color map
+    const std::vector<float> values(mesh.getVertices().size(), 0.0f);
+    m_shader->set_buffer("value", VariableType::Float32, {values.size()}, values.data());
+    m_shader->set_uniform("color_map", false);
+    m_shader->set_uniform("value_scale", 1.0f);
+    numVertices = mesh.getVertices().size();
 
     numTriangles = mesh.getFaces().size();
+    gpuBytes = mesh.getFaces().size() * sizeof(TriangleIndices)
+             + mesh.getVertices().size() * sizeof(Vertex)
+             + mesh.getNormals().size() * sizeof(Vertex)
+             + mesh.getVertices().size() * sizeof(float) * 2;
     aabb = mesh.getBounds();
-    smoothGroups = mesh.getSmoothGroups();
+}
+
+void MeshCanvas::set_vertex_values(const std::vector<float>& values, float maxValue)
+{
+    if (values.size() != numVertices)
+        throw std::runtime_error("one value per vertex of the uploaded mesh is needed for the color map");
+    m_shader->set_buffer("value", VariableType::Float32, {values.size()}, values.data());
+    m_shader->set_uniform("color_map", true);
+    m_shader->set_uniform("value_scale", maxValue > 0.0f ? 1.0f / maxValue : 0.0f);
+}
+
+void MeshCanvas::clear_vertex_values()
+{
+    if (m_shader)
+        m_shader->set_uniform("color_map", false);
 }
 
 void MeshCanvas::draw_contents()
@@ -87,33 +160,24 @@ void MeshCanvas::draw_contents()
         time += lastTime-prev;
     }
 
-    Vector3f camera_pos{0, 0.5f, -4.0f};
-
-    Matrix4f rotate = Matrix4f::rotate({0.0f, 1.0f, 0.0f}, time);
-
-    const float scale = (auto_center) ? 2.0f / aabb.extents().maxComponent()
-                                      : 1.0f / max(abs(aabb.min), abs(aabb.max)).maxComponent();
-    const Vector3f translation = -(aabb.min + aabb.extents() * 0.5f);
-
-    Matrix4f model = rotate;
-
-    if (auto_scale)
-        model = model * Matrix4f::scale(Vector3f{scale});
-    if (auto_center)
-        model = model * Matrix4f::translate(translation);
-
-    Matrix4f view = Matrix4f::look_at(camera_pos, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
-
     const float width = static_cast<float>(m_size.x());
     const float height = static_cast<float>(m_size.y());
     const float aspect = width / height;
 
-    const float fov = 30.0f * std::numbers::pi_v<float> / 180.0f
-                    / std::max(0.2f, std::min(1.0f, aspect));
+    const ViewSetup setup = canvasView(aabb, time, auto_scale, auto_center, aspect);
+    const Vector3f& camera_pos = setup.cameraPosition;
+    const Matrix4f& model = setup.model;
+    // the axes only rotate
+    Matrix4f rotate = Matrix4f::rotate({0.0f, 1.0f, 0.0f}, time);
 
-    Matrix4f proj = Matrix4f::perspective(fov, 0.1f, 20.f, aspect);
+    Matrix4f mvp = setup.mvp();
+    lastMvp = mvp;
 
-    Matrix4f mvp = proj * view * model;
+    // the occluders are rasterized on the worker thread while the axes are drawn and the chunks are culled
+    const bool occlusion_pass = frustum_culling && occlusion_culling && !wireframe;
+    if (occlusion_pass)
+        occlusion.render(mvp, static_cast<uint32_t>(occlusionWidth),
+                         static_cast<uint32_t>(std::clamp(occlusionWidth / aspect, 1.0f, occlusionWidth)));
 
     if (show_axes) {
         m_coordShader->set_uniform("mvp", mvp);
@@ -136,30 +200,34 @@ void MeshCanvas::draw_contents()
 
     m_shader->set_uniform("shade_flat", true);
     m_shader->set_uniform("shade_normal", shadeNormal);
+    m_shader->set_uniform("shade_ao", ambient_occlusion);
     glProvokingVertex(GL_FIRST_VERTEX_CONVENTION);
 
     if (wireframe)
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    if (frustum_culling) {
+        // backfacing meshlets can only be skipped when the rasterizer culls back faces too
+        const Point3D camera = transformPoint(invert(model), camera_pos.x(), camera_pos.y(), camera_pos.z());
+        chunks.cull(mvp, camera, !wireframe, drawRanges, occlusion_pass ? &occlusion : nullptr);
+    }
+    else
+        chunks.all(drawRanges);
+
     m_shader->begin();
 
     // draw flat parts
-    {
-        size_t pos = 0;
-        for (auto [start, end] : smoothGroups) {
-            if (start > pos)
-                m_shader->draw_array(Shader::PrimitiveType::Triangle, pos*3, (start-pos)*3, true);
-            pos = end;
-        }
-        m_shader->draw_array(Shader::PrimitiveType::Triangle, pos*3, (numTriangles-pos)*3, true);
-    }
+    for (const auto& range : drawRanges)
+        if (!range.smooth)
+            m_shader->draw_array(Shader::PrimitiveType::Triangle, range.first*3, range.count*3, true);
     // draw smooth parts
-    if (smoothGroups.size()) {
+    if (std::any_of(drawRanges.begin(), drawRanges.end(), [](const auto& range) -> bool { return range.smooth; })) {
         m_shader->end();
         m_shader->set_uniform("shade_flat", false);
         m_shader->begin();
-        for (auto [start, end] : smoothGroups)
-            m_shader->draw_array(Shader::PrimitiveType::Triangle, start*3, (end-start)*3, true);
+        for (const auto& range : drawRanges)
+            if (range.smooth)
+                m_shader->draw_array(Shader::PrimitiveType::Triangle, range.first*3, range.count*3, true);
     }
 
     m_shader->end();
@@ -167,3 +235,18 @@ void MeshCanvas::draw_contents()
     if (wireframe)
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
+
+bool MeshCanvas::mouse_button_event(const Vector2i& p, int button, bool down, int modifiers)
+{
+    if (!pickCallback || !numTriangles || button != GLFW_MOUSE_BUTTON_1 || !down)
+        return Canvas::mouse_button_event(p, button, down, modifiers);
+
+    // unproject the pixel on the near and far plane into the coordinates of the mesh
+    const float x = 2.0f * (p.x() - m_pos.x()) / m_size.x() - 1.0f;
+    const float y = 1.0f - 2.0f * (p.y() - m_pos.y()) / m_size.y();
+    const Matrix4f inverse = invert(lastMvp);
+    const Point3D nearPoint = transformPoint(inverse, x, y, -1.0f);
+    const Point3D farPoint = transformPoint(inverse, x, y, 1.0f);
+    pickCallback(Ray{nearPoint, farPoint - nearPoint, 0.0f, 1.0f});
+    return true;
+}
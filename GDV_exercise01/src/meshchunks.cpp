@@ -0,0 +1,338 @@
+#include "meshchunks.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+#include "parallel.h"
+#include "random.h"
+
+namespace {
+
+/// grid resolution per axis for the Morton codes of the face centroids
+constexpr unsigned mortonBits = 10;
+/// cone cutoff which never rejects a meshlet
+constexpr float noCone = 2.0f;
+
+struct CodedFace {
+    uint64_t code;
+    uint32_t face;
+};
+
+} // namespace
+
+uint64_t MeshChunks::topologyHash(const Mesh& mesh)
+{
+    const FaceList& faces = mesh.getFaces();
+    const size_t chunks = chunkCount(faces.size());
+    std::vector<uint64_t> partial(chunks, 0);
+    parallelForChunks(faces.size(), chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        uint64_t hash = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const TriangleIndices& t = faces[i];
+            hash += mix((uint64_t{t.v1} << 32 | t.v2) ^ mix(uint64_t{t.v3} << 32 | i));
+        }
+        partial[chunk] = hash;
+    });
+    uint64_t hash = mix(faces.size()) ^ mix(mesh.getVertices().size() + 1);
+    for (uint64_t chunkHash : partial)
+        hash += chunkHash;
+    for (const auto& [start, end] : mesh.getSmoothGroups())
+        hash = mix(hash ^ start) + end;
+    return hash;
+}
+
+void MeshChunks::cluster(const Mesh& mesh, size_t facesPerChunk)
+{
+    const FaceList& faces = mesh.getFaces();
+    const VertexList& vertices = mesh.getVertices();
+
+    // smooth groups and the runs of flat faces between them, faces only move inside their segment
+    std::vector<DrawRange> segments;
+    size_t pos = 0;
+    for (auto [start, end] : mesh.getSmoothGroups()) {
+        start = std::clamp(start, pos, faces.size());
+        end = std::clamp(end, start, faces.size());
+        if (start > pos)
+            segments.push_back({pos, start - pos, false});
+        if (end > start)
+            segments.push_back({start, end - start, true});
+        pos = end;
+    }
+    if (pos < faces.size())
+        segments.push_back({pos, faces.size() - pos, false});
+    const unsigned segmentBits = std::bit_width(segments.size());
+    if (segmentBits + 3 * mortonBits > 64)
+        throw std::runtime_error("the mesh has too many smooth groups for chunking");
+
+    const SpaceFillingCurveGrid grid{mesh.getBounds(), SpaceFillingCurve::Morton, mortonBits};
+    CountedVector<CodedFace, MemoryCategory::Temporary> order(faces.size()), scratch(faces.size());
+    for (size_t segment = 0; segment < segments.size(); ++segment) {
+        const DrawRange& s = segments[segment];
+        parallelFor(s.count, [&](size_t begin, size_t end) -> void {
+            for (size_t i = s.first + begin; i < s.first + end; ++i) {
+                const TriangleIndices& t = faces[i];
+                const Vertex centroid = (vertices[t.v1] + vertices[t.v2] + vertices[t.v3]) / 3.0f;
+                order[i] = {uint64_t{segment} << (3 * mortonBits) | grid.code(centroid), static_cast<uint32_t>(i)};
+            }
+        });
+    }
+    parallelRadixSort(order.data(), scratch.data(), faces.size(), [](const CodedFace& c) -> uint64_t { return c.code; },
+                      3 * mortonBits + segmentBits);
+    faceOrder.resize(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            faceOrder[i] = order[i].face;
+    });
+
+    // the segments keep their positions, so the chunks are cut from each of them
+    chunks.clear();
+    for (const DrawRange& s : segments)
+        for (size_t first = s.first; first < s.first + s.count; first += facesPerChunk)
+            chunks.push_back({{first, std::min(facesPerChunk, s.first + s.count - first), s.smooth}, 0, 0});
+
+    // each chunk is cut greedily into meshlets along the curve, a meshlet ends when the next
+    // face would exceed the vertex or triangle limit
+    std::vector<std::vector<uint32_t>> chunkMeshlets(chunks.size());
+    parallelFor(chunks.size(), [&](size_t begin, size_t end) -> void {
+        std::array<uint32_t, maxMeshletVertices> used;
+        for (size_t c = begin; c < end; ++c) {
+            uint32_t usedCount = 0, triangles = 0;
+            auto isUsed = [&](uint32_t v) -> bool { return std::find(used.begin(), used.begin() + usedCount, v) != used.begin() + usedCount; };
+            const DrawRange& range = chunks[c].faces;
+            for (size_t i = range.first; i < range.first + range.count; ++i) {
+                const TriangleIndices& t = faces[faceOrder[i]];
+                const uint32_t added = !isUsed(t.v1) + (!isUsed(t.v2) && t.v2 != t.v1)
+                                     + (!isUsed(t.v3) && t.v3 != t.v1 && t.v3 != t.v2);
+                if (triangles == maxMeshletTriangles || usedCount + added > maxMeshletVertices)
+                    triangles = usedCount = 0;
+                if (!triangles)
+                    chunkMeshlets[c].push_back(static_cast<uint32_t>(i));
+                for (uint32_t v : {t.v1, t.v2, t.v3})
+                    if (!isUsed(v))
+                        used[usedCount++] = v;
+                ++triangles;
+            }
+        }
+    }, 16);
+
+    size_t meshletCount = 0;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        chunks[c].firstMeshlet = static_cast<uint32_t>(meshletCount);
+        meshletCount += chunkMeshlets[c].size();
+        chunks[c].endMeshlet = static_cast<uint32_t>(meshletCount);
+    }
+    meshletFaces.resize(meshletCount);
+    parallelFor(chunks.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t c = begin; c < end; ++c)
+            std::copy(chunkMeshlets[c].begin(), chunkMeshlets[c].end(), meshletFaces.begin() + chunks[c].firstMeshlet);
+    }, 64);
+}
+
+MeshChunks::DrawRange MeshChunks::meshletRange(size_t chunk, uint32_t meshlet) const
+{
+    const Chunk& c = chunks[chunk];
+    const size_t end = meshlet + 1 < c.endMeshlet ? meshletFaces[meshlet + 1] : c.faces.first + c.faces.count;
+    return {meshletFaces[meshlet], end - meshletFaces[meshlet], c.faces.smooth};
+}
+
+FaceList MeshChunks::build(const Mesh& mesh, size_t facesPerChunk)
+{
+    const FaceList& faces = mesh.getFaces();
+    const VertexList& vertices = mesh.getVertices();
+    if (faces.size() >= UINT32_MAX)
+        throw std::runtime_error("the mesh has too many faces for chunking");
+    facesPerChunk = std::max<size_t>(facesPerChunk, 1);
+
+    const uint64_t hash = topologyHash(mesh);
+    if (hash != clusteredHash || facesPerChunk != clusteredChunkSize || faceOrder.size() != faces.size()) {
+        cluster(mesh, facesPerChunk);
+        clusteredHash = hash;
+        clusteredChunkSize = facesPerChunk;
+    }
+
+    FaceList sorted(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            sorted[i] = faces[faceOrder[i]];
+    });
+
+    for (auto* list : {&centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ})
+        list->resize(chunks.size());
+    for (auto* list : {&sphereX, &sphereY, &sphereZ, &sphereRadius, &coneX, &coneY, &coneZ, &coneCutoff})
+        list->resize(meshletFaces.size());
+    visible.resize(std::max(chunks.size(), meshletFaces.size()));
+    visibleMeshlets = meshletFaces.size();
+    visibleFaces = faces.size();
+
+    parallelFor(chunks.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t c = begin; c < end; ++c) {
+            AABB chunkBounds;
+            for (uint32_t m = chunks[c].firstMeshlet; m < chunks[c].endMeshlet; ++m) {
+                const DrawRange range = meshletRange(c, m);
+                AABB bounds;
+                Point3D normalSum{0.0f};
+                for (size_t i = range.first; i < range.first + range.count; ++i) {
+                    const Vertex& p1 = vertices[sorted[i].v1];
+                    const Vertex& p2 = vertices[sorted[i].v2];
+                    const Vertex& p3 = vertices[sorted[i].v3];
+                    bounds.extend(p1);
+                    bounds.extend(p2);
+                    bounds.extend(p3);
+                    const Point3D n = cross(p2 - p1, p3 - p1);
+                    const float length = n.norm();
+                    if (length > 0.0f)
+                        normalSum += n / length;
+                }
+                chunkBounds.extend(bounds);
+
+                // the sphere around the center of the box, the cone around the mean normal
+                const Point3D center = bounds.center();
+                float radius = 0.0f;
+                const float axisLength = normalSum.norm();
+                const Point3D axis = axisLength > 0.0f ? normalSum / axisLength : Point3D{0.0f};
+                float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+                for (size_t i = range.first; i < range.first + range.count; ++i) {
+                    const Vertex& p1 = vertices[sorted[i].v1];
+                    const Vertex& p2 = vertices[sorted[i].v2];
+                    const Vertex& p3 = vertices[sorted[i].v3];
+                    radius = std::max({radius, distance(center, p1), distance(center, p2), distance(center, p3)});
+                    const Point3D n = cross(p2 - p1, p3 - p1);
+                    const float length = n.norm();
+                    if (length > 0.0f)
+                        minDot = std::min(minDot, dot(n, axis) / length);
+                }
+                sphereX[m] = center.x;
+                sphereY[m] = center.y;
+                sphereZ[m] = center.z;
+                sphereRadius[m] = radius;
+                coneX[m] = axis.x;
+                coneY[m] = axis.y;
+                coneZ[m] = axis.z;
+                coneCutoff[m] = minDot > 0.0f ? std::sqrt(1.0f - minDot * minDot) : noCone;
+            }
+
+            const Point3D center = chunkBounds.center();
+            const Point3D half = chunkBounds.extents() * 0.5f;
+            centerX[c] = center.x;
+            centerY[c] = center.y;
+            centerZ[c] = center.z;
+            halfX[c] = half.x;
+            halfY[c] = half.y;
+            halfZ[c] = half.z;
+        }
+    }, 16);
+    return sorted;
+}
+
+void MeshChunks::appendRange(const DrawRange& range, std::vector<DrawRange>& ranges)
+{
+    if (!ranges.empty() && ranges.back().smooth == range.smooth && ranges.back().first + ranges.back().count == range.first)
+        ranges.back().count += range.count;
+    else
+        ranges.push_back(range);
+}
+
+void MeshChunks::cull(const nanogui::Matrix4f& mvp, const Point3D& camera, bool backfaceCulling,
+                      std::vector<DrawRange>& ranges, OcclusionCuller* occlusion)
+{
+    // the planes of the model-view-projection matrix are in the coordinates of the mesh
+    const Frustum frustum = Frustum::fromMatrix(mvp);
+    float nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+    for (int p = 0; p < 6; ++p) {
+        const Plane& plane = frustum.planes[p];
+        nx[p] = plane.normal.x;
+        ny[p] = plane.normal.y;
+        nz[p] = plane.normal.z;
+        ax[p] = std::abs(plane.normal.x);
+        ay[p] = std::abs(plane.normal.y);
+        az[p] = std::abs(plane.normal.z);
+        d[p] = plane.distance;
+    }
+
+    // a chunk is outside if its box is completely behind one of the planes; no branches, so this vectorizes
+    const size_t count = chunks.size();
+    const float* cx = centerX.data();
+    const float* cy = centerY.data();
+    const float* cz = centerZ.data();
+    const float* hx = halfX.data();
+    const float* hy = halfY.data();
+    const float* hz = halfZ.data();
+    uint32_t* result = visible.data();
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t inside = 1;
+        for (int p = 0; p < 6; ++p) {
+            const float distance = nx[p] * cx[i] + ny[p] * cy[i] + nz[p] * cz[i] + d[p];
+            const float radius = ax[p] * hx[i] + ay[p] * hy[i] + az[p] * hz[i];
+            inside &= static_cast<uint32_t>(distance + radius >= 0.0f);
+        }
+        result[i] = inside;
+    }
+
+    // the meshlets of the visible chunks: the sphere against the frustum, and the cone is backfacing
+    // if the angle between the axis and the view direction to the sphere leaves no room for a front face
+    std::vector<uint32_t> visibleChunks;
+    for (size_t c = 0; c < count; ++c)
+        if (result[c])
+            visibleChunks.push_back(static_cast<uint32_t>(c));
+
+    // the depth pyramid is only needed from here on, so it was rendered while the chunks were tested
+    occluded = 0;
+    if (occlusion) {
+        occlusion->wait();
+        std::erase_if(visibleChunks, [&](uint32_t c) -> bool {
+            const Point3D center{cx[c], cy[c], cz[c]}, half{hx[c], hy[c], hz[c]};
+            const bool hidden = !occlusion->visible({center - half, center + half});
+            occluded += hidden;
+            return hidden;
+        });
+    }
+    const uint32_t backfaceMask = backfaceCulling ? 1 : 0;
+    const float* sx = sphereX.data();
+    const float* sy = sphereY.data();
+    const float* sz = sphereZ.data();
+    const float* sr = sphereRadius.data();
+    const float* kx = coneX.data();
+    const float* ky = coneY.data();
+    const float* kz = coneZ.data();
+    const float* kc = coneCutoff.data();
+
+    ranges.clear();
+    visibleMeshlets = visibleFaces = 0;
+    for (uint32_t c : visibleChunks) {
+        const uint32_t first = chunks[c].firstMeshlet, end = chunks[c].endMeshlet;
+        for (uint32_t m = first; m < end; ++m) {
+            uint32_t inside = 1;
+            for (int p = 0; p < 6; ++p)
+                inside &= static_cast<uint32_t>(nx[p] * sx[m] + ny[p] * sy[m] + nz[p] * sz[m] + d[p] + sr[m] >= 0.0f);
+            const float vx = sx[m] - camera.x, vy = sy[m] - camera.y, vz = sz[m] - camera.z;
+            const float length = std::sqrt(vx * vx + vy * vy + vz * vz);
+            const uint32_t backfacing = static_cast<uint32_t>(vx * kx[m] + vy * ky[m] + vz * kz[m] >= kc[m] * length + sr[m]);
+            result[m] = inside & ~(backfacing & backfaceMask);
+        }
+        for (uint32_t m = first; m < end; ++m) {
+            if (!result[m])
+                continue;
+            if (occlusion) {
+                const Point3D center{sx[m], sy[m], sz[m]}, radius{sr[m]};
+                if (!occlusion->visible({center - radius, center + radius})) {
+                    ++occluded;
+                    continue;
+                }
+            }
+            const DrawRange range = meshletRange(c, m);
+            ++visibleMeshlets;
+            visibleFaces += range.count;
+            appendRange(range, ranges);
+        }
+    }
+}
+
+void MeshChunks::all(std::vector<DrawRange>& ranges) const
+{
+    ranges.clear();
+    for (const Chunk& chunk : chunks)
+        appendRange(chunk.faces, ranges);
+}
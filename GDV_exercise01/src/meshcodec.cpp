@@ -0,0 +1,681 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+/*
+    GDVM layout, all values little endian:
+
+    header      "GDVM", version, flags, position bits, vertex count, face count,
+                position bounds, texture coordinate bounds, smooth groups
+    block table first face, face count, first vertex, vertex count, offset, size per block
+    blocks      one compressed stream each for indices, positions, normals, texture coordinates
+
+    vertices are renumbered in the order the faces first reference them, so every block of
+    faces introduces one contiguous range of new vertices and can be decoded on its own
+*/
+
+namespace {
+
+constexpr char magic[4] = {'G', 'D', 'V', 'M'};
+constexpr uint32_t version = 1;
+constexpr uint32_t hasNormalsFlag = 1;
+constexpr uint32_t hasTexCoordsFlag = 2;
+
+/// faces per independently decodable block
+constexpr size_t facesPerBlock = size_t{1} << 16;
+/// bits per octahedral normal component
+constexpr uint32_t normalBits = 12;
+/// bits per texture coordinate component
+constexpr uint32_t texCoordBits = 16;
+
+/// index code for a vertex which is referenced for the first time
+constexpr uint64_t newVertexCode = 0;
+
+constexpr size_t blockEntrySize = 8 * 6;
+/// upper bound of a decoded stream: 3 corners with up to 3 components of up to 10 varint bytes
+constexpr size_t maxStreamSize = facesPerBlock * 3 * 3 * 10;
+
+inline uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+
+inline int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+/// growing little endian byte buffer
+class ByteWriter {
+public:
+    template <typename T>
+    void put(T value)
+    {
+        bytes.resize(bytes.size() + sizeof(T));
+        writeLittleEndian(bytes.data() + bytes.size() - sizeof(T), value);
+    }
+
+    /// LEB128 variable length unsigned integer
+    void putVarint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putBytes(const std::vector<uint8_t>& data) { bytes.insert(bytes.end(), data.begin(), data.end()); }
+
+    std::vector<uint8_t> bytes;
+};
+
+/// bounds checked reader, throws std::runtime_error on truncated data
+class ByteReader {
+public:
+    ByteReader(const uint8_t* begin, const uint8_t* end) : p{begin}, end{end} {}
+
+    template <typename T>
+    T get()
+    {
+        need(sizeof(T));
+        const T value = readLittleEndian<T>(p);
+        p += sizeof(T);
+        return value;
+    }
+
+    uint64_t getVarint()
+    {
+        // single byte values are by far the most common ones
+        if (p < end && !(*p & 0x80))
+            return *p++;
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            const uint8_t byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("invalid variable length integer");
+    }
+
+    const uint8_t* getBytes(size_t count)
+    {
+        need(count);
+        const uint8_t* bytes = p;
+        p += count;
+        return bytes;
+    }
+
+private:
+    void need(size_t count) const
+    {
+        if (static_cast<size_t>(end - p) < count)
+            throw std::runtime_error("unexpected end of data");
+    }
+
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+/*
+    order-0 range asymmetric numeral system coder for byte streams,
+    symbols are encoded in reverse so the decoder can read forward
+*/
+constexpr uint32_t ransScaleBits = 12;
+constexpr uint32_t ransScale = 1u << ransScaleBits;
+constexpr uint32_t ransLow = 1u << 23;
+
+enum class StreamMethod : uint8_t { Raw = 0, Rans = 1 };
+
+/// scale the symbol counts to frequencies summing up to ransScale, used symbols keep at least 1
+std::array<uint32_t, 256> normalizeFrequencies(const std::array<uint64_t, 256>& counts, uint64_t total)
+{
+    std::array<uint32_t, 256> frequencies{};
+    int64_t sum = 0;
+    for (size_t s = 0; s < 256; ++s) {
+        if (counts[s])
+            frequencies[s] = std::max<uint32_t>(1, static_cast<uint32_t>(counts[s] * ransScale / total));
+        sum += frequencies[s];
+    }
+    while (sum != ransScale) {
+        const auto largest = std::max_element(frequencies.begin(), frequencies.end());
+        if (sum < ransScale) {
+            *largest += static_cast<uint32_t>(ransScale - sum);
+            sum = ransScale;
+        }
+        else {
+            const int64_t take = std::min<int64_t>(sum - ransScale, *largest - 1);
+            *largest -= static_cast<uint32_t>(take);
+            sum -= take;
+            if (!take) // all used symbols are at 1, cannot happen with at most 256 symbols
+                break;
+        }
+    }
+    return frequencies;
+}
+
+/// entropy code a byte stream, falls back to storing it if that is not smaller
+void writeStream(ByteWriter& out, const std::vector<uint8_t>& raw)
+{
+    std::array<uint64_t, 256> counts{};
+    for (uint8_t byte : raw)
+        ++counts[byte];
+
+    std::vector<uint8_t> encoded;
+    ByteWriter table;
+    if (!raw.empty()) {
+        const auto frequencies = normalizeFrequencies(counts, raw.size());
+        std::array<uint32_t, 256> starts{};
+        for (size_t s = 1; s < 256; ++s)
+            starts[s] = starts[s - 1] + frequencies[s - 1];
+
+        table.putVarint(static_cast<uint64_t>(std::count_if(frequencies.begin(), frequencies.end(),
+                                                            [](uint32_t f) { return f != 0; })));
+        for (size_t s = 0; s < 256; ++s) {
+            if (frequencies[s]) {
+                table.put(static_cast<uint8_t>(s));
+                table.putVarint(frequencies[s]);
+            }
+        }
+
+        // two interleaved states for even and odd symbols, so the decoder has two independent chains
+        encoded.reserve(raw.size() + 16);
+        uint32_t states[2] = {ransLow, ransLow};
+        for (size_t i = raw.size(); i-- > 0;) {
+            uint32_t& x = states[i & 1];
+            const uint32_t frequency = frequencies[raw[i]];
+            const uint32_t limit = ((ransLow >> ransScaleBits) << 8) * frequency;
+            while (x >= limit) {
+                encoded.push_back(static_cast<uint8_t>(x));
+                x >>= 8;
+            }
+            x = ((x / frequency) << ransScaleBits) + (x % frequency) + starts[raw[i]];
+        }
+        for (uint32_t x : {states[1], states[0]}) {
+            for (int k = 0; k < 4; ++k) {
+                encoded.push_back(static_cast<uint8_t>(x));
+                x >>= 8;
+            }
+        }
+        std::reverse(encoded.begin(), encoded.end());
+    }
+
+    const bool useRans = !raw.empty() && table.bytes.size() + encoded.size() < raw.size();
+    out.put(static_cast<uint8_t>(useRans ? StreamMethod::Rans : StreamMethod::Raw));
+    out.putVarint(raw.size());
+    if (!useRans) {
+        out.putBytes(raw);
+        return;
+    }
+    out.putBytes(table.bytes);
+    out.putVarint(encoded.size());
+    out.putBytes(encoded);
+}
+
+std::vector<uint8_t> readStream(ByteReader& in)
+{
+    const auto method = static_cast<StreamMethod>(in.get<uint8_t>());
+    const uint64_t size = in.getVarint();
+    if (size > maxStreamSize)
+        throw std::runtime_error("invalid stream size");
+    if (method == StreamMethod::Raw) {
+        const uint8_t* bytes = in.getBytes(size);
+        return {bytes, bytes + size};
+    }
+    if (method != StreamMethod::Rans)
+        throw std::runtime_error("unknown stream method");
+
+    std::array<uint32_t, 256> frequencies{}, starts{};
+    std::array<uint8_t, ransScale> symbols;
+    const uint64_t used = in.getVarint();
+    uint32_t start = 0;
+    for (uint64_t i = 0; i < used; ++i) {
+        const uint8_t symbol = in.get<uint8_t>();
+        const uint64_t frequency = in.getVarint();
+        if (!frequency || frequency > ransScale - start)
+            throw std::runtime_error("invalid symbol frequencies");
+        frequencies[symbol] = static_cast<uint32_t>(frequency);
+        starts[symbol] = start;
+        std::fill_n(symbols.begin() + start, frequency, symbol);
+        start += static_cast<uint32_t>(frequency);
+    }
+    if (start != ransScale)
+        throw std::runtime_error("invalid symbol frequencies");
+
+    const uint64_t encodedSize = in.getVarint();
+    const uint8_t* p = in.getBytes(encodedSize);
+    const uint8_t* end = p + encodedSize;
+    if (encodedSize < 8)
+        throw std::runtime_error("invalid entropy coded stream");
+    uint32_t states[2] = {0, 0};
+    for (uint32_t& x : states)
+        for (int k = 0; k < 4; ++k)
+            x = (x << 8) | *p++;
+
+    std::vector<uint8_t> raw(size);
+    auto decode = [&](uint32_t& x) -> uint8_t {
+        const uint32_t slot = x & (ransScale - 1);
+        const uint8_t symbol = symbols[slot];
+        x = frequencies[symbol] * (x >> ransScaleBits) + slot - starts[symbol];
+        return symbol;
+    };
+    auto renormalize = [&](uint32_t& x) -> void {
+        while (x < ransLow) {
+            if (p == end)
+                throw std::runtime_error("invalid entropy coded stream");
+            x = (x << 8) | *p++;
+        }
+    };
+    size_t i = 0;
+    for (; i + 1 < raw.size(); i += 2) {
+        raw[i] = decode(states[0]);
+        raw[i + 1] = decode(states[1]);
+        renormalize(states[0]);
+        renormalize(states[1]);
+    }
+    if (i < raw.size())
+        raw[i] = decode(states[0]);
+    return raw;
+}
+
+/// octahedral mapping of a unit vector to [0, 2^normalBits - 1]^2
+std::array<uint32_t, 2> encodeNormal(const Vertex& n)
+{
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float u = l1 > 0.0f ? n.x / l1 : 0.0f;
+    float v = l1 > 0.0f ? n.y / l1 : 0.0f;
+    if (n.z < 0.0f) {
+        const float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        v = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+    }
+    constexpr float maxValue = (1u << normalBits) - 1;
+    return {static_cast<uint32_t>(std::lround((u * 0.5f + 0.5f) * maxValue)),
+            static_cast<uint32_t>(std::lround((v * 0.5f + 0.5f) * maxValue))};
+}
+
+Vertex decodeNormal(uint32_t qu, uint32_t qv)
+{
+    constexpr float maxValue = (1u << normalBits) - 1;
+    const float u = static_cast<float>(qu) / maxValue * 2.0f - 1.0f;
+    const float v = static_cast<float>(qv) / maxValue * 2.0f - 1.0f;
+    Vertex n{u, v, 1.0f - std::abs(u) - std::abs(v)};
+    if (n.z < 0.0f) {
+        n.x = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+    }
+    return normalize(n);
+}
+
+/// per component quantization of values inside a box to [0, 2^bits - 1]
+template <size_t N>
+struct Quantizer {
+    std::array<float, N> min{}, scale{}, inverseScale{};
+
+    Quantizer(const std::array<float, N>& low, const std::array<float, N>& high, uint32_t bits)
+    {
+        const float maxValue = static_cast<float>((uint64_t{1} << bits) - 1);
+        for (size_t c = 0; c < N; ++c) {
+            min[c] = low[c];
+            const float extent = high[c] - low[c];
+            scale[c] = extent > 0.0f ? maxValue / extent : 0.0f;
+            inverseScale[c] = extent > 0.0f ? extent / maxValue : 0.0f;
+        }
+    }
+
+    std::array<uint32_t, N> quantize(const float* values) const
+    {
+        std::array<uint32_t, N> q;
+        for (size_t c = 0; c < N; ++c)
+            q[c] = static_cast<uint32_t>(std::lround((values[c] - min[c]) * scale[c]));
+        return q;
+    }
+
+    void dequantize(const std::array<uint32_t, N>& q, float* values) const
+    {
+        for (size_t c = 0; c < N; ++c)
+            values[c] = min[c] + static_cast<float>(q[c]) * inverseScale[c];
+    }
+};
+
+/// the quantized attributes of one vertex, which are what the predictors work on
+struct QuantizedVertex {
+    std::array<uint32_t, 3> position;
+    std::array<uint32_t, 2> normal;
+    std::array<uint32_t, 2> texCoord;
+};
+
+struct BlockInfo {
+    uint64_t firstFace, faceCount, firstVertex, vertexCount, offset, size;
+};
+
+/**
+ * @brief predicts the position of a new vertex from the vertices already decoded in the block
+ * if the new vertex completes a triangle sharing an edge with the previous triangle, the
+ * parallelogram rule is used, otherwise the previous new vertex
+ */
+template <typename GetVertex>
+std::array<int64_t, 3> predictPosition(const TriangleIndices* previous, uint32_t a, uint32_t b, size_t corner,
+                                       size_t firstVertex, uint32_t lastNew, GetVertex&& vertex)
+{
+    std::array<int64_t, 3> prediction{};
+    if (corner == 2 && previous && a >= firstVertex && b >= firstVertex) {
+        const uint32_t p[3] = {previous->v1, previous->v2, previous->v3};
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t opposite = p[k], e0 = p[(k + 1) % 3], e1 = p[(k + 2) % 3];
+            if (((e0 == a && e1 == b) || (e0 == b && e1 == a)) && opposite >= firstVertex) {
+                const auto &qa = vertex(a).position, &qb = vertex(b).position, &qc = vertex(opposite).position;
+                for (int c = 0; c < 3; ++c)
+                    prediction[c] = static_cast<int64_t>(qa[c]) + qb[c] - qc[c];
+                return prediction;
+            }
+        }
+    }
+    if (lastNew != UINT32_MAX)
+        for (int c = 0; c < 3; ++c)
+            prediction[c] = vertex(lastNew).position[c];
+    return prediction;
+}
+
+} // namespace
+
+void Mesh::saveCompressed(const std::string& filename, uint32_t positionBits) const
+{
+    if (positionBits < 1 || positionBits > 30)
+        throw std::runtime_error("the position quantization has to use 1 to 30 bits");
+
+    std::ofstream file{filename, std::ios::binary};
+    if (!file)
+        throw std::runtime_error(std::string{"failed to open the file "} + filename + " for writing");
+    file.exceptions(std::ios::badbit | std::ios::failbit);
+
+    const bool hasNormals = !vertices.empty() && normals.size() == vertices.size();
+    const bool hasTexCoords = !vertices.empty() && texCoords.size() == vertices.size();
+
+    // number the vertices in the order of their first reference, unreferenced vertices are dropped
+    constexpr uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> newIndex(vertices.size(), unused);
+    std::vector<uint32_t> order;
+    order.reserve(vertices.size());
+    std::vector<BlockInfo> blocks((faces.size() + facesPerBlock - 1) / facesPerBlock);
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        blocks[block].firstFace = block * facesPerBlock;
+        blocks[block].faceCount = std::min(facesPerBlock, faces.size() - block * facesPerBlock);
+        blocks[block].firstVertex = order.size();
+        for (size_t i = blocks[block].firstFace; i < blocks[block].firstFace + blocks[block].faceCount; ++i) {
+            for (uint32_t v : {faces[i].v1, faces[i].v2, faces[i].v3}) {
+                if (v >= vertices.size())
+                    throw std::runtime_error("face with a vertex index out of range");
+                if (newIndex[v] == unused) {
+                    newIndex[v] = static_cast<uint32_t>(order.size());
+                    order.push_back(v);
+                }
+            }
+        }
+        blocks[block].vertexCount = order.size() - blocks[block].firstVertex;
+    }
+
+    // quantize relative to the bounds of the referenced vertices
+    AABB bounds;
+    for (uint32_t v : order)
+        bounds.extend(vertices[v]);
+    std::array<float, 2> texMin{0.0f, 0.0f}, texMax{0.0f, 0.0f};
+    if (hasTexCoords && !order.empty()) {
+        texMin = texMax = {texCoords[order[0]].x, texCoords[order[0]].y};
+        for (uint32_t v : order) {
+            texMin = {std::min(texMin[0], texCoords[v].x), std::min(texMin[1], texCoords[v].y)};
+            texMax = {std::max(texMax[0], texCoords[v].x), std::max(texMax[1], texCoords[v].y)};
+        }
+    }
+    const Quantizer<3> positionQuantizer{{bounds.min.x, bounds.min.y, bounds.min.z},
+                                         {bounds.max.x, bounds.max.y, bounds.max.z}, positionBits};
+    const Quantizer<2> texCoordQuantizer{texMin, texMax, texCoordBits};
+
+    std::vector<QuantizedVertex> quantized(order.size());
+    parallelFor(order.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t v = order[i];
+            quantized[i].position = positionQuantizer.quantize(&vertices[v].x);
+            quantized[i].normal = hasNormals ? encodeNormal(normals[v]) : std::array<uint32_t, 2>{};
+            quantized[i].texCoord = hasTexCoords ? texCoordQuantizer.quantize(&texCoords[v].x)
+                                                 : std::array<uint32_t, 2>{};
+        }
+    });
+
+    // encode the blocks in parallel
+    std::vector<std::vector<uint8_t>> payloads(blocks.size());
+    parallelFor(blocks.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t block = begin; block < end; ++block) {
+            const BlockInfo& info = blocks[block];
+            ByteWriter indexStream, positionStream, normalStream, texCoordStream;
+            uint32_t nextNew = static_cast<uint32_t>(info.firstVertex);
+            uint32_t lastNew = UINT32_MAX;
+            TriangleIndices previous{}, current{};
+            auto vertex = [&](uint32_t v) -> const QuantizedVertex& { return quantized[v]; };
+
+            for (size_t i = info.firstFace; i < info.firstFace + info.faceCount; ++i) {
+                uint32_t* corners = &current.v1;
+                const uint32_t originals[3] = {faces[i].v1, faces[i].v2, faces[i].v3};
+                for (size_t corner = 0; corner < 3; ++corner) {
+                    const uint32_t v = newIndex[originals[corner]];
+                    corners[corner] = v;
+                    if (v != nextNew) {
+                        indexStream.putVarint(nextNew - v);
+                        continue;
+                    }
+                    indexStream.putVarint(newVertexCode);
+                    ++nextNew;
+
+                    const auto prediction = predictPosition(i > info.firstFace ? &previous : nullptr, current.v1,
+                                                            current.v2, corner, info.firstVertex, lastNew, vertex);
+                    for (int c = 0; c < 3; ++c)
+                        positionStream.putVarint(zigzag(static_cast<int64_t>(quantized[v].position[c]) - prediction[c]));
+                    for (int c = 0; c < 2; ++c) {
+                        const int64_t last = lastNew != UINT32_MAX ? quantized[lastNew].normal[c] : 0;
+                        if (hasNormals)
+                            normalStream.putVarint(zigzag(static_cast<int64_t>(quantized[v].normal[c]) - last));
+                        const int64_t lastTexCoord = lastNew != UINT32_MAX ? quantized[lastNew].texCoord[c] : 0;
+                        if (hasTexCoords)
+                            texCoordStream.putVarint(
+                                zigzag(static_cast<int64_t>(quantized[v].texCoord[c]) - lastTexCoord));
+                    }
+                    lastNew = v;
+                }
+                previous = current;
+            }
+
+            ByteWriter payload;
+            writeStream(payload, indexStream.bytes);
+            writeStream(payload, positionStream.bytes);
+            writeStream(payload, normalStream.bytes);
+            writeStream(payload, texCoordStream.bytes);
+            payloads[block] = std::move(payload.bytes);
+        }
+    }, 1);
+
+    ByteWriter header;
+    for (char c : magic)
+        header.put(static_cast<uint8_t>(c));
+    header.put(version);
+    header.put((hasNormals ? hasNormalsFlag : 0) | (hasTexCoords ? hasTexCoordsFlag : 0));
+    header.put(positionBits);
+    header.put(static_cast<uint64_t>(order.size()));
+    header.put(static_cast<uint64_t>(faces.size()));
+    for (float value : {bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z,
+                        texMin[0], texMin[1], texMax[0], texMax[1]})
+        header.put(order.empty() ? 0.0f : value);
+    header.put(static_cast<uint64_t>(smoothGroups.size()));
+    for (const auto& [start, end] : smoothGroups) {
+        header.put(static_cast<uint64_t>(start));
+        header.put(static_cast<uint64_t>(end));
+    }
+    header.put(static_cast<uint64_t>(blocks.size()));
+    uint64_t offset = header.bytes.size() + blocks.size() * blockEntrySize;
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        blocks[block].offset = offset;
+        blocks[block].size = payloads[block].size();
+        offset += blocks[block].size;
+        for (uint64_t value : {blocks[block].firstFace, blocks[block].faceCount, blocks[block].firstVertex,
+                               blocks[block].vertexCount, blocks[block].offset, blocks[block].size})
+            header.put(value);
+    }
+
+    file.write(reinterpret_cast<const char*>(header.bytes.data()), static_cast<std::streamsize>(header.bytes.size()));
+    for (const auto& payload : payloads)
+        file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    file.close();
+
+    std::cout << "Saved compressed mesh: " << filename << " containing " << order.size() << " vertices and "
+              << faces.size() << " faces in " << offset << " bytes." << std::endl;
+}
+
+void Mesh::loadCompressed(const std::string& filename)
+{
+    clear();
+
+    const MemoryPeakScope memoryScope;
+
+    const MappedFile file{filename};
+    try {
+        ByteReader in{file.begin(), file.end()};
+        for (char c : magic)
+            if (in.get<uint8_t>() != static_cast<uint8_t>(c))
+                throw std::runtime_error("not a compressed mesh file");
+        if (in.get<uint32_t>() != version)
+            throw std::runtime_error("unsupported version");
+        const uint32_t flags = in.get<uint32_t>();
+        const bool hasNormals = flags & hasNormalsFlag;
+        const bool hasTexCoords = flags & hasTexCoordsFlag;
+        const uint32_t positionBits = in.get<uint32_t>();
+        if (positionBits < 1 || positionBits > 30)
+            throw std::runtime_error("invalid quantization");
+        const uint64_t vertexCount = in.get<uint64_t>();
+        const uint64_t faceCount = in.get<uint64_t>();
+        if (vertexCount > UINT32_MAX || vertexCount > 3 * faceCount)
+            throw std::runtime_error("invalid mesh size");
+
+        std::array<float, 10> ranges;
+        for (float& value : ranges)
+            value = in.get<float>();
+        const Quantizer<3> positionQuantizer{{ranges[0], ranges[1], ranges[2]}, {ranges[3], ranges[4], ranges[5]},
+                                             positionBits};
+        const Quantizer<2> texCoordQuantizer{{ranges[6], ranges[7]}, {ranges[8], ranges[9]}, texCoordBits};
+
+        const uint64_t groupCount = in.get<uint64_t>();
+        for (uint64_t i = 0; i < groupCount; ++i) {
+            const uint64_t start = in.get<uint64_t>(), end = in.get<uint64_t>();
+            if (start > end || end > faceCount)
+                throw std::runtime_error("invalid smooth group");
+            smoothGroups.emplace_back(start, end);
+        }
+
+        // the block table has to cover all faces and vertices in order
+        const uint64_t blockCount = in.get<uint64_t>();
+        if (blockCount > file.size() / blockEntrySize)
+            throw std::runtime_error("invalid block table");
+        std::vector<BlockInfo> blocks(blockCount);
+        uint64_t nextFace = 0, nextVertex = 0;
+        for (BlockInfo& block : blocks) {
+            block = {in.get<uint64_t>(), in.get<uint64_t>(), in.get<uint64_t>(),
+                     in.get<uint64_t>(), in.get<uint64_t>(), in.get<uint64_t>()};
+            if (block.firstFace != nextFace || block.firstVertex != nextVertex || block.faceCount > facesPerBlock
+                || block.vertexCount > 3 * block.faceCount || block.offset > file.size()
+                || block.size > file.size() - block.offset)
+                throw std::runtime_error("invalid block table");
+            nextFace += block.faceCount;
+            nextVertex += block.vertexCount;
+        }
+        if (nextFace != faceCount || nextVertex != vertexCount)
+            throw std::runtime_error("invalid block table");
+
+        vertices.resize(vertexCount);
+        faces.resize(faceCount);
+        if (hasNormals)
+            normals.resize(vertexCount);
+        if (hasTexCoords)
+            texCoords.resize(vertexCount);
+
+        // decode the blocks in parallel, each one writes its own range of faces and vertices
+        parallelFor(blocks.size(), [&](size_t begin, size_t end) -> void {
+            for (size_t b = begin; b < end; ++b) {
+                const BlockInfo& block = blocks[b];
+                ByteReader payload{file.data() + block.offset, file.data() + block.offset + block.size};
+                const std::vector<uint8_t> indexBytes = readStream(payload);
+                const std::vector<uint8_t> positionBytes = readStream(payload);
+                const std::vector<uint8_t> normalBytes = readStream(payload);
+                const std::vector<uint8_t> texCoordBytes = readStream(payload);
+                ByteReader indexStream{indexBytes.data(), indexBytes.data() + indexBytes.size()};
+                ByteReader positionStream{positionBytes.data(), positionBytes.data() + positionBytes.size()};
+                ByteReader normalStream{normalBytes.data(), normalBytes.data() + normalBytes.size()};
+                ByteReader texCoordStream{texCoordBytes.data(), texCoordBytes.data() + texCoordBytes.size()};
+
+                // the predictors need the quantized values of the vertices of this block
+                std::vector<QuantizedVertex> quantized(block.vertexCount);
+                auto vertex = [&](uint32_t v) -> const QuantizedVertex& { return quantized[v - block.firstVertex]; };
+                const uint64_t endVertex = block.firstVertex + block.vertexCount;
+                uint32_t nextNew = static_cast<uint32_t>(block.firstVertex);
+                uint32_t lastNew = UINT32_MAX;
+
+                for (size_t i = block.firstFace; i < block.firstFace + block.faceCount; ++i) {
+                    uint32_t* corners = &faces[i].v1;
+                    for (size_t corner = 0; corner < 3; ++corner) {
+                        const uint64_t code = indexStream.getVarint();
+                        if (code != newVertexCode) {
+                            if (code > nextNew)
+                                throw std::runtime_error("invalid vertex index");
+                            corners[corner] = static_cast<uint32_t>(nextNew - code);
+                            continue;
+                        }
+                        if (nextNew >= endVertex)
+                            throw std::runtime_error("too many vertices in a block");
+                        const uint32_t v = corners[corner] = nextNew++;
+                        QuantizedVertex& q = quantized[v - block.firstVertex];
+
+                        const auto prediction = predictPosition(i > block.firstFace ? &faces[i - 1] : nullptr,
+                                                                corners[0], corners[1], corner, block.firstVertex,
+                                                                lastNew, vertex);
+                        for (int c = 0; c < 3; ++c)
+                            q.position[c] = static_cast<uint32_t>(prediction[c] + unzigzag(positionStream.getVarint()));
+                        positionQuantizer.dequantize(q.position, &vertices[v].x);
+                        for (int c = 0; c < 2; ++c) {
+                            if (hasNormals)
+                                q.normal[c] = static_cast<uint32_t>((lastNew != UINT32_MAX ? vertex(lastNew).normal[c] : 0)
+                                                                    + unzigzag(normalStream.getVarint()));
+                            if (hasTexCoords)
+                                q.texCoord[c] = static_cast<uint32_t>(
+                                    (lastNew != UINT32_MAX ? vertex(lastNew).texCoord[c] : 0)
+                                    + unzigzag(texCoordStream.getVarint()));
+                        }
+                        if (hasNormals)
+                            normals[v] = decodeNormal(q.normal[0], q.normal[1]);
+                        if (hasTexCoords)
+                            texCoordQuantizer.dequantize(q.texCoord, &texCoords[v].x);
+                        lastNew = v;
+                    }
+                }
+                if (nextNew != endVertex)
+                    throw std::runtime_error("missing vertices in a block");
+            }
+        }, 1);
+    }
+    catch (const std::exception& e) {
+        clear();
+        throw std::runtime_error("failed to load the compressed mesh " + filename + "\n" + e.what());
+    }
+
+    updateBounds();
+    updateFaceAreas();
+    if (normals.empty())
+        updateNormals();
+
+    peakLoadTransient = memoryScope.transient(getMemoryUsage().resident());
+
+    std::cout << "Loaded compressed mesh: " << filename << " containing " << vertices.size() << " vertices and "
+              << faces.size() << " faces." << std::endl;
+}
@@ -0,0 +1,135 @@
+#include "meshdistance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "parallel.h"
+#include "surfacesampler.h"
+
+namespace {
+
+/// looks up closest points in order, each query is bounded by the result of the one before
+class NearestSurface {
+public:
+    explicit NearestSurface(const TriangleBVH& bvh) : bvh{bvh} {}
+
+    float distance(const Point3D& p)
+    {
+        // the closest point of the previous query is at most this far away, rounding aside
+        ClosestPoint closest;
+        const float bound = (last + ::distance(p, previous)) * 1.0001f;
+        if (!bvh.closestPoint(p, closest, bound))
+            bvh.closestPoint(p, closest);
+        previous = p;
+        last = closest.distance();
+        return last;
+    }
+
+private:
+    const TriangleBVH& bvh;
+    Point3D previous{0.0f};
+    float last{std::numeric_limits<float>::infinity()};
+};
+
+/// distances of the samples and vertices of one mesh to the faces of another
+SurfaceDistance measure(const Mesh& from, const TriangleBVH& to, const MeshDistanceSettings& settings,
+                        std::vector<float>* vertexErrors)
+{
+    std::vector<SurfaceSample> samples = SurfaceSampler{from}.sample(settings.samples, settings.seed);
+    parallelSort(samples.begin(), samples.end(),
+                 [](const SurfaceSample& x, const SurfaceSample& y) -> bool { return x.face < y.face; });
+
+    // sums per chunk, so the result only depends on the number of threads through rounding
+    const size_t chunks = chunkCount(samples.size(), 1024);
+    std::vector<double> sums(chunks, 0.0), squares(chunks, 0.0);
+    std::vector<float> maxima(chunks, 0.0f);
+    parallelForChunks(samples.size(), chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        NearestSurface nearest{to};
+        double sum = 0.0, square = 0.0;
+        float max = 0.0f;
+        for (size_t i = begin; i < end; ++i) {
+            const float d = nearest.distance(samples[i].position);
+            sum += d;
+            square += double{d} * d;
+            max = std::max(max, d);
+        }
+        sums[chunk] = sum;
+        squares[chunk] = square;
+        maxima[chunk] = max;
+    });
+
+    SurfaceDistance result;
+    result.samples = samples.size();
+    double sum = 0.0, square = 0.0;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        sum += sums[chunk];
+        square += squares[chunk];
+        result.max = std::max(result.max, maxima[chunk]);
+    }
+    if (result.samples) {
+        result.mean = sum / static_cast<double>(result.samples);
+        result.rms = std::sqrt(square / static_cast<double>(result.samples));
+    }
+
+    // vertices no face uses are not part of the surface
+    const VertexList& vertices = from.getVertices();
+    std::vector<uint8_t> referenced(vertices.size(), 0);
+    for (const TriangleIndices& t : from.getFaces())
+        referenced[t.v1] = referenced[t.v2] = referenced[t.v3] = 1;
+
+    // neighboring vertices are usually stored close together, like the samples of a face
+    std::vector<float> distances(vertices.size(), 0.0f);
+    const size_t vertexChunks = chunkCount(vertices.size(), 1024);
+    std::vector<float> vertexMaxima(vertexChunks, 0.0f);
+    parallelForChunks(vertices.size(), vertexChunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        NearestSurface nearest{to};
+        float max = 0.0f;
+        for (size_t i = begin; i < end; ++i) {
+            if (!referenced[i])
+                continue;
+            distances[i] = nearest.distance(vertices[i]);
+            max = std::max(max, distances[i]);
+        }
+        vertexMaxima[chunk] = max;
+    });
+    for (const float max : vertexMaxima)
+        result.max = std::max(result.max, max);
+    if (vertexErrors)
+        *vertexErrors = std::move(distances);
+    return result;
+}
+
+} // namespace
+
+double MeshDistance::rms() const
+{
+    const double samples = static_cast<double>(forward.samples + backward.samples);
+    if (!samples)
+        return 0.0;
+    return std::sqrt((forward.rms * forward.rms * static_cast<double>(forward.samples)
+                      + backward.rms * backward.rms * static_cast<double>(backward.samples))
+                     / samples);
+}
+
+MeshDistance compareMeshes(const Mesh& a, const TriangleBVH& bvhA, const Mesh& b, const TriangleBVH& bvhB,
+                           const MeshDistanceSettings& settings)
+{
+    if (bvhA.getMesh() != &a || bvhB.getMesh() != &b)
+        throw std::runtime_error("the BVHs for comparing meshes must be built over the meshes");
+    if (a.getFaces().empty() || b.getFaces().empty())
+        throw std::runtime_error("comparing meshes needs faces on both meshes");
+
+    MeshDistance result;
+    result.forward = measure(a, bvhB, settings, settings.vertexErrors ? &result.vertexErrorsA : nullptr);
+    result.backward = measure(b, bvhA, settings, settings.vertexErrors ? &result.vertexErrorsB : nullptr);
+    return result;
+}
+
+MeshDistance compareMeshes(const Mesh& a, const Mesh& b, const MeshDistanceSettings& settings)
+{
+    const TriangleBVH bvhA{a}, bvhB{b};
+    return compareMeshes(a, bvhA, b, bvhB, settings);
+}
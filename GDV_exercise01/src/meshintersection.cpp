@@ -0,0 +1,395 @@
+#include "meshintersection.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "parallel.h"
+
+namespace {
+
+/// faces tested at once, a whole leaf
+constexpr uint32_t batchSize = TriangleBVH::maxLeafSize;
+/// planes closer to parallel than this squared sine of their angle are treated as coplanar
+constexpr float coplanarSine = 1e-10f;
+
+struct NodePair {
+    uint32_t a, b;
+};
+
+/// an intersecting pair of faces together with its segment, sorted before they are split up
+struct Intersection {
+    FacePair pair;
+    LineSegment segment;
+};
+
+/// a face with the unit normal of its plane, the normal is zero for faces without area
+struct Triangle {
+    std::array<Point3D, 3> p;
+    Point3D normal;
+    std::array<uint32_t, 3> v;
+};
+
+/// the faces of a leaf in structure of arrays layout, with their planes dot(normal, p) = offset
+struct FaceBatch {
+    uint32_t count{0};
+    std::array<uint32_t, batchSize> face;
+    float x[3][batchSize], y[3][batchSize], z[3][batchSize];
+    float normalX[batchSize], normalY[batchSize], normalZ[batchSize], offset[batchSize];
+};
+
+/// points where a face meets the plane of the other face, as an interval along the line both planes share
+struct Crossing {
+    float tMin{std::numeric_limits<float>::infinity()}, tMax{-std::numeric_limits<float>::infinity()};
+    Point3D pMin, pMax;
+
+    void add(const Point3D& p, const Point3D& direction)
+    {
+        const float t = dot(direction, p);
+        if (t < tMin) {
+            tMin = t;
+            pMin = p;
+        }
+        if (t > tMax) {
+            tMax = t;
+            pMax = p;
+        }
+    }
+};
+
+Crossing crossPlane(const Triangle& t, const std::array<float, 3>& d, const Point3D& direction)
+{
+    Crossing crossing;
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        if (d[i] == 0.0f)
+            crossing.add(t.p[i], direction);
+        if ((d[i] < 0.0f && d[j] > 0.0f) || (d[i] > 0.0f && d[j] < 0.0f))
+            crossing.add(t.p[i] + (t.p[j] - t.p[i]) * (d[i] / (d[i] - d[j])), direction);
+    }
+    return crossing;
+}
+
+/// twice the signed area of the 2D triangle (a, b, c) in the plane of the axes u and v
+float orient(const Point3D& a, const Point3D& b, const Point3D& c, int u, int v)
+{
+    auto coordinate = [](const Point3D& p, int axis) -> float { return axis == 0 ? p.x : axis == 1 ? p.y : p.z; };
+    return (coordinate(b, u) - coordinate(a, u)) * (coordinate(c, v) - coordinate(a, v))
+         - (coordinate(b, v) - coordinate(a, v)) * (coordinate(c, u) - coordinate(a, u));
+}
+
+bool strictlyInside(const Point3D& p, const Triangle& t, int u, int v)
+{
+    const float o0 = orient(t.p[0], t.p[1], p, u, v);
+    const float o1 = orient(t.p[1], t.p[2], p, u, v);
+    const float o2 = orient(t.p[2], t.p[0], p, u, v);
+    return (o0 > 0.0f && o1 > 0.0f && o2 > 0.0f) || (o0 < 0.0f && o1 < 0.0f && o2 < 0.0f);
+}
+
+/// whether two faces in the same plane overlap in an area, a point of the overlap goes to point
+bool coplanarOverlap(const Triangle& a, const Triangle& b, Point3D& point)
+{
+    // project along the largest component of the normal
+    const Point3D n = abs(a.normal);
+    const int drop = n.x >= n.y && n.x >= n.z ? 0 : n.y >= n.z ? 1 : 2;
+    const int u = (drop + 1) % 3, v = (drop + 2) % 3;
+
+    // edges crossing in their interiors
+    for (int i = 0; i < 3; ++i) {
+        const Point3D& p = a.p[i];
+        const Point3D& q = a.p[(i + 1) % 3];
+        for (int j = 0; j < 3; ++j) {
+            const Point3D& r = b.p[j];
+            const Point3D& s = b.p[(j + 1) % 3];
+            const float o1 = orient(p, q, r, u, v), o2 = orient(p, q, s, u, v);
+            const float o3 = orient(r, s, p, u, v), o4 = orient(r, s, q, u, v);
+            if (((o1 > 0.0f && o2 < 0.0f) || (o1 < 0.0f && o2 > 0.0f))
+                && ((o3 > 0.0f && o4 < 0.0f) || (o3 < 0.0f && o4 > 0.0f))) {
+                point = p + (q - p) * (o3 / (o3 - o4));
+                return true;
+            }
+        }
+    }
+    // one face inside the other, the centroids also catch faces lying exactly on top of each other
+    for (const auto& [inner, outer] : {std::pair{&a, &b}, std::pair{&b, &a}}) {
+        const Point3D centroid = (inner->p[0] + inner->p[1] + inner->p[2]) / 3.0f;
+        for (const Point3D& p : {inner->p[0], inner->p[1], inner->p[2], centroid}) {
+            if (strictlyInside(p, *outer, u, v)) {
+                point = p;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief the exact test of a face pair the batch could not reject
+ * the planes are anchored at a shared vertex if there is one, so its distances are exactly 0
+ * and faces of one mesh which only meet there give an empty interval
+ */
+bool intersectTriangles(const Triangle& a, const Triangle& b, bool self, LineSegment& segment)
+{
+    if (dot(a.normal, a.normal) == 0.0f || dot(b.normal, b.normal) == 0.0f)
+        return false;
+
+    int shared = 0;
+    Point3D anchorA = a.p[0], anchorB = b.p[0];
+    if (self) {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                if (a.v[i] == b.v[j]) {
+                    ++shared;
+                    anchorA = anchorB = a.p[i];
+                }
+            }
+        }
+        if (shared > 1)
+            return false;
+    }
+
+    std::array<float, 3> dA, dB;
+    for (int i = 0; i < 3; ++i) {
+        dA[i] = dot(b.normal, a.p[i] - anchorB);
+        dB[i] = dot(a.normal, b.p[i] - anchorA);
+    }
+    auto separated = [](const std::array<float, 3>& d) -> bool {
+        return (d[0] > 0.0f && d[1] > 0.0f && d[2] > 0.0f) || (d[0] < 0.0f && d[1] < 0.0f && d[2] < 0.0f);
+    };
+    if (separated(dA) || separated(dB))
+        return false;
+
+    const Point3D direction = cross(a.normal, b.normal);
+    if (dot(direction, direction) < coplanarSine) {
+        Point3D point;
+        if (!coplanarOverlap(a, b, point))
+            return false;
+        segment = {point, point};
+        return true;
+    }
+
+    // both faces cross the line where the planes meet, they intersect where their intervals overlap
+    const Crossing crossA = crossPlane(a, dA, direction);
+    const Crossing crossB = crossPlane(b, dB, direction);
+    const float lo = std::max(crossA.tMin, crossB.tMin), hi = std::min(crossA.tMax, crossB.tMax);
+    if (shared ? !(hi > lo) : !(hi >= lo))
+        return false;
+    segment = {crossA.tMin > crossB.tMin ? crossA.pMin : crossB.pMin,
+               crossA.tMax < crossB.tMax ? crossA.pMax : crossB.pMax};
+    return true;
+}
+
+/// finds the intersecting faces below pairs of nodes of two BVHs, or of the same BVH twice
+class Collider {
+public:
+    Collider(const TriangleBVH& bvhA, const TriangleBVH& bvhB, bool self) : bvhA{bvhA}, bvhB{bvhB}, self{self}
+    {
+    }
+
+    /// all intersecting face pairs, sorted
+    std::vector<Intersection> run() const
+    {
+        std::vector<Intersection> result;
+        if (bvhA.getNodes().empty() || bvhB.getNodes().empty())
+            return result;
+
+        // expand the top levels until there are enough node pairs to keep all cores busy
+        std::vector<NodePair> frontier{{0, 0}}, next;
+        const size_t target = 64 * numThreads();
+        while (frontier.size() < target) {
+            next.clear();
+            bool expanded = false;
+            for (const NodePair& pair : frontier) {
+                if (leaves(pair)) {
+                    next.push_back(pair);
+                    continue;
+                }
+                expand(pair, next);
+                expanded = true;
+            }
+            std::swap(frontier, next);
+            if (!expanded)
+                break;
+        }
+
+        // the node pairs differ a lot in work, so the threads take them one by one
+        const size_t workers = std::min(numThreads(), frontier.size());
+        std::vector<std::vector<Intersection>> found(workers);
+        std::atomic<size_t> nextPair{0};
+        parallelForChunks(workers, workers, [&](size_t worker, size_t, size_t) -> void {
+            std::vector<NodePair> stack;
+            for (size_t i = nextPair++; i < frontier.size(); i = nextPair++) {
+                stack.push_back(frontier[i]);
+                while (!stack.empty()) {
+                    const NodePair pair = stack.back();
+                    stack.pop_back();
+                    if (leaves(pair))
+                        testLeaves(pair, found[worker]);
+                    else
+                        expand(pair, stack);
+                }
+            }
+        });
+
+        for (const auto& part : found)
+            result.insert(result.end(), part.begin(), part.end());
+        parallelSort(result.begin(), result.end(), [](const Intersection& x, const Intersection& y) -> bool {
+            return x.pair.a != y.pair.a ? x.pair.a < y.pair.a : x.pair.b < y.pair.b;
+        });
+        return result;
+    }
+
+private:
+    bool leaves(const NodePair& pair) const
+    {
+        return bvhA.getNodes()[pair.a].isLeaf() && bvhB.getNodes()[pair.b].isLeaf();
+    }
+
+    /// push the pairs of children which may intersect, always splitting the larger node
+    void expand(const NodePair& pair, std::vector<NodePair>& out) const
+    {
+        const TriangleBVH::Node& a = bvhA.getNodes()[pair.a];
+        const TriangleBVH::Node& b = bvhB.getNodes()[pair.b];
+        if (self && pair.a == pair.b) {
+            // each unordered pair of subtrees once
+            out.push_back({a.left, a.left});
+            out.push_back({a.right, a.right});
+            out.push_back({a.left, a.right});
+            return;
+        }
+        if (!a.bounds.overlaps(b.bounds))
+            return;
+        const bool splitA = b.isLeaf() || (!a.isLeaf() && a.bounds.surfaceArea() >= b.bounds.surfaceArea());
+        const TriangleBVH::Node& split = splitA ? a : b;
+        for (const uint32_t child : {split.left, split.right}) {
+            const NodePair childPair = splitA ? NodePair{child, pair.b} : NodePair{pair.a, child};
+            const AABB& childBounds = (splitA ? bvhA : bvhB).getNodes()[child].bounds;
+            if (childBounds.overlaps(splitA ? b.bounds : a.bounds))
+                out.push_back(childPair);
+        }
+    }
+
+    Triangle triangle(const TriangleBVH& bvh, uint32_t face) const
+    {
+        const TriangleIndices& t = bvh.getMesh()->getFaces()[face];
+        const VertexList& vertices = bvh.getMesh()->getVertices();
+        Triangle result{{vertices[t.v1], vertices[t.v2], vertices[t.v3]}, {}, {t.v1, t.v2, t.v3}};
+        result.normal = normalize(cross(result.p[1] - result.p[0], result.p[2] - result.p[0]));
+        return result;
+    }
+
+    void testLeaves(const NodePair& pair, std::vector<Intersection>& out) const
+    {
+        const TriangleBVH::Node& leafA = bvhA.getNodes()[pair.a];
+        const TriangleBVH::Node& leafB = bvhB.getNodes()[pair.b];
+        const bool sameLeaf = self && pair.a == pair.b;
+        if (!sameLeaf && !leafA.bounds.overlaps(leafB.bounds))
+            return;
+
+        FaceBatch batch;
+        std::array<Triangle, batchSize> trianglesB;
+        batch.count = leafB.count;
+        for (uint32_t lane = 0; lane < batchSize; ++lane) {
+            // unused lanes repeat the last face and are masked out
+            const uint32_t face = bvhB.getFaceOrder()[leafB.left + std::min(lane, leafB.count - 1)];
+            const Triangle t = triangle(bvhB, face);
+            batch.face[lane] = face;
+            trianglesB[lane] = t;
+            for (int k = 0; k < 3; ++k) {
+                batch.x[k][lane] = t.p[k].x;
+                batch.y[k][lane] = t.p[k].y;
+                batch.z[k][lane] = t.p[k].z;
+            }
+            batch.normalX[lane] = t.normal.x;
+            batch.normalY[lane] = t.normal.y;
+            batch.normalZ[lane] = t.normal.z;
+            batch.offset[lane] = dot(t.normal, t.p[0]);
+        }
+
+        for (uint32_t i = 0; i < leafA.count; ++i) {
+            const uint32_t faceA = bvhA.getFaceOrder()[leafA.left + i];
+            const Triangle a = triangle(bvhA, faceA);
+            const float offsetA = dot(a.normal, a.p[0]);
+
+            // reject the faces of the batch lying strictly on one side of the plane of the other face
+            uint8_t candidate[batchSize];
+            for (uint32_t lane = 0; lane < batchSize; ++lane) {
+                float dB[3], dA[3];
+                for (int k = 0; k < 3; ++k) {
+                    dB[k] = a.normal.x * batch.x[k][lane] + a.normal.y * batch.y[k][lane]
+                          + a.normal.z * batch.z[k][lane] - offsetA;
+                    dA[k] = batch.normalX[lane] * a.p[k].x + batch.normalY[lane] * a.p[k].y
+                          + batch.normalZ[lane] * a.p[k].z - batch.offset[lane];
+                }
+                const bool separated = (dB[0] > 0.0f && dB[1] > 0.0f && dB[2] > 0.0f)
+                                    || (dB[0] < 0.0f && dB[1] < 0.0f && dB[2] < 0.0f)
+                                    || (dA[0] > 0.0f && dA[1] > 0.0f && dA[2] > 0.0f)
+                                    || (dA[0] < 0.0f && dA[1] < 0.0f && dA[2] < 0.0f);
+                candidate[lane] = !separated && lane < batch.count && (!sameLeaf || lane > i);
+            }
+
+            for (uint32_t lane = 0; lane < batchSize; ++lane) {
+                LineSegment segment;
+                if (!candidate[lane] || !intersectTriangles(a, trianglesB[lane], self, segment))
+                    continue;
+                FacePair facePair{faceA, batch.face[lane]};
+                if (self && facePair.a > facePair.b) {
+                    std::swap(facePair.a, facePair.b);
+                    std::swap(segment.start, segment.end);
+                }
+                out.push_back({facePair, segment});
+            }
+        }
+    }
+
+    const TriangleBVH& bvhA;
+    const TriangleBVH& bvhB;
+    bool self;
+};
+
+MeshIntersection collect(const std::vector<Intersection>& intersections, bool segments)
+{
+    MeshIntersection result;
+    result.pairs.reserve(intersections.size());
+    for (const Intersection& intersection : intersections)
+        result.pairs.push_back(intersection.pair);
+    if (segments) {
+        result.segments.reserve(intersections.size());
+        for (const Intersection& intersection : intersections)
+            result.segments.push_back(intersection.segment);
+    }
+    return result;
+}
+
+} // namespace
+
+MeshIntersection intersectMeshes(const Mesh& a, const TriangleBVH& bvhA, const Mesh& b, const TriangleBVH& bvhB,
+                                 bool segments)
+{
+    if (bvhA.getMesh() != &a || bvhB.getMesh() != &b)
+        throw std::runtime_error("the BVHs for intersecting meshes must be built over the meshes");
+    return collect(Collider{bvhA, bvhB, false}.run(), segments);
+}
+
+MeshIntersection intersectMeshes(const Mesh& a, const Mesh& b, bool segments)
+{
+    const TriangleBVH bvhA{a}, bvhB{b};
+    return intersectMeshes(a, bvhA, b, bvhB, segments);
+}
+
+MeshIntersection selfIntersections(const Mesh& mesh, const TriangleBVH& bvh, bool segments)
+{
+    if (bvh.getMesh() != &mesh)
+        throw std::runtime_error("the BVH for finding self-intersections must be built over the mesh");
+    return collect(Collider{bvh, bvh, true}.run(), segments);
+}
+
+MeshIntersection selfIntersections(const Mesh& mesh, bool segments)
+{
+    const TriangleBVH bvh{mesh};
+    return selfIntersections(mesh, bvh, segments);
+}
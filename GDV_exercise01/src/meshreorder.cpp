@@ -0,0 +1,129 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// grid resolution per axis with a few cells per element, finer grids only add radix sort passes
+unsigned gridBits(size_t count)
+{
+    return std::clamp<unsigned>(static_cast<unsigned>(std::bit_width(count)) / 3 + 2, 1, 21);
+}
+
+/// curve code and original index of a vertex or face
+struct CodedIndex {
+    uint64_t code;
+    uint32_t index;
+};
+
+/// sort the indices [0, count) by the code computed for each of them
+CountedVector<CodedIndex, MemoryCategory::Temporary> sortByCode(size_t count, unsigned codeBits, auto&& codeOf)
+{
+    CountedVector<CodedIndex, MemoryCategory::Temporary> order(count), scratch(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            order[i] = {codeOf(i), static_cast<uint32_t>(i)};
+    });
+    parallelRadixSort(order.data(), scratch.data(), count, [](const CodedIndex& c) -> uint64_t { return c.code; },
+                      codeBits);
+    return order;
+}
+
+/// attribute[i] = old attribute[order[i].index] if the attribute has one entry per element
+template <typename List>
+void permute(List& attribute, const CountedVector<CodedIndex, MemoryCategory::Temporary>& order)
+{
+    if (attribute.size() != order.size())
+        return;
+    List permuted(order.size());
+    parallelFor(order.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            permuted[i] = attribute[order[i].index];
+    });
+    attribute = std::move(permuted);
+}
+
+} // namespace
+
+void Mesh::reorder(SpaceFillingCurve curve)
+{
+    if (vertices.size() >= UINT32_MAX || faces.size() >= UINT32_MAX)
+        throw std::runtime_error("the mesh is too large for 32 bit reordering");
+    updateBounds();
+
+    // vertices along the curve through the bounding box
+    const unsigned vertexBits = gridBits(vertices.size());
+    const SpaceFillingCurveGrid vertexGrid{aabb, curve, vertexBits};
+    const auto vertexOrder = sortByCode(vertices.size(), 3 * vertexBits, [&](size_t i) -> uint64_t {
+        return vertexGrid.code(vertices[i]);
+    });
+
+    // faces are only moved inside their smooth group or run of flat faces, so the segment index
+    // forms the high bits of the key and the centroid code the low bits
+    std::vector<size_t> segmentStarts{0};
+    for (const auto& [start, end] : smoothGroups) {
+        if (start > segmentStarts.back())
+            segmentStarts.push_back(start);
+        if (end > segmentStarts.back())
+            segmentStarts.push_back(end);
+    }
+    const size_t segments = segmentStarts.size();
+    segmentStarts.push_back(SIZE_MAX);
+    const unsigned segmentBits = std::bit_width(segments - 1);
+    if (segmentBits > 61)
+        throw std::runtime_error("the mesh has too many smooth groups to reorder");
+    const unsigned cellBits = std::min(gridBits(faces.size()), (64 - segmentBits) / 3);
+
+    const SpaceFillingCurveGrid faceGrid{aabb, curve, cellBits};
+    const size_t chunks = chunkCount(faces.size());
+    std::vector<size_t> firstSegment(chunks);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        const size_t begin = faces.size() * chunk / chunks;
+        firstSegment[chunk] = std::upper_bound(segmentStarts.begin(), segmentStarts.end(), begin) - segmentStarts.begin() - 1;
+    }
+    CountedVector<CodedIndex, MemoryCategory::Temporary> faceOrder(faces.size()), scratch(faces.size());
+    parallelForChunks(faces.size(), chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        size_t segment = firstSegment[chunk];
+        for (size_t i = begin; i < end; ++i) {
+            while (i >= segmentStarts[segment + 1])
+                ++segment;
+            const TriangleIndices& t = faces[i];
+            const Vertex centroid = (vertices[t.v1] + vertices[t.v2] + vertices[t.v3]) / 3.0f;
+            faceOrder[i] = {uint64_t{segment} << (3 * cellBits) | faceGrid.code(centroid), static_cast<uint32_t>(i)};
+        }
+    });
+
+    // the face codes are computed, so the vertices can move now
+    CountedVector<uint32_t, MemoryCategory::Temporary> newIndex(vertices.size());
+    parallelFor(vertices.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            newIndex[vertexOrder[i].index] = static_cast<uint32_t>(i);
+    });
+    permute(normals, vertexOrder);
+    permute(texCoords, vertexOrder);
+    permute(ambientOcclusion, vertexOrder);
+    permute(vertices, vertexOrder);
+
+    parallelRadixSort(faceOrder.data(), scratch.data(), faces.size(),
+                      [](const CodedIndex& c) -> uint64_t { return c.code; }, 3 * cellBits + segmentBits);
+    scratch = {};
+
+    FaceList reordered(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const TriangleIndices& t = faces[faceOrder[i].index];
+            reordered[i] = {newIndex[t.v1], newIndex[t.v2], newIndex[t.v3]};
+        }
+    });
+    faces = std::move(reordered);
+    permute(faceAreas, faceOrder);
+
+    std::cout << "Reordered mesh along the " << (curve == SpaceFillingCurve::Hilbert ? "Hilbert" : "Morton")
+              << " curve: " << vertices.size() << " vertices and " << faces.size() << " faces in "
+              << segments << " segments." << std::endl;
+}
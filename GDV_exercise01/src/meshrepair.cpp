@@ -0,0 +1,167 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// why a face is removed, Keep for faces which stay
+enum class FaceDefect : uint8_t { Keep, Invalid, Degenerate, ZeroArea, Duplicate, Count };
+
+/// the sorted vertex indices of a face, equal keys belong to duplicate faces
+struct FaceKey {
+    std::array<uint32_t, 3> vertices;
+    uint32_t face;
+
+    bool operator<(const FaceKey& other) const
+    {
+        return vertices < other.vertices || (vertices == other.vertices && face < other.face);
+    }
+};
+
+} // namespace
+
+MeshRepairReport Mesh::repair(float minArea)
+{
+    const size_t count = faces.size();
+    const size_t vertexCount = vertices.size();
+    if (count >= UINT32_MAX)
+        throw std::runtime_error("the mesh has too many faces for 32 bit face indices");
+
+    // classify every face on its own, only the valid ones take part in the duplicate search
+    constexpr uint32_t skipped = UINT32_MAX;
+    std::vector<uint8_t> defects(count);
+    CountedVector<FaceKey, MemoryCategory::Temporary> keys(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const TriangleIndices& t = faces[i];
+            FaceDefect defect = FaceDefect::Keep;
+            if (t.v1 >= vertexCount || t.v2 >= vertexCount || t.v3 >= vertexCount) {
+                defect = FaceDefect::Invalid;
+            }
+            else if (t.v1 == t.v2 || t.v2 == t.v3 || t.v3 == t.v1) {
+                defect = FaceDefect::Degenerate;
+            }
+            else {
+                // always from the positions, stored face areas may be stale after vertices moved, e.g. by welding
+                const Vertex& v1 = vertices[t.v1];
+                const float area = cross(vertices[t.v2] - v1, vertices[t.v3] - v1).norm() * 0.5f;
+                if (!(area > minArea) || !std::isfinite(area))
+                    defect = FaceDefect::ZeroArea;
+            }
+            defects[i] = static_cast<uint8_t>(defect);
+
+            keys[i] = {{skipped, skipped, skipped}, static_cast<uint32_t>(i)};
+            if (defect == FaceDefect::Keep) {
+                keys[i].vertices = {t.v1, t.v2, t.v3};
+                std::sort(keys[i].vertices.begin(), keys[i].vertices.end());
+            }
+        }
+    });
+
+    // every run of equal keys keeps its lowest face, each chunk handles the runs starting inside of it
+    parallelSort(keys.begin(), keys.end());
+    const size_t chunks = chunkCount(count, size_t{1} << 16);
+    parallelForChunks(count, chunks, [&](size_t, size_t begin, size_t end) -> void {
+        while (begin > 0 && begin < count && keys[begin].vertices == keys[begin - 1].vertices)
+            ++begin;
+        for (size_t i = begin; i < end && keys[i].vertices[0] != skipped;) {
+            size_t j = i + 1;
+            for (; j < count && keys[j].vertices == keys[i].vertices; ++j)
+                defects[keys[j].face] = static_cast<uint8_t>(FaceDefect::Duplicate);
+            i = j;
+        }
+    });
+    keys = {};
+
+    std::vector<std::array<size_t, static_cast<size_t>(FaceDefect::Count)>> counts(chunks);
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        counts[chunk].fill(0);
+        for (size_t i = begin; i < end; ++i)
+            ++counts[chunk][defects[i]];
+    });
+    MeshRepairReport report;
+    for (const auto& chunkCounts : counts) {
+        report.invalidFaces += chunkCounts[static_cast<size_t>(FaceDefect::Invalid)];
+        report.degenerateFaces += chunkCounts[static_cast<size_t>(FaceDefect::Degenerate)];
+        report.zeroAreaFaces += chunkCounts[static_cast<size_t>(FaceDefect::ZeroArea)];
+        report.duplicateFaces += chunkCounts[static_cast<size_t>(FaceDefect::Duplicate)];
+    }
+
+    // vertices which lose faces get new normals, the loaded normals of all others are kept
+    const bool hasNormals = normals.size() == vertexCount;
+    std::vector<uint8_t> lostFaces(hasNormals ? vertexCount : 0, 0);
+    if (hasNormals && report.removedFaces()) {
+        for (size_t i = 0; i < count; ++i) {
+            const TriangleIndices& t = faces[i];
+            const FaceDefect defect = static_cast<FaceDefect>(defects[i]);
+            if (defect != FaceDefect::Keep && defect != FaceDefect::Invalid)
+                lostFaces[t.v1] = lostFaces[t.v2] = lostFaces[t.v3] = 1;
+        }
+    }
+
+    // the defect codes become the keep flags expected by removeFaces
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            defects[i] = defects[i] == static_cast<uint8_t>(FaceDefect::Keep);
+    });
+    removeFaces(defects);
+    defects = {};
+
+    // the flags of the vertices which stay, in the order removeUnreferencedVertices() keeps them
+    std::vector<uint8_t> renewNormals;
+    if (hasNormals) {
+        std::vector<uint8_t> referenced(vertexCount, 0);
+        for (const TriangleIndices& t : faces)
+            referenced[t.v1] = referenced[t.v2] = referenced[t.v3] = 1;
+        for (size_t v = 0; v < vertexCount; ++v)
+            if (referenced[v])
+                renewNormals.push_back(lostFaces[v]);
+    }
+
+    report.unreferencedVertices = removeUnreferencedVertices();
+    updateFaceAreas();
+    updateBounds();
+
+    // the removed faces may have left stale normals on the vertices they shared with the rest, and
+    // loaded normals may be NaN; all other vertices keep their normals from the file
+    if (!hasNormals) {
+        updateNormals();
+    }
+    else {
+        bool renew = false;
+        for (size_t v = 0; v < normals.size(); ++v) {
+            const Vertex& n = normals[v];
+            renewNormals[v] |= !std::isfinite(n.x) || !std::isfinite(n.y) || !std::isfinite(n.z);
+            renew |= renewNormals[v] != 0;
+        }
+        if (renew) {
+            const NormalList loaded = normals;
+            updateNormals();
+            parallelFor(normals.size(), [&](size_t begin, size_t end) -> void {
+                for (size_t v = begin; v < end; ++v)
+                    if (!renewNormals[v])
+                        normals[v] = loaded[v];
+            });
+        }
+    }
+
+    std::cout << "Repaired mesh: removed " << report.removedFaces() << " faces and " << report.unreferencedVertices
+              << " vertices, " << vertices.size() << " vertices and " << faces.size() << " faces remain." << std::endl;
+    return report;
+}
+
+std::ostream& operator<<(std::ostream& os, const MeshRepairReport& report)
+{
+    os << "  invalid faces          " << report.invalidFaces << '\n'
+       << "  degenerate faces       " << report.degenerateFaces << '\n'
+       << "  zero area faces        " << report.zeroAreaFaces << '\n'
+       << "  duplicate faces        " << report.duplicateFaces << '\n'
+       << "  unreferenced vertices  " << report.unreferencedVertices << '\n';
+    return os;
+}
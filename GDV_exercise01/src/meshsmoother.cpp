@@ -0,0 +1,202 @@
+#include "meshsmoother.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// one directed vertex pair of a face, edges shared by n faces appear n times
+struct AdjacencyEntry {
+    uint64_t pair;
+    float weight;
+
+    uint32_t row() const { return static_cast<uint32_t>(pair >> 32); }
+    uint32_t column() const { return static_cast<uint32_t>(pair); }
+};
+
+/// cotangent of the angle between u and v, 0 for degenerate angles
+float cotangent(const Vertex& u, const Vertex& v)
+{
+    const float sine = cross(u, v).norm();
+    return sine > 0.0f ? dot(u, v) / sine : 0.0f;
+}
+
+} // namespace
+
+void MeshSmoother::build(const Mesh& mesh, SmoothingWeights weighting, bool lockBoundary)
+{
+    const VertexList& vertices = mesh.getVertices();
+    const FaceList& faces = mesh.getFaces();
+    const size_t vertexCount = vertices.size();
+    if (6 * faces.size() >= UINT32_MAX)
+        throw std::runtime_error("the mesh has too many faces for 32 bit adjacency indices");
+
+    // both directions of all face edges, sorted by (row, column) so each row is one run
+    CountedVector<AdjacencyEntry, MemoryCategory::Temporary> entries(6 * faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t f = begin; f < end; ++f) {
+            const uint32_t corners[3] = {faces[f].v1, faces[f].v2, faces[f].v3};
+            for (uint32_t k = 0; k < 3; ++k) {
+                const uint32_t a = corners[k], b = corners[(k + 1) % 3], c = corners[(k + 2) % 3];
+                float weight = 1.0f;
+                if (weighting == SmoothingWeights::Cotangent)
+                    weight = 0.5f * cotangent(vertices[a] - vertices[c], vertices[b] - vertices[c]);
+                // degenerate edges get a self-loop with weight 0 which is dropped below
+                if (a == b)
+                    weight = 0.0f;
+                entries[6 * f + 2 * k] = {(uint64_t{a} << 32) | b, weight};
+                entries[6 * f + 2 * k + 1] = {(uint64_t{b} << 32) | a, weight};
+            }
+        }
+    });
+    parallelSort(entries.begin(), entries.end(), [](const AdjacencyEntry& a, const AdjacencyEntry& b) -> bool {
+        return a.pair < b.pair;
+    });
+
+    // every chunk handles the rows starting inside of it, first counting the distinct columns
+    std::vector<uint8_t> locked(vertexCount, 0);
+    rowStarts.assign(vertexCount + 1, 0);
+    const size_t count = entries.size();
+    const size_t chunks = chunkCount(count, size_t{1} << 16);
+    auto forEachRun = [&](size_t begin, size_t end, auto&& f) -> void {
+        while (begin > 0 && begin < count && entries[begin].row() == entries[begin - 1].row())
+            ++begin;
+        while (end < count && end > 0 && entries[end].row() == entries[end - 1].row())
+            ++end;
+        for (size_t i = begin; i < end;) {
+            size_t j = i + 1;
+            float weight = entries[i].weight;
+            while (j < count && entries[j].pair == entries[i].pair)
+                weight += entries[j++].weight;
+            f(entries[i].row(), entries[i].column(), j - i, weight);
+            i = j;
+        }
+    };
+    parallelForChunks(count, chunks, [&](size_t, size_t begin, size_t end) -> void {
+        forEachRun(begin, end, [&](uint32_t row, uint32_t column, size_t faceCount, float) -> void {
+            if (row == column)
+                return;
+            // boundary edges have one face, non-manifold edges more than two
+            if (faceCount != 2 && lockBoundary)
+                locked[row] = 1;
+            ++rowStarts[row + 1];
+        });
+    });
+
+    lockedVertices = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (locked[v]) {
+            rowStarts[v + 1] = 0;
+            ++lockedVertices;
+        }
+        rowStarts[v + 1] += rowStarts[v];
+    }
+
+    columns.resize(rowStarts[vertexCount]);
+    weights.resize(rowStarts[vertexCount]);
+    parallelForChunks(count, chunks, [&](size_t, size_t begin, size_t end) -> void {
+        forEachRun(begin, end, [&](uint32_t row, uint32_t column, size_t, float weight) -> void {
+            if (row == column || locked[row])
+                return;
+            // the entries of a row arrive in order, the row start is advanced while filling
+            const uint32_t i = rowStarts[row]++;
+            columns[i] = column;
+            weights[i] = std::max(weight, 0.0f);
+        });
+    });
+    // undo the advancing, rowStarts[v] now holds the end of row v, which is the start of row v + 1
+    for (size_t v = vertexCount; v > 0; --v)
+        rowStarts[v] = rowStarts[v - 1];
+    rowStarts[0] = 0;
+
+    // normalize the rows, rows whose cotangent weights all vanished fall back to uniform weights
+    parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+        for (size_t v = begin; v < end; ++v) {
+            const uint32_t rowBegin = rowStarts[v], rowEnd = rowStarts[v + 1];
+            float sum = 0.0f;
+            for (uint32_t i = rowBegin; i < rowEnd; ++i)
+                sum += weights[i];
+            if (sum > 0.0f) {
+                for (uint32_t i = rowBegin; i < rowEnd; ++i)
+                    weights[i] /= sum;
+            }
+            else {
+                std::fill(weights.begin() + rowBegin, weights.begin() + rowEnd, 1.0f / static_cast<float>(rowEnd - rowBegin));
+            }
+        }
+    });
+}
+
+void MeshSmoother::laplacian(Mesh& mesh, unsigned iterations, float lambda) const
+{
+    smooth(mesh, iterations, {lambda});
+}
+
+void MeshSmoother::taubin(Mesh& mesh, unsigned iterations, float lambda, float mu) const
+{
+    smooth(mesh, iterations, {lambda, mu});
+}
+
+void MeshSmoother::smooth(Mesh& mesh, unsigned iterations, std::initializer_list<float> steps) const
+{
+    VertexList& vertices = mesh.getVertices();
+    const size_t vertexCount = vertices.size();
+    if (vertexCount != numVertices())
+        throw std::runtime_error("the mesh does not match the smoother: " + std::to_string(vertexCount)
+                                 + " vertices instead of " + std::to_string(numVertices()));
+
+    // one array per coordinate, the rows are read with gathers and written in sequence
+    using CoordinateList = CountedVector<float, MemoryCategory::Temporary>;
+    CoordinateList source[3] = {CoordinateList(vertexCount), CoordinateList(vertexCount), CoordinateList(vertexCount)};
+    CoordinateList target[3] = {CoordinateList(vertexCount), CoordinateList(vertexCount), CoordinateList(vertexCount)};
+    parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+        for (size_t v = begin; v < end; ++v) {
+            source[0][v] = vertices[v].x;
+            source[1][v] = vertices[v].y;
+            source[2][v] = vertices[v].z;
+        }
+    });
+
+    for (unsigned iteration = 0; iteration < iterations; ++iteration) {
+        for (const float step : steps) {
+            parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+                const float* x = source[0].data();
+                const float* y = source[1].data();
+                const float* z = source[2].data();
+                for (size_t v = begin; v < end; ++v) {
+                    const uint32_t rowBegin = rowStarts[v], rowEnd = rowStarts[v + 1];
+                    float averageX = 0.0f, averageY = 0.0f, averageZ = 0.0f;
+                    for (uint32_t i = rowBegin; i < rowEnd; ++i) {
+                        const uint32_t column = columns[i];
+                        const float weight = weights[i];
+                        averageX += weight * x[column];
+                        averageY += weight * y[column];
+                        averageZ += weight * z[column];
+                    }
+                    // locked rows are empty and keep their position
+                    const float scale = rowBegin == rowEnd ? 0.0f : step;
+                    target[0][v] = x[v] + scale * (averageX - x[v]);
+                    target[1][v] = y[v] + scale * (averageY - y[v]);
+                    target[2][v] = z[v] + scale * (averageZ - z[v]);
+                }
+            }, 1024);
+            for (int axis = 0; axis < 3; ++axis)
+                std::swap(source[axis], target[axis]);
+        }
+    }
+
+    parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+        for (size_t v = begin; v < end; ++v)
+            vertices[v] = {source[0][v], source[1][v], source[2][v]};
+    });
+
+    mesh.updateBounds();
+    mesh.updateFaceAreas();
+    mesh.updateNormals();
+    std::cout << "Smoothed mesh: " << iterations << " iterations of " << steps.size() << " steps over "
+              << vertexCount << " vertices, " << lockedVertices << " locked." << std::endl;
+}
@@ -0,0 +1,191 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <iostream>
+
+#include "parallel.h"
+
+namespace {
+
+using Cell = std::array<int64_t, 3>;
+
+uint64_t hashCell(const Cell& c)
+{
+    return (static_cast<uint64_t>(c[0]) * 0x9E3779B97F4A7C15ull)
+         ^ (static_cast<uint64_t>(c[1]) * 0xC2B2AE3D27D4EB4Full)
+         ^ (static_cast<uint64_t>(c[2]) * 0x165667B19E3779F9ull);
+}
+
+/// the cell of a coordinate in cell units, clamped so the conversion stays defined when epsilon is tiny
+/// compared to the coordinates, far off or NaN positions share the outermost cells and are still compared exactly
+int64_t cellIndex(float x)
+{
+    constexpr float limit = 0x1p62f;
+    const float cell = std::floor(x);
+    if (cell >= -limit && cell <= limit)
+        return static_cast<int64_t>(cell);
+    return cell > limit ? int64_t{1} << 62 : -(int64_t{1} << 62);
+}
+
+struct CellEntry {
+    uint64_t key;
+    uint32_t vertex;
+
+    bool operator<(const CellEntry& other) const
+    {
+        return key < other.key || (key == other.key && vertex < other.vertex);
+    }
+};
+
+/// open addressing table from cell hash to the range of its entries in the sorted entry list
+class CellTable {
+public:
+    struct Slot {
+        uint64_t key;
+        uint32_t begin, end;
+    };
+
+    explicit CellTable(const CountedVector<CellEntry, MemoryCategory::Temporary>& entries)
+    {
+        slots.assign(std::bit_ceil(entries.size() * 2), Slot{0, 0, 0});
+        mask = slots.size() - 1;
+        for (size_t i = 0; i < entries.size();) {
+            size_t j = i + 1;
+            while (j < entries.size() && entries[j].key == entries[i].key)
+                ++j;
+            size_t slot = entries[i].key & mask;
+            while (slots[slot].end != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = {entries[i].key, static_cast<uint32_t>(i), static_cast<uint32_t>(j)};
+            i = j;
+        }
+    }
+
+    /// the range of entries with the given key, empty if there are none
+    std::pair<uint32_t, uint32_t> find(uint64_t key) const
+    {
+        for (size_t slot = key & mask; slots[slot].end != 0; slot = (slot + 1) & mask)
+            if (slots[slot].key == key)
+                return {slots[slot].begin, slots[slot].end};
+        return {0, 0};
+    }
+
+private:
+    CountedVector<Slot, MemoryCategory::Temporary> slots;
+    size_t mask;
+};
+
+} // namespace
+
+size_t Mesh::weldVertices(float epsilon)
+{
+    const size_t count = vertices.size();
+    if (count < 2)
+        return 0;
+
+    updateBounds();
+
+    // epsilon 0 hashes the exact bit patterns (with -0 folded into 0) instead of grid cells,
+    // otherwise the cells are 2*epsilon wide, so only the 8 cells around the nearest corner
+    // of the own cell can contain vertices within epsilon
+    const bool exact = !(epsilon > 0.0f);
+    const Point3D origin = aabb.min;
+    const float invCellSize = exact ? 0.0f : 0.5f / epsilon;
+    auto cellPosition = [&](const Vertex& v) -> Point3D { return (v - origin) * invCellSize; };
+    auto cellOf = [&](const Vertex& v) -> Cell {
+        if (exact)
+            return {std::bit_cast<int32_t>(v.x + 0.0f), std::bit_cast<int32_t>(v.y + 0.0f),
+                    std::bit_cast<int32_t>(v.z + 0.0f)};
+        const Point3D p = cellPosition(v);
+        return {cellIndex(p.x), cellIndex(p.y), cellIndex(p.z)};
+    };
+
+    // spatial hash: all vertices sorted by the hash of their cell, and a table to find each cell
+    CountedVector<CellEntry, MemoryCategory::Temporary> entries(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            entries[i] = {hashCell(cellOf(vertices[i])), static_cast<uint32_t>(i)};
+    });
+    parallelSort(entries.begin(), entries.end());
+    const CellTable table{entries};
+
+    // each vertex points to the lowest index vertex within epsilon in the neighboring cells
+    const float epsilon2 = epsilon * epsilon;
+    CountedVector<uint32_t, MemoryCategory::Temporary> representative(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const Vertex& v = vertices[i];
+            const Cell cell = cellOf(v);
+
+            Cell step{0, 0, 0};
+            if (!exact) {
+                const Point3D p = cellPosition(v);
+                auto direction = [](float x, int64_t c) -> int64_t { return x - static_cast<float>(c) < 0.5f ? -1 : 1; };
+                step = {direction(p.x, cell[0]), direction(p.y, cell[1]), direction(p.z, cell[2])};
+            }
+            const int neighbors = exact ? 1 : 8;
+
+            uint32_t best = static_cast<uint32_t>(i);
+            for (int n = 0; n < neighbors; ++n) {
+                const Cell neighbor{cell[0] + (n & 1 ? step[0] : 0), cell[1] + (n & 2 ? step[1] : 0),
+                                    cell[2] + (n & 4 ? step[2] : 0)};
+                const auto [first, last] = table.find(hashCell(neighbor));
+                for (uint32_t e = first; e < last && entries[e].vertex < best; ++e) {
+                    const Vertex& other = vertices[entries[e].vertex];
+                    const Vertex d = other - v;
+                    if (exact ? other == v : dot(d, d) <= epsilon2)
+                        best = entries[e].vertex;
+                }
+            }
+            representative[i] = best;
+        }
+    });
+    entries = {};
+
+    // follow chains, representative[i] <= i so a single forward pass suffices
+    for (size_t i = 0; i < count; ++i)
+        representative[i] = representative[representative[i]];
+
+    // average the attributes of merged vertices, normals are re-normalized
+    CountedVector<uint32_t, MemoryCategory::Temporary> merged(count, 1);
+    for (size_t i = 0; i < count; ++i)
+        if (representative[i] != i)
+            ++merged[representative[i]];
+    auto average = [&](auto& attribute, auto&& finish) -> void {
+        if (attribute.size() != count)
+            return;
+        for (size_t i = 0; i < count; ++i)
+            if (representative[i] != i)
+                attribute[representative[i]] += attribute[i];
+        parallelFor(count, [&](size_t begin, size_t end) -> void {
+            for (size_t i = begin; i < end; ++i)
+                if (representative[i] == i && merged[i] > 1)
+                    attribute[i] = finish(attribute[i], static_cast<float>(merged[i]));
+        });
+    };
+    average(normals, [](const Vertex& sum, float) -> Vertex { return normalize(sum); });
+    average(texCoords, [](const TextureCoordinate& sum, float n) -> TextureCoordinate { return sum * (1.0f / n); });
+    average(ambientOcclusion, [](float sum, float n) -> float { return sum / n; });
+
+    std::vector<uint8_t> keep(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            TriangleIndices& t = faces[i];
+            t = {representative[t.v1], representative[t.v2], representative[t.v3]};
+            keep[i] = t.v1 != t.v2 && t.v2 != t.v3 && t.v3 != t.v1;
+        }
+    });
+    removeFaces(keep);
+
+    const size_t removed = removeUnreferencedVertices();
+    updateBounds();
+    updateFaceAreas();
+
+    std::cout << "Welded vertices closer than " << epsilon << ": removed " << removed
+              << " vertices, " << vertices.size() << " vertices and " << faces.size()
+              << " faces remain." << std::endl;
+    return removed;
+}
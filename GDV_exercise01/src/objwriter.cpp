@@ -0,0 +1,212 @@
+#include "mesh.h"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "parallel.h"
+
+namespace {
+
+/// number of elements (lines) formatted as one block by one thread
+constexpr size_t blockSize = size_t{1} << 16;
+
+/// append-only character buffer formatting numbers with std::to_chars
+class LineBuffer {
+public:
+    /// start over, keeping the allocated memory
+    void clear() { size = 0; }
+
+    /// make sure that the given number of bytes can be appended
+    void reserve(size_t bytes)
+    {
+        if (size + bytes > data.size())
+            data.resize(std::max(data.size() * 2, size + bytes));
+    }
+
+    void put(char c) { data[size++] = c; }
+
+    void put(const char* text)
+    {
+        for (; *text; ++text)
+            put(*text);
+    }
+
+    void put(float value)
+    {
+        const auto result = std::to_chars(data.data() + size, data.data() + data.size(), value);
+        size = result.ptr - data.data();
+    }
+
+    void put(uint32_t value)
+    {
+        const auto result = std::to_chars(data.data() + size, data.data() + data.size(), value);
+        size = result.ptr - data.data();
+    }
+
+    void put(const Point3D& p)
+    {
+        put(p.x);
+        put(' ');
+        put(p.y);
+        put(' ');
+        put(p.z);
+    }
+
+    void put(const Point2D& p)
+    {
+        put(p.x);
+        put(' ');
+        put(p.y);
+    }
+
+    const char* begin() const { return data.data(); }
+    size_t length() const { return size; }
+
+private:
+    std::string data;
+    size_t size{0};
+};
+
+enum class Section { Vertices, TextureCoordinates, Normals, Faces };
+
+/// a range of elements of one section, optionally preceded by a header line (e.g. "s 1")
+struct Block {
+    Section section;
+    size_t begin, end;
+    std::string header;
+};
+
+} // namespace
+
+void Mesh::saveOBJ(const std::string& filename, bool parallel) const
+{
+    std::ofstream file{filename, std::ios::binary};
+    if (!file)
+        throw std::runtime_error(std::string{"failed to open the OBJ file "} + filename + " for writing");
+    file.exceptions(std::ios::badbit | std::ios::failbit);
+
+    const bool hasNormals = !vertices.empty() && normals.size() == vertices.size();
+    const bool hasTexCoords = !vertices.empty() && texCoords.size() == vertices.size();
+
+    // split everything into blocks, which are formatted independently and written in order
+    std::vector<Block> blocks;
+    auto addBlocks = [&](Section section, size_t begin, size_t end, std::string header) -> void {
+        for (size_t i = begin; i < end; i += blockSize) {
+            blocks.push_back({section, i, std::min(end, i + blockSize), std::move(header)});
+            header.clear();
+        }
+        if (begin == end && !header.empty())
+            blocks.push_back({section, begin, end, std::move(header)});
+    };
+
+    addBlocks(Section::Vertices, 0, vertices.size(), "# written by the GDV mesh exporter\n");
+    if (hasTexCoords)
+        addBlocks(Section::TextureCoordinates, 0, texCoords.size(), {});
+    if (hasNormals)
+        addBlocks(Section::Normals, 0, normals.size(), {});
+
+    // faces outside of smooth groups are written after "s off", also without any groups since the
+    // loader starts smooth, the groups get consecutive ids
+    size_t position = 0, groupId = 0;
+    for (const auto& [start, end] : smoothGroups) {
+        if (start > position)
+            addBlocks(Section::Faces, position, start, "s off\n");
+        addBlocks(Section::Faces, start, end, "s " + std::to_string(++groupId) + '\n');
+        position = end;
+    }
+    if (faces.size() > position)
+        addBlocks(Section::Faces, position, faces.size(), "s off\n");
+
+    auto format = [&](const Block& block, LineBuffer& out) -> void {
+        // upper bounds of a formatted line: 3 floats or 3 corners of 3 indices
+        constexpr size_t maxLine = 3 * 3 * 12 + 8;
+        out.reserve(block.header.size());
+        out.put(block.header.c_str());
+        for (size_t i = block.begin; i < block.end; ++i) {
+            out.reserve(maxLine);
+            switch (block.section) {
+            case Section::Vertices:
+                out.put("v ");
+                out.put(vertices[i]);
+                break;
+            case Section::TextureCoordinates:
+                out.put("vt ");
+                out.put(texCoords[i]);
+                break;
+            case Section::Normals:
+                out.put("vn ");
+                out.put(normals[i]);
+                break;
+            case Section::Faces:
+                out.put('f');
+                for (uint32_t index : {faces[i].v1, faces[i].v2, faces[i].v3}) {
+                    // OBJ indices start at 1, all attributes share the vertex index
+                    out.put(' ');
+                    out.put(index + 1);
+                    if (hasTexCoords || hasNormals) {
+                        out.put('/');
+                        if (hasTexCoords)
+                            out.put(index + 1);
+                        if (hasNormals) {
+                            out.put('/');
+                            out.put(index + 1);
+                        }
+                    }
+                }
+                break;
+            }
+            out.put('\n');
+        }
+    };
+
+    // format a batch of blocks in parallel while the previous batch is being written
+    const size_t batchSize = parallel ? 2 * numThreads() : 1;
+    std::vector<LineBuffer> formatting(batchSize), writing(batchSize);
+    size_t writingCount = 0;
+    std::thread writer;
+    std::exception_ptr writeError;
+
+    for (size_t first = 0; first < blocks.size(); first += batchSize) {
+        const size_t count = std::min(batchSize, blocks.size() - first);
+        try {
+            parallelForChunks(count, parallel ? count : 1, [&](size_t, size_t begin, size_t end) -> void {
+                for (size_t i = begin; i < end; ++i) {
+                    formatting[i].clear();
+                    format(blocks[first + i], formatting[i]);
+                }
+            });
+        }
+        catch (...) {
+            if (writer.joinable())
+                writer.join();
+            throw;
+        }
+
+        if (writer.joinable())
+            writer.join();
+        if (writeError)
+            std::rethrow_exception(writeError);
+        std::swap(formatting, writing);
+        writingCount = count;
+        writer = std::thread{[&]() -> void {
+            try {
+                for (size_t i = 0; i < writingCount; ++i)
+                    file.write(writing[i].begin(), static_cast<std::streamsize>(writing[i].length()));
+            }
+            catch (...) {
+                writeError = std::current_exception();
+            }
+        }};
+    }
+    if (writer.joinable())
+        writer.join();
+    if (writeError)
+        std::rethrow_exception(writeError);
+    file.close();
+
+    std::cout << "Saved OBJ file: " << filename << " containing " << vertices.size() << " vertices and "
+              << faces.size() << " faces." << std::endl;
+}
@@ -0,0 +1,317 @@
+#include "occlusionculler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "parallel.h"
+
+namespace {
+
+constexpr float farDepth = std::numeric_limits<float>::infinity();
+
+/// a vertex in clip coordinates
+struct ClipVertex {
+    float x, y, z, w;
+};
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller() : worker{&OcclusionCuller::run, this} {}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+void OcclusionCuller::setOccluders(const Mesh& mesh, size_t maxTriangles)
+{
+    wait();
+    const FaceList& faces = mesh.getFaces();
+    const VertexList& vertices = mesh.getVertices();
+
+    // twice the area of each face, the largest ones occlude the most
+    CountedVector<std::pair<float, uint32_t>, MemoryCategory::Temporary> areas(faces.size());
+    parallelFor(faces.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const TriangleIndices& t = faces[i];
+            const Vertex& p1 = vertices[t.v1];
+            areas[i] = {cross(vertices[t.v2] - p1, vertices[t.v3] - p1).norm(), static_cast<uint32_t>(i)};
+        }
+    });
+    const size_t count = std::min(maxTriangles, faces.size());
+    std::nth_element(areas.begin(), areas.begin() + count, areas.end(),
+                     [](const auto& a, const auto& b) -> bool { return a.first > b.first; });
+
+    for (auto* list : {&occluderX, &occluderY, &occluderZ})
+        list->resize(3 * count);
+    for (size_t i = 0; i < count; ++i) {
+        const TriangleIndices& t = faces[areas[i].second];
+        size_t corner = 3 * i;
+        for (uint32_t v : {t.v1, t.v2, t.v3}) {
+            occluderX[corner] = vertices[v].x;
+            occluderY[corner] = vertices[v].y;
+            occluderZ[corner] = vertices[v].z;
+            ++corner;
+        }
+    }
+}
+
+void OcclusionCuller::render(const nanogui::Matrix4f& matrix, uint32_t w, uint32_t h)
+{
+    wait();
+    {
+        std::lock_guard lock{mutex};
+        mvp = matrix;
+        width = std::max(w, 1u);
+        height = std::max(h, 1u);
+        pending = true;
+    }
+    condition.notify_all();
+}
+
+void OcclusionCuller::wait()
+{
+    std::unique_lock lock{mutex};
+    condition.wait(lock, [&]() -> bool { return !pending; });
+    if (error)
+        std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+void OcclusionCuller::run()
+{
+    std::unique_lock lock{mutex};
+    while (true) {
+        condition.wait(lock, [&]() -> bool { return pending || stop; });
+        if (stop)
+            return;
+
+        // the main thread only touches the job between wait() and render()
+        lock.unlock();
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            rasterize();
+            buildPyramid();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        lastRenderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+        pending = false;
+        condition.notify_all();
+    }
+}
+
+void OcclusionCuller::rasterize()
+{
+    levels.resize(std::max<size_t>(levels.size(), 1));
+    levels[0].assign(size_t{width} * height, farDepth);
+
+    // all vertices into clip space and onto the screen at once, nanogui matrices are column-major, m[column][row];
+    // the screen coordinates are only used if the whole triangle is in front of the near plane
+    const size_t count = occluderX.size();
+    for (auto* list : {&clipX, &clipY, &clipZ, &clipW, &screenX, &screenY, &screenZ})
+        list->resize(count);
+    const auto& m = mvp.m;
+    const float halfWidth = 0.5f * static_cast<float>(width), halfHeight = 0.5f * static_cast<float>(height);
+    for (size_t i = 0; i < count; ++i) {
+        const float x = occluderX[i], y = occluderY[i], z = occluderZ[i];
+        clipX[i] = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+        clipY[i] = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+        clipZ[i] = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+        clipW[i] = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+        const float invW = 1.0f / clipW[i];
+        screenX[i] = (clipX[i] * invW + 1.0f) * halfWidth;
+        screenY[i] = (clipY[i] * invW + 1.0f) * halfHeight;
+        screenZ[i] = clipZ[i] * invW;
+    }
+
+    for (size_t t = 0; t < count; t += 3) {
+        // trivially outside if all three vertices are beyond the same clip plane
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis) {
+            const float* c = axis == 0 ? &clipX[t] : axis == 1 ? &clipY[t] : &clipZ[t];
+            outside = (c[0] > clipW[t] && c[1] > clipW[t + 1] && c[2] > clipW[t + 2])
+                   || (c[0] < -clipW[t] && c[1] < -clipW[t + 1] && c[2] < -clipW[t + 2]);
+        }
+        if (outside)
+            continue;
+        if (clipZ[t] >= -clipW[t] && clipZ[t + 1] >= -clipW[t + 1] && clipZ[t + 2] >= -clipW[t + 2]) {
+            rasterizeTriangle(&screenX[t], &screenY[t], &screenZ[t]);
+            continue;
+        }
+
+        // clip the triangle against the near plane z >= -w, which leaves at most a quad
+        ClipVertex polygon[4];
+        int corners = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            const size_t a = t + i, b = t + (i + 1) % 3;
+            const float da = clipZ[a] + clipW[a], db = clipZ[b] + clipW[b];
+            if (da >= 0.0f)
+                polygon[corners++] = {clipX[a], clipY[a], clipZ[a], clipW[a]};
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                const float s = da / (da - db);
+                polygon[corners++] = {clipX[a] + s * (clipX[b] - clipX[a]), clipY[a] + s * (clipY[b] - clipY[a]),
+                                      clipZ[a] + s * (clipZ[b] - clipZ[a]), clipW[a] + s * (clipW[b] - clipW[a])};
+            }
+        }
+        if (corners < 3)
+            continue;
+
+        float x[4], y[4], z[4];
+        for (int i = 0; i < corners; ++i) {
+            const float invW = 1.0f / polygon[i].w;
+            x[i] = (polygon[i].x * invW + 1.0f) * halfWidth;
+            y[i] = (polygon[i].y * invW + 1.0f) * halfHeight;
+            z[i] = polygon[i].z * invW;
+        }
+        rasterizeTriangle(x, y, z);
+        if (corners == 4) {
+            const float qx[3] = {x[0], x[2], x[3]}, qy[3] = {y[0], y[2], y[3]}, qz[3] = {z[0], z[2], z[3]};
+            rasterizeTriangle(qx, qy, qz);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(const float* x, const float* y, const float* z)
+{
+    // the pixel centers in the bounding rectangle, clamped before the conversion since vertices
+    // close to the near plane may be far off screen; most distant triangles cover none
+    const float columns = static_cast<float>(width), rows = static_cast<float>(height);
+    const float minX = std::min({x[0], x[1], x[2]}), maxX = std::max({x[0], x[1], x[2]});
+    const float minY = std::min({y[0], y[1], y[2]}), maxY = std::max({y[0], y[1], y[2]});
+    const int firstColumn = static_cast<int>(std::ceil(std::clamp(minX - 0.5f, 0.0f, columns)));
+    const int lastColumn = static_cast<int>(std::floor(std::clamp(maxX - 0.5f, -1.0f, columns - 1.0f)));
+    const int firstRow = static_cast<int>(std::ceil(std::clamp(minY - 0.5f, 0.0f, rows)));
+    const int lastRow = static_cast<int>(std::floor(std::clamp(maxY - 0.5f, -1.0f, rows - 1.0f)));
+    if (firstColumn > lastColumn || firstRow > lastRow)
+        return;
+
+    // counter-clockwise faces have a positive area, back faces are skipped like the canvas culls them
+    const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 1e-8f))
+        return;
+    const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    const float dzdy = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+
+    // every edge bounds the inside on each row from the left or the right where it crosses the row,
+    // edges parallel to the rows are covered by the row range already
+    float crossX[3], slope[3];
+    bool leftEdge[3], rowEdge[3];
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        const float dy = y[j] - y[i];
+        rowEdge[i] = dy == 0.0f;
+        leftEdge[i] = (area > 0.0f) == (dy < 0.0f);
+        slope[i] = rowEdge[i] ? 0.0f : (x[j] - x[i]) / dy;
+        crossX[i] = x[i] - slope[i] * y[i];
+    }
+
+    float* depth = levels[0].data();
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const float yc = static_cast<float>(row) + 0.5f;
+        float lo = static_cast<float>(firstColumn) + 0.5f, hi = static_cast<float>(lastColumn) + 0.5f;
+        for (int i = 0; i < 3; ++i) {
+            if (rowEdge[i])
+                continue;
+            const float edgeX = crossX[i] + slope[i] * yc;
+            if (leftEdge[i])
+                lo = std::max(lo, edgeX);
+            else
+                hi = std::min(hi, edgeX);
+        }
+        const int first = static_cast<int>(std::ceil(lo - 0.5f));
+        const int last = static_cast<int>(std::floor(hi - 0.5f));
+
+        // depth at the pixel centers of the span, no branches, so this vectorizes
+        float* line = depth + static_cast<size_t>(row) * width;
+        const float base = z[0] + dzdx * (0.5f - x[0]) + dzdy * (yc - y[0]);
+        for (int px = first; px <= last; ++px)
+            line[px] = std::min(line[px], base + dzdx * static_cast<float>(px));
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    levelWidth.assign(1, width);
+    levelHeight.assign(1, height);
+    while (levelWidth.back() > 1 || levelHeight.back() > 1) {
+        levelWidth.push_back((levelWidth.back() + 1) / 2);
+        levelHeight.push_back((levelHeight.back() + 1) / 2);
+    }
+    levels.resize(levelWidth.size());
+
+    for (size_t level = 1; level < levels.size(); ++level) {
+        const uint32_t w = levelWidth[level - 1], h = levelHeight[level - 1];
+        const uint32_t nw = levelWidth[level], nh = levelHeight[level];
+        const float* fine = levels[level - 1].data();
+        levels[level].resize(size_t{nw} * nh);
+        for (uint32_t y = 0; y < nh; ++y) {
+            // odd sizes repeat the last row or column
+            const float* row0 = fine + size_t{2 * y} * w;
+            const float* row1 = fine + size_t{std::min(2 * y + 1, h - 1)} * w;
+            float* out = levels[level].data() + size_t{y} * nw;
+            for (uint32_t x = 0; x < w / 2; ++x)
+                out[x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+            if (w % 2)
+                out[nw - 1] = std::max(row0[w - 1], row1[w - 1]);
+        }
+    }
+}
+
+bool OcclusionCuller::visible(const AABB& box) const
+{
+    if (levels.empty() || !(box.min <= box.max))
+        return true;
+
+    // the screen rectangle and the nearest depth of the corners
+    const auto& m = mvp.m;
+    float minX = farDepth, minY = farDepth, maxX = -farDepth, maxY = -farDepth, minZ = farDepth;
+    for (int corner = 0; corner < 8; ++corner) {
+        const float x = corner & 1 ? box.max.x : box.min.x;
+        const float y = corner & 2 ? box.max.y : box.min.y;
+        const float z = corner & 4 ? box.max.z : box.min.z;
+        const float cx = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+        const float cy = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+        const float cz = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+        const float cw = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+        if (cz < -cw || !(cw > 0.0f))
+            return true;
+        const float invW = 1.0f / cw;
+        minX = std::min(minX, cx * invW);
+        maxX = std::max(maxX, cx * invW);
+        minY = std::min(minY, cy * invW);
+        maxY = std::max(maxY, cy * invW);
+        minZ = std::min(minZ, cz * invW);
+    }
+
+    // all pixels the rectangle touches
+    const float halfWidth = 0.5f * static_cast<float>(width), halfHeight = 0.5f * static_cast<float>(height);
+    const float left = std::floor((minX + 1.0f) * halfWidth), right = std::floor((maxX + 1.0f) * halfWidth);
+    const float bottom = std::floor((minY + 1.0f) * halfHeight), top = std::floor((maxY + 1.0f) * halfHeight);
+    if (right < 0.0f || top < 0.0f || left >= static_cast<float>(width) || bottom >= static_cast<float>(height))
+        return false;
+    const uint32_t x0 = static_cast<uint32_t>(std::max(left, 0.0f));
+    const uint32_t x1 = static_cast<uint32_t>(std::min(right, static_cast<float>(width - 1)));
+    const uint32_t y0 = static_cast<uint32_t>(std::max(bottom, 0.0f));
+    const uint32_t y1 = static_cast<uint32_t>(std::min(top, static_cast<float>(height - 1)));
+
+    size_t level = 0;
+    while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+        ++level;
+    const float* depth = levels[level].data();
+    const uint32_t w = levelWidth[level];
+    float farthest = -farDepth;
+    for (uint32_t y = y0 >> level; y <= y1 >> level; ++y)
+        for (uint32_t x = x0 >> level; x <= x1 >> level; ++x)
+            farthest = std::max(farthest, depth[size_t{y} * w + x]);
+    return !(minZ > farthest);
+}
@@ -0,0 +1,116 @@
+/*
+    src/pathtrace.cpp -- renders a mesh with the CPU path tracer, e.g. on machines without a GPU.
+
+    usage: pathtrace mesh [output.png|output.exr] [options]
+      --width W, --height H   image size, 800 x 600 by default
+      --samples N             samples per pixel, 64 by default
+      --seconds S             stop earlier once S seconds are over
+      --progress N            also write the image after every N samples
+      --angle A               rotation of the mesh about the y axis in radians, like the rotating canvas
+      --bounces N             diffuse bounces after the first hit, 6 by default
+      --auto-scale, --auto-center   scale and center the mesh like the display options of the viewer
+*/
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "imagewriter.h"
+#include "mesh.h"
+#include "pathtracer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        std::vector<std::string> files;
+        PathTracerSettings settings;
+        uint32_t samples = 64, progress = 0;
+        double seconds = 0.0;
+        float angle = 0.0f;
+        bool autoScale = false, autoCenter = false;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("missing value after " + arg);
+                return argv[++i];
+            };
+            if (arg == "--width")
+                settings.width = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--height")
+                settings.height = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--samples")
+                samples = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--seconds")
+                seconds = std::stod(value());
+            else if (arg == "--progress")
+                progress = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--angle")
+                angle = std::stof(value());
+            else if (arg == "--bounces")
+                settings.maxBounces = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--auto-scale")
+                autoScale = true;
+            else if (arg == "--auto-center")
+                autoCenter = true;
+            else if (arg.starts_with("--"))
+                throw std::runtime_error("unknown option " + arg);
+            else
+                files.push_back(arg);
+        }
+        if (files.empty() || files.size() > 2) {
+            std::cerr << "usage: pathtrace mesh [output.png|output.exr] [--width W] [--height H] [--samples N]"
+                         " [--seconds S] [--progress N] [--angle A] [--bounces N] [--auto-scale] [--auto-center]\n";
+            return -1;
+        }
+        const std::string output = files.size() > 1 ? files[1] : "render.png";
+
+        const auto loadStart = Clock::now();
+        Mesh mesh;
+        mesh.load(files[0]);
+        if (mesh.getNormals().size() != mesh.getVertices().size())
+            mesh.updateNormals();
+        const float aspect = static_cast<float>(settings.width) / static_cast<float>(settings.height);
+        PathTracer tracer{mesh, canvasView(mesh.getBounds(), angle, autoScale, autoCenter, aspect), settings};
+        std::cout << "[pathtrace] " << files[0] << ": " << mesh.getFaces().size() << " faces loaded and BVH built in "
+                  << secondsSince(loadStart) << " s\n";
+
+        // samples are added pass by pass, so the image can be written at any time
+        const auto start = Clock::now();
+        while (tracer.numPasses() < samples && (seconds <= 0.0 || secondsSince(start) < seconds)) {
+            tracer.renderPass();
+            if (progress && tracer.numPasses() % progress == 0 && tracer.numPasses() < samples) {
+                writeImage(output, settings.width, settings.height, tracer.image());
+                std::cout << "[pathtrace] " << tracer.numPasses() << " samples per pixel after " << secondsSince(start)
+                          << " s\n";
+            }
+        }
+        const double renderTime = secondsSince(start);
+        writeImage(output, settings.width, settings.height, tracer.image());
+
+        const double pixelSamples = static_cast<double>(tracer.numPasses()) * settings.width * settings.height;
+        std::cout << "[pathtrace] " << settings.width << " x " << settings.height << ", " << tracer.numPasses()
+                  << " samples per pixel in " << renderTime << " s: " << pixelSamples / renderTime / 1e6
+                  << " M samples/s, " << static_cast<double>(tracer.numRays()) / renderTime / 1e6
+                  << " M rays/s, written to " << output << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Caught a fatal error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
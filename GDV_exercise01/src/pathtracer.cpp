@@ -0,0 +1,211 @@
+#include "pathtracer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// pixels of a primary ray packet
+constexpr uint32_t packetWidth = 4, packetHeight = 2;
+static_assert(packetWidth * packetHeight == RayPacket::size);
+/// bounces before Russian roulette may end a path
+constexpr uint32_t rouletteStart = 3;
+
+/// tiles waiting to be rendered by one thread, other threads take them from the back
+struct TileQueue {
+    std::mutex mutex;
+    std::deque<uint32_t> tiles;
+
+    bool pop(uint32_t& tile, bool back)
+    {
+        std::lock_guard lock{mutex};
+        if (tiles.empty())
+            return false;
+        tile = back ? tiles.back() : tiles.front();
+        if (back)
+            tiles.pop_back();
+        else
+            tiles.pop_front();
+        return true;
+    }
+};
+
+} // namespace
+
+PathTracer::PathTracer(const Mesh& mesh, const ViewSetup& view, const PathTracerSettings& settings)
+    : mesh{mesh}, bvh{mesh}, settings{settings}, inverseMvp{invert(view.mvp())}
+{
+    if (!settings.width || !settings.height || !settings.tileSize)
+        throw std::runtime_error("the image and its tiles need at least one pixel");
+
+    // directions only see the rotation and scale of the model matrix
+    const nanogui::Matrix4f inverseModel = invert(view.model);
+    const auto& m = inverseModel.m;
+    const Point3D& d = settings.sunDirection;
+    sun = normalize({m[0][0] * d.x + m[1][0] * d.y + m[2][0] * d.z, m[0][1] * d.x + m[1][1] * d.y + m[2][1] * d.z,
+                     m[0][2] * d.x + m[1][2] * d.y + m[2][2] * d.z});
+    epsilon = 1e-4f * std::max(mesh.getBounds().extents().maxComponent(), 1e-20f);
+
+    const FaceList& faces = mesh.getFaces();
+    smooth.assign(faces.size(), 0);
+    if (mesh.getNormals().size() == mesh.getVertices().size())
+        for (const auto& [start, end] : mesh.getSmoothGroups())
+            std::fill(smooth.begin() + std::min(start, faces.size()), smooth.begin() + std::min(end, faces.size()), 1);
+
+    accumulated.assign(size_t{settings.width} * settings.height * 3, 0.0f);
+}
+
+Ray PathTracer::cameraRay(float x, float y) const
+{
+    // unproject the point on the near and far plane like picking in the canvas
+    const float ndcX = 2.0f * x / static_cast<float>(settings.width) - 1.0f;
+    const float ndcY = 1.0f - 2.0f * y / static_cast<float>(settings.height);
+    const Point3D nearPoint = transformPoint(inverseMvp, ndcX, ndcY, -1.0f);
+    const Point3D farPoint = transformPoint(inverseMvp, ndcX, ndcY, 1.0f);
+    return Ray{nearPoint, normalize(farPoint - nearPoint)};
+}
+
+Point3D PathTracer::tracePath(Ray ray, RayHit hit, PCG32& random, uint64_t& rayCount) const
+{
+    const FaceList& faces = mesh.getFaces();
+    const VertexList& vertices = mesh.getVertices();
+    const NormalList& normals = mesh.getNormals();
+    constexpr float invPi = std::numbers::inv_pi_v<float>;
+
+    Point3D radiance{0.0f}, throughput{1.0f};
+    for (uint32_t bounce = 0;; ++bounce) {
+        if (!hit.found()) {
+            radiance += throughput * settings.environment;
+            break;
+        }
+
+        // both normals face the incoming ray, the faces have no inside
+        const TriangleIndices& t = faces[hit.face];
+        Point3D geometric = normalize(cross(vertices[t.v2] - vertices[t.v1], vertices[t.v3] - vertices[t.v1]));
+        if (dot(geometric, ray.direction) > 0.0f)
+            geometric = -geometric;
+        Point3D normal = geometric;
+        if (smooth[hit.face]) {
+            const Point3D interpolated = normals[t.v1] * (1.0f - hit.u - hit.v) + normals[t.v2] * hit.u + normals[t.v3] * hit.v;
+            if (interpolated.norm() > 0.0f)
+                normal = normalize(dot(interpolated, geometric) < 0.0f ? -interpolated : interpolated);
+        }
+        const Point3D origin = ray.at(hit.t) + geometric * epsilon;
+
+        // direct light of the sun
+        const float cosSun = dot(normal, sun);
+        if (cosSun > 0.0f && dot(geometric, sun) > 0.0f) {
+            ++rayCount;
+            if (!bvh.occluded(Ray{origin, sun}))
+                radiance += throughput * settings.albedo * settings.sunRadiance * (cosSun * invPi);
+        }
+        if (bounce == settings.maxBounces)
+            break;
+
+        // the cosine of the sampled direction cancels with its density, only the albedo remains
+        throughput *= settings.albedo;
+        if (bounce >= rouletteStart) {
+            const float survival = std::min(throughput.maxComponent(), 0.95f);
+            if (random.nextFloat() >= survival)
+                break;
+            throughput = throughput / survival;
+        }
+        const Point3D direction = cosineDirection(normal, random.nextFloat(), random.nextFloat());
+        if (dot(direction, geometric) <= 0.0f)
+            break;
+        ray = Ray{origin, direction};
+        hit = {};
+        ++rayCount;
+        bvh.intersect(ray, hit);
+    }
+    return radiance;
+}
+
+uint64_t PathTracer::renderTile(uint32_t tile)
+{
+    const uint32_t tilesX = (settings.width + settings.tileSize - 1) / settings.tileSize;
+    const uint32_t x0 = tile % tilesX * settings.tileSize, y0 = tile / tilesX * settings.tileSize;
+    const uint32_t x1 = std::min(x0 + settings.tileSize, settings.width);
+    const uint32_t y1 = std::min(y0 + settings.tileSize, settings.height);
+
+    uint64_t rayCount = 0;
+    RayPacket packet;
+    std::array<PCG32, RayPacket::size> randoms;
+    std::array<Ray, RayPacket::size> cameraRays;
+    for (uint32_t py = y0; py < y1; py += packetHeight) {
+        for (uint32_t px = x0; px < x1; px += packetWidth) {
+            packet.clear();
+            for (uint32_t i = 0; i < RayPacket::size; ++i) {
+                const uint32_t x = px + i % packetWidth, y = py + i / packetWidth;
+                if (x >= x1 || y >= y1)
+                    continue;
+                const uint64_t pixel = uint64_t{y} * settings.width + x;
+                randoms[i] = PCG32{mix(pixel * 0x9E3779B97F4A7C15ull ^ mix(passes))};
+                const float jitterX = randoms[i].nextFloat(), jitterY = randoms[i].nextFloat();
+                cameraRays[i] = cameraRay(static_cast<float>(x) + jitterX, static_cast<float>(y) + jitterY);
+                packet.set(i, cameraRays[i]);
+                ++rayCount;
+            }
+            bvh.intersect(packet);
+
+            for (uint32_t i = 0; i < RayPacket::size; ++i) {
+                const uint32_t x = px + i % packetWidth, y = py + i / packetWidth;
+                if (x >= x1 || y >= y1)
+                    continue;
+                const Point3D sample = tracePath(cameraRays[i], packet.hit(i), randoms[i], rayCount);
+                float* pixel = &accumulated[(size_t{y} * settings.width + x) * 3];
+                pixel[0] += sample.x;
+                pixel[1] += sample.y;
+                pixel[2] += sample.z;
+            }
+        }
+    }
+    return rayCount;
+}
+
+void PathTracer::renderPass()
+{
+    // each thread starts with a run of neighboring tiles
+    const uint32_t tilesX = (settings.width + settings.tileSize - 1) / settings.tileSize;
+    const uint32_t tilesY = (settings.height + settings.tileSize - 1) / settings.tileSize;
+    const uint32_t tiles = tilesX * tilesY;
+    const size_t workers = std::min<size_t>(numThreads(), tiles);
+    std::vector<TileQueue> queues(workers);
+    for (size_t w = 0; w < workers; ++w)
+        for (uint32_t tile = static_cast<uint32_t>(tiles * w / workers); tile < tiles * (w + 1) / workers; ++tile)
+            queues[w].tiles.push_back(tile);
+
+    std::atomic<uint64_t> passRays{0};
+    parallelForChunks(workers, workers, [&](size_t worker, size_t, size_t) -> void {
+        uint64_t rayCount = 0;
+        uint32_t tile;
+        while (true) {
+            bool found = queues[worker].pop(tile, false);
+            for (size_t other = 1; !found && other < workers; ++other)
+                found = queues[(worker + other) % workers].pop(tile, true);
+            if (!found)
+                break;
+            rayCount += renderTile(tile);
+        }
+        passRays += rayCount;
+    });
+    rays += passRays;
+    ++passes;
+}
+
+std::vector<float> PathTracer::image() const
+{
+    std::vector<float> result(accumulated.size());
+    const float scale = passes ? 1.0f / static_cast<float>(passes) : 0.0f;
+    for (size_t i = 0; i < result.size(); ++i)
+        result[i] = accumulated[i] * scale;
+    return result;
+}
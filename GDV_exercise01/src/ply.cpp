@@ -0,0 +1,426 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+namespace {
+
+enum class PLYType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+size_t typeSize(PLYType type)
+{
+    switch (type) {
+    case PLYType::Int8:
+    case PLYType::UInt8: return 1;
+    case PLYType::Int16:
+    case PLYType::UInt16: return 2;
+    case PLYType::Int32:
+    case PLYType::UInt32:
+    case PLYType::Float32: return 4;
+    case PLYType::Float64: return 8;
+    }
+    return 0;
+}
+
+std::optional<PLYType> parseType(const std::string& name)
+{
+    if (name == "char" || name == "int8") return PLYType::Int8;
+    if (name == "uchar" || name == "uint8") return PLYType::UInt8;
+    if (name == "short" || name == "int16") return PLYType::Int16;
+    if (name == "ushort" || name == "uint16") return PLYType::UInt16;
+    if (name == "int" || name == "int32") return PLYType::Int32;
+    if (name == "uint" || name == "uint32") return PLYType::UInt32;
+    if (name == "float" || name == "float32") return PLYType::Float32;
+    if (name == "double" || name == "float64") return PLYType::Float64;
+    return std::nullopt;
+}
+
+/// read a value of the given file type and convert it to T
+template <typename T>
+T readAs(const uint8_t* p, PLYType type, bool swap)
+{
+    switch (type) {
+    case PLYType::Int8: return static_cast<T>(readValue<int8_t>(p, swap));
+    case PLYType::UInt8: return static_cast<T>(readValue<uint8_t>(p, swap));
+    case PLYType::Int16: return static_cast<T>(readValue<int16_t>(p, swap));
+    case PLYType::UInt16: return static_cast<T>(readValue<uint16_t>(p, swap));
+    case PLYType::Int32: return static_cast<T>(readValue<int32_t>(p, swap));
+    case PLYType::UInt32: return static_cast<T>(readValue<uint32_t>(p, swap));
+    case PLYType::Float32: return static_cast<T>(readValue<float>(p, swap));
+    case PLYType::Float64: return static_cast<T>(readValue<double>(p, swap));
+    }
+    return T{};
+}
+
+struct PLYProperty {
+    std::string name;
+    PLYType type;
+    bool isList{false};
+    PLYType countType{PLYType::UInt8};
+    /// byte offset inside the element, only valid if the element has no list properties
+    size_t offset{0};
+};
+
+struct PLYElement {
+    std::string name;
+    size_t count{0};
+    std::vector<PLYProperty> properties;
+    /// size of one element in bytes, 0 if it contains lists and has a variable size
+    size_t stride{0};
+
+    const PLYProperty* find(std::initializer_list<const char*> names) const
+    {
+        for (const char* name : names)
+            for (const auto& property : properties)
+                if (property.name == name)
+                    return &property;
+        return nullptr;
+    }
+};
+
+} // namespace
+
+void Mesh::loadPLY(const std::string& filename)
+{
+    clear();
+
+    const MemoryPeakScope memoryScope;
+
+    MappedFile file{filename};
+    auto fail = [&](const std::string& what) -> void {
+        clear();
+        throw std::runtime_error("failed to parse the PLY file " + filename + "\n" + what);
+    };
+
+    // parse the text header
+    const std::string_view text{reinterpret_cast<const char*>(file.data()), file.size()};
+    if (!text.starts_with("ply"))
+        fail("missing magic number");
+    const size_t headerEnd = text.find("end_header");
+    if (headerEnd == text.npos)
+        fail("missing end_header");
+    const size_t bodyStart = text.find('\n', headerEnd);
+    if (bodyStart == text.npos)
+        fail("missing end_header");
+
+    std::istringstream header{std::string{text.substr(0, headerEnd)}};
+    std::vector<PLYElement> elements;
+    bool swap = false;
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream in{line};
+        std::string keyword;
+        in >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            in >> format;
+            if (format == "binary_little_endian")
+                swap = std::endian::native != std::endian::little;
+            else if (format == "binary_big_endian")
+                swap = std::endian::native != std::endian::big;
+            else
+                fail("unsupported format " + format + ", only binary PLY files are supported");
+        }
+        else if (keyword == "element") {
+            PLYElement& element = elements.emplace_back();
+            in >> element.name >> element.count;
+        }
+        else if (keyword == "property") {
+            if (elements.empty())
+                fail("property outside of an element:\n" + line);
+            PLYProperty property;
+            std::string type;
+            in >> type;
+            if (type == "list") {
+                std::string countType, itemType;
+                in >> countType >> itemType;
+                const auto count = parseType(countType), item = parseType(itemType);
+                if (!count || !item)
+                    fail("unknown property type:\n" + line);
+                if (*count == PLYType::Float32 || *count == PLYType::Float64)
+                    fail("list counts must be integers:\n" + line);
+                property.isList = true;
+                property.countType = *count;
+                property.type = *item;
+            }
+            else {
+                const auto parsed = parseType(type);
+                if (!parsed)
+                    fail("unknown property type:\n" + line);
+                property.type = *parsed;
+            }
+            in >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        if (!in)
+            fail("invalid header line:\n" + line);
+    }
+
+    for (auto& element : elements) {
+        size_t offset = 0;
+        bool fixedSize = true;
+        for (auto& property : element.properties) {
+            property.offset = offset;
+            offset += typeSize(property.type);
+            fixedSize &= !property.isList;
+        }
+        element.stride = fixedSize ? offset : 0;
+    }
+
+    // parse the binary body element by element
+    const uint8_t* p = file.data() + bodyStart + 1;
+    // counts come from the file, so count * size is compared without overflowing
+    auto fits = [&](size_t count, size_t size) -> bool {
+        return !size || count <= static_cast<size_t>(file.end() - p) / size;
+    };
+    auto need = [&](size_t count, size_t size) -> void {
+        if (!fits(count, size))
+            fail("unexpected end of file");
+    };
+
+    bool hasNormals = false;
+    for (const auto& element : elements) {
+        if (element.name == "vertex") {
+            if (!element.stride)
+                fail("list properties of vertices are not supported");
+            const PLYProperty* x = element.find({"x"});
+            const PLYProperty* y = element.find({"y"});
+            const PLYProperty* z = element.find({"z"});
+            const PLYProperty* nx = element.find({"nx"});
+            const PLYProperty* ny = element.find({"ny"});
+            const PLYProperty* nz = element.find({"nz"});
+            const PLYProperty* u = element.find({"u", "s", "texture_u", "texture_s"});
+            const PLYProperty* v = element.find({"v", "t", "texture_v", "texture_t"});
+            if (!x || !y || !z)
+                fail("vertices without x, y, or z");
+            hasNormals = nx && ny && nz;
+            const bool hasTexCoords = u && v;
+
+            need(element.count, element.stride);
+            vertices.resize(element.count);
+            if (hasNormals)
+                normals.resize(element.count);
+            if (hasTexCoords)
+                texCoords.resize(element.count);
+
+            const bool packedPositions = !swap && element.stride == sizeof(Vertex) && x->offset == 0
+                                      && y->offset == 4 && z->offset == 8 && x->type == PLYType::Float32
+                                      && y->type == PLYType::Float32 && z->type == PLYType::Float32;
+            const uint8_t* data = p;
+            parallelFor(element.count, [&](size_t begin, size_t end) -> void {
+                if (packedPositions) {
+                    std::memcpy(&vertices[begin], data + begin * element.stride, (end - begin) * sizeof(Vertex));
+                }
+                else {
+                    for (size_t i = begin; i < end; ++i) {
+                        const uint8_t* e = data + i * element.stride;
+                        vertices[i] = {readAs<float>(e + x->offset, x->type, swap),
+                                       readAs<float>(e + y->offset, y->type, swap),
+                                       readAs<float>(e + z->offset, z->type, swap)};
+                    }
+                }
+                for (size_t i = begin; hasNormals && i < end; ++i) {
+                    const uint8_t* e = data + i * element.stride;
+                    normals[i] = {readAs<float>(e + nx->offset, nx->type, swap),
+                                  readAs<float>(e + ny->offset, ny->type, swap),
+                                  readAs<float>(e + nz->offset, nz->type, swap)};
+                }
+                for (size_t i = begin; hasTexCoords && i < end; ++i) {
+                    const uint8_t* e = data + i * element.stride;
+                    texCoords[i] = {readAs<float>(e + u->offset, u->type, swap),
+                                    readAs<float>(e + v->offset, v->type, swap)};
+                }
+            }, size_t{1} << 16);
+            p += element.count * element.stride;
+        }
+        else if (element.name == "face") {
+            const PLYProperty* indices = element.find({"vertex_indices", "vertex_index"});
+            if (!indices || !indices->isList)
+                fail("faces without a vertex_indices list");
+            const size_t indexSize = typeSize(indices->type);
+            const size_t countSize = typeSize(indices->countType);
+
+            // fast path: all faces are triangles and the list is the only property
+            const size_t triangleStride = countSize + 3 * indexSize;
+            bool allTriangles = element.properties.size() == 1
+                             && fits(element.count, triangleStride);
+            if (allTriangles) {
+                std::vector<uint8_t> chunkOk(chunkCount(element.count, size_t{1} << 16), 1);
+                parallelForChunks(element.count, chunkOk.size(), [&](size_t chunk, size_t begin, size_t end) -> void {
+                    for (size_t i = begin; i < end; ++i)
+                        if (readAs<uint32_t>(p + i * triangleStride, indices->countType, swap) != 3)
+                            chunkOk[chunk] = 0;
+                });
+                allTriangles = std::all_of(chunkOk.begin(), chunkOk.end(), [](uint8_t ok) { return ok; });
+            }
+
+            if (allTriangles) {
+                faces.resize(element.count);
+                const bool packedIndices = !swap && indexSize == 4;
+                parallelFor(element.count, [&](size_t begin, size_t end) -> void {
+                    for (size_t i = begin; i < end; ++i) {
+                        const uint8_t* e = p + i * triangleStride + countSize;
+                        if (packedIndices)
+                            std::memcpy(&faces[i], e, sizeof(TriangleIndices));
+                        else
+                            faces[i] = {readAs<uint32_t>(e, indices->type, swap),
+                                        readAs<uint32_t>(e + indexSize, indices->type, swap),
+                                        readAs<uint32_t>(e + 2 * indexSize, indices->type, swap)};
+                    }
+                }, size_t{1} << 16);
+                p += element.count * triangleStride;
+            }
+            else {
+                // polygons are split into fans around their first vertex like in loadOBJ
+                // every face takes at least the count of its index list
+                faces.reserve(std::min(element.count, static_cast<size_t>(file.end() - p) / countSize));
+                for (size_t i = 0; i < element.count; ++i) {
+                    for (const auto& property : element.properties) {
+                        if (!property.isList) {
+                            need(1, typeSize(property.type));
+                            p += typeSize(property.type);
+                            continue;
+                        }
+                        // each list has its own count type
+                        need(1, typeSize(property.countType));
+                        const size_t n = readAs<size_t>(p, property.countType, swap);
+                        p += typeSize(property.countType);
+                        need(n, typeSize(property.type));
+                        if (&property == indices) {
+                            TriangleIndices t;
+                            for (size_t k = 0; k < n; ++k) {
+                                const uint32_t index = readAs<uint32_t>(p + k * indexSize, property.type, swap);
+                                if (k == 0)
+                                    t.v1 = index;
+                                else if (k == 1)
+                                    t.v2 = index;
+                                else {
+                                    t.v3 = index;
+                                    faces.push_back(t);
+                                    t.v2 = t.v3;
+                                }
+                            }
+                        }
+                        p += n * typeSize(property.type);
+                    }
+                }
+            }
+        }
+        else if (element.stride) {
+            need(element.count, element.stride);
+            p += element.count * element.stride;
+        }
+        else {
+            // skip other elements with variable size one by one
+            for (size_t i = 0; i < element.count; ++i) {
+                for (const auto& property : element.properties) {
+                    size_t n = 1;
+                    if (property.isList) {
+                        need(1, typeSize(property.countType));
+                        n = readAs<size_t>(p, property.countType, swap);
+                        p += typeSize(property.countType);
+                    }
+                    need(n, typeSize(property.type));
+                    p += n * typeSize(property.type);
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> chunkOk(chunkCount(faces.size()), 1);
+    parallelForChunks(faces.size(), chunkOk.size(), [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            if (std::max({faces[i].v1, faces[i].v2, faces[i].v3}) >= vertices.size())
+                chunkOk[chunk] = 0;
+    });
+    if (!std::all_of(chunkOk.begin(), chunkOk.end(), [](uint8_t ok) { return ok; }))
+        fail("face with a vertex index out of range");
+
+    // PLY has no smoothing information, scans are shaded smooth
+    if (!faces.empty())
+        smoothGroups.emplace_back(0, faces.size());
+    updateBounds();
+    updateFaceAreas();
+    if (!hasNormals)
+        updateNormals();
+
+    peakLoadTransient = memoryScope.transient(getMemoryUsage().resident());
+
+    std::cout << "Loaded PLY file: " << filename << " containing " << vertices.size() << " vertices, "
+              << (hasNormals ? normals.size() : 0) << " vertex normals, " << texCoords.size()
+              << " texture coordinates, and " << faces.size() << " faces." << std::endl;
+}
+
+void Mesh::savePLY(const std::string& filename) const
+{
+    std::ofstream file{filename, std::ios::binary};
+    if (!file)
+        throw std::runtime_error(std::string{"failed to open the PLY file "} + filename + " for writing");
+    file.exceptions(std::ios::badbit | std::ios::failbit);
+
+    const bool hasNormals = !vertices.empty() && normals.size() == vertices.size();
+    const bool hasTexCoords = !vertices.empty() && texCoords.size() == vertices.size();
+
+    file << "ply\nformat binary_little_endian 1.0\ncomment written by the GDV mesh exporter\n"
+         << "element vertex " << vertices.size() << "\nproperty float x\nproperty float y\nproperty float z\n";
+    if (hasNormals)
+        file << "property float nx\nproperty float ny\nproperty float nz\n";
+    if (hasTexCoords)
+        file << "property float u\nproperty float v\n";
+    file << "element face " << faces.size() << "\nproperty list uchar uint vertex_indices\nend_header\n";
+
+    // convert blocks of elements in parallel into one reused buffer
+    constexpr size_t blockSize = size_t{1} << 20;
+    std::vector<uint8_t> buffer;
+    auto writeBlocks = [&](size_t count, size_t stride, auto&& convert) -> void {
+        for (size_t first = 0; first < count; first += blockSize) {
+            const size_t n = std::min(blockSize, count - first);
+            buffer.resize(n * stride);
+            parallelFor(n, [&](size_t begin, size_t end) -> void {
+                for (size_t i = begin; i < end; ++i)
+                    convert(first + i, buffer.data() + i * stride);
+            }, size_t{1} << 14);
+            file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        }
+    };
+
+    const size_t vertexStride = sizeof(float) * (3 + (hasNormals ? 3 : 0) + (hasTexCoords ? 2 : 0));
+    writeBlocks(vertices.size(), vertexStride, [&](size_t i, uint8_t* out) -> void {
+        for (float value : {vertices[i].x, vertices[i].y, vertices[i].z}) {
+            writeLittleEndian(out, value);
+            out += sizeof(float);
+        }
+        if (hasNormals) {
+            for (float value : {normals[i].x, normals[i].y, normals[i].z}) {
+                writeLittleEndian(out, value);
+                out += sizeof(float);
+            }
+        }
+        if (hasTexCoords) {
+            for (float value : {texCoords[i].x, texCoords[i].y}) {
+                writeLittleEndian(out, value);
+                out += sizeof(float);
+            }
+        }
+    });
+
+    writeBlocks(faces.size(), 1 + sizeof(TriangleIndices), [&](size_t i, uint8_t* out) -> void {
+        *out++ = 3;
+        for (uint32_t index : {faces[i].v1, faces[i].v2, faces[i].v3}) {
+            writeLittleEndian(out, index);
+            out += sizeof(uint32_t);
+        }
+    });
+    file.close();
+
+    std::cout << "Saved PLY file: " << filename << " containing " << vertices.size() << " vertices and "
+              << faces.size() << " faces." << std::endl;
+}
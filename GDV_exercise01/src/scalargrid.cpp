@@ -0,0 +1,41 @@
+#include "scalargrid.h"
+
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+ScalarGrid::ScalarGrid(const std::array<uint32_t, 3>& dimensions, const Point3D& origin, float voxelSize, float value)
+    : size{dimensions}, start{origin}, spacing{voxelSize},
+      values(size_t{dimensions[0]} * dimensions[1] * dimensions[2], value)
+{
+}
+
+void ScalarGrid::loadRaw(const std::string& filename, const std::array<uint32_t, 3>& dimensions, VoxelFormat format,
+                         float voxelSize)
+{
+    const size_t count = size_t{dimensions[0]} * dimensions[1] * dimensions[2];
+    const size_t bytes = format == VoxelFormat::UInt8 ? 1 : format == VoxelFormat::UInt16 ? 2 : 4;
+    const MappedFile file{filename};
+    if (file.size() != count * bytes)
+        throw std::runtime_error(filename + " has " + std::to_string(file.size()) + " bytes instead of "
+                                 + std::to_string(count * bytes) + " for the given dimensions");
+
+    CountedVector<float, MemoryCategory::DistanceFields> loaded(count);
+    const uint8_t* data = file.data();
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            switch (format) {
+            case VoxelFormat::UInt8: loaded[i] = data[i]; break;
+            case VoxelFormat::UInt16: loaded[i] = readLittleEndian<uint16_t>(data + 2 * i); break;
+            case VoxelFormat::Float32: loaded[i] = readLittleEndian<float>(data + 4 * i); break;
+            }
+        }
+    });
+
+    size = dimensions;
+    start = Point3D{0.0f};
+    spacing = voxelSize;
+    values = std::move(loaded);
+}
@@ -0,0 +1,316 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// grid resolution per axis for the Morton codes, equal codes are ordered by the instance position
+constexpr unsigned mortonBits = 10;
+/// entries of the traversal stack, the top level is at most 3 * mortonBits + 32 levels deep
+constexpr size_t stackSize = 128;
+
+struct MortonLeaf {
+    uint64_t code;
+    uint32_t instance;
+};
+
+} // namespace
+
+uint32_t Scene::addMesh(Mesh mesh)
+{
+    if (meshes.size() >= invalid)
+        throw std::runtime_error("too many meshes in the scene");
+    auto entry = std::make_unique<SceneMesh>();
+    entry->mesh = std::move(mesh);
+    entry->mesh.updateBounds();
+    entry->bvh.build(entry->mesh);
+    meshes.push_back(std::move(entry));
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t Scene::addInstance(uint32_t mesh, const Transform& transform)
+{
+    if (mesh >= meshes.size())
+        throw std::runtime_error("instance of a mesh which is not part of the scene");
+    if (instances.size() >= TopNode::leafBit)
+        throw std::runtime_error("too many instances in the scene");
+    instances.push_back({mesh, transform, transform.inverse(), AABB{}});
+    updated = false;
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void Scene::setTransform(uint32_t instance, const Transform& transform)
+{
+    Instance& i = instances.at(instance);
+    i.transform = transform;
+    i.inverse = transform.inverse();
+    updated = false;
+}
+
+void Scene::checkUpdated() const
+{
+    if (!updated)
+        throw std::runtime_error("the scene changed since the last update");
+}
+
+const AABB& Scene::childBounds(uint32_t child) const
+{
+    return child & TopNode::leafBit ? instances[sortedInstances[child & ~TopNode::leafBit]].bounds
+                                    : topNodes[child].bounds;
+}
+
+void Scene::update()
+{
+    const size_t count = instances.size();
+    topNodes.clear();
+    sortedInstances.resize(count);
+    leafParents.resize(count);
+    updated = true;
+    if (!count)
+        return;
+
+    // world bounds and the bounds of their centers for the Morton grid
+    const size_t chunks = chunkCount(count, 1024);
+    std::vector<AABB> chunkCenters(chunks);
+    parallelForChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            Instance& instance = instances[i];
+            instance.bounds = instance.transform.apply(meshes[instance.mesh]->bvh.getBounds());
+            if (instance.bounds.min <= instance.bounds.max)
+                chunkCenters[chunk].extend(instance.bounds.center());
+        }
+    });
+    AABB centers;
+    for (const AABB& c : chunkCenters)
+        centers.extend(c);
+
+    const SpaceFillingCurveGrid grid{centers, SpaceFillingCurve::Morton, mortonBits};
+    CountedVector<MortonLeaf, MemoryCategory::Temporary> leaves(count), scratch(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            leaves[i] = {grid.code(instances[i].bounds.center()), static_cast<uint32_t>(i)};
+    });
+    parallelRadixSort(leaves.data(), scratch.data(), count, [](const MortonLeaf& l) -> uint64_t { return l.code; },
+                      3 * mortonBits);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            sortedInstances[i] = leaves[i].instance;
+    });
+
+    if (count == 1) {
+        topNodes.push_back({instances[0].bounds, TopNode::leafBit, invalid, invalid, 0, 0});
+        leafParents[0] = 0;
+        return;
+    }
+
+    // inner node i covers the range of leaves sharing the longest code prefix with leaf i and splits
+    // it where the prefix gets shorter, equal codes are told apart by their positions
+    const int64_t n = static_cast<int64_t>(count);
+    auto delta = [&](int64_t i, int64_t j) -> int {
+        if (j < 0 || j >= n)
+            return -1;
+        if (leaves[i].code == leaves[j].code)
+            return 64 + std::countl_zero(static_cast<uint64_t>(i ^ j));
+        return std::countl_zero(leaves[i].code ^ leaves[j].code);
+    };
+    topNodes.resize(count - 1);
+    parallelFor(count - 1, [&](size_t begin, size_t end) -> void {
+        for (int64_t i = static_cast<int64_t>(begin); i < static_cast<int64_t>(end); ++i) {
+            const int64_t d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+            const int deltaMin = delta(i, i - d);
+            int64_t lengthBound = 2;
+            while (delta(i, i + lengthBound * d) > deltaMin)
+                lengthBound *= 2;
+            int64_t length = 0;
+            for (int64_t t = lengthBound / 2; t >= 1; t /= 2)
+                if (delta(i, i + (length + t) * d) > deltaMin)
+                    length += t;
+            const int64_t j = i + length * d;
+
+            const int deltaNode = delta(i, j);
+            int64_t split = 0;
+            for (int64_t divisor = 2;; divisor *= 2) {
+                const int64_t t = (length + divisor - 1) / divisor;
+                if (delta(i, i + (split + t) * d) > deltaNode)
+                    split += t;
+                if (t == 1)
+                    break;
+            }
+            const int64_t gamma = i + split * d + std::min<int64_t>(d, 0);
+
+            // the parent of node i is written by another node, so only the own fields are set
+            TopNode& node = topNodes[i];
+            node.first = static_cast<uint32_t>(std::min(i, j));
+            node.last = static_cast<uint32_t>(std::max(i, j));
+            const uint32_t g = static_cast<uint32_t>(gamma);
+            node.left = node.first == g ? TopNode::leafBit | g : g;
+            node.right = node.last == g + 1 ? TopNode::leafBit | (g + 1) : g + 1;
+            for (uint32_t child : {node.left, node.right}) {
+                if (child & TopNode::leafBit)
+                    leafParents[child & ~TopNode::leafBit] = static_cast<uint32_t>(i);
+                else
+                    topNodes[child].parent = static_cast<uint32_t>(i);
+            }
+        }
+    }, 1024);
+
+    // bounds bottom-up, the second child to arrive at a node computes them
+    CountedVector<uint32_t, MemoryCategory::Temporary> arrivals(count - 1, 0);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t leaf = begin; leaf < end; ++leaf) {
+            for (uint32_t n = leafParents[leaf]; n != invalid; n = topNodes[n].parent) {
+                if (std::atomic_ref{arrivals[n]}.fetch_add(1, std::memory_order_acq_rel) == 0)
+                    break;
+                TopNode& node = topNodes[n];
+                node.bounds = childBounds(node.left);
+                node.bounds.extend(childBounds(node.right));
+            }
+        }
+    }, 1024);
+}
+
+bool Scene::intersectInstance(uint32_t instance, Ray& current, SceneHit& hit) const
+{
+    // the transformation is affine, so the ray parameters are the same in both spaces
+    const Instance& i = instances[instance];
+    const Ray local{i.inverse.applyPoint(current.origin), i.inverse.applyVector(current.direction), current.tMin,
+                    current.tMax};
+    RayHit localHit;
+    if (!meshes[i.mesh]->bvh.intersect(local, localHit))
+        return false;
+    current.tMax = localHit.t;
+    static_cast<RayHit&>(hit) = localHit;
+    hit.instance = instance;
+    return true;
+}
+
+bool Scene::intersect(const Ray& ray, SceneHit& hit) const
+{
+    checkUpdated();
+    if (topNodes.empty())
+        return false;
+    const Point3D invDirection{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+    constexpr float miss = std::numeric_limits<float>::infinity();
+
+    Ray current = ray;
+    bool found = false;
+    std::array<std::pair<uint32_t, float>, stackSize> stack;
+    size_t size = 0;
+    const float rootEntry = intersectAABB(topNodes[0].bounds, current, invDirection);
+    if (rootEntry != miss)
+        stack[size++] = {0, rootEntry};
+
+    while (size) {
+        const auto [child, entry] = stack[--size];
+        if (entry > current.tMax)
+            continue;
+        if (child & TopNode::leafBit) {
+            found |= intersectInstance(sortedInstances[child & ~TopNode::leafBit], current, hit);
+            continue;
+        }
+        const TopNode& node = topNodes[child];
+        uint32_t nearChild = node.left, farChild = node.right;
+        float nearEntry = intersectAABB(childBounds(nearChild), current, invDirection);
+        float farEntry = farChild == invalid ? miss : intersectAABB(childBounds(farChild), current, invDirection);
+        if (farEntry < nearEntry) {
+            std::swap(nearEntry, farEntry);
+            std::swap(nearChild, farChild);
+        }
+        if (farEntry != miss)
+            stack[size++] = {farChild, farEntry};
+        if (nearEntry != miss)
+            stack[size++] = {nearChild, nearEntry};
+    }
+    return found;
+}
+
+bool Scene::occluded(const Ray& ray) const
+{
+    checkUpdated();
+    if (topNodes.empty())
+        return false;
+    const Point3D invDirection{1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z};
+
+    std::array<uint32_t, stackSize> stack;
+    size_t size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const uint32_t child = stack[--size];
+        if (child == invalid
+            || intersectAABB(childBounds(child), ray, invDirection) == std::numeric_limits<float>::infinity())
+            continue;
+        if (child & TopNode::leafBit) {
+            const Instance& i = instances[sortedInstances[child & ~TopNode::leafBit]];
+            const Ray local{i.inverse.applyPoint(ray.origin), i.inverse.applyVector(ray.direction), ray.tMin, ray.tMax};
+            if (meshes[i.mesh]->bvh.occluded(local))
+                return true;
+            continue;
+        }
+        stack[size++] = topNodes[child].right;
+        stack[size++] = topNodes[child].left;
+    }
+    return false;
+}
+
+void Scene::intersect(std::span<const Ray> rays, std::span<SceneHit> hits) const
+{
+    if (hits.size() != rays.size())
+        throw std::runtime_error("one hit per ray is needed");
+    checkUpdated();
+    parallelFor(rays.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            hits[i] = SceneHit{};
+            intersect(rays[i], hits[i]);
+        }
+    }, 256);
+}
+
+void Scene::occluded(std::span<const Ray> rays, std::span<uint8_t> occluded) const
+{
+    if (occluded.size() != rays.size())
+        throw std::runtime_error("one result per ray is needed");
+    checkUpdated();
+    parallelFor(rays.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            occluded[i] = this->occluded(rays[i]);
+    }, 256);
+}
+
+std::vector<uint32_t> Scene::cull(const Frustum& frustum) const
+{
+    checkUpdated();
+    std::vector<uint32_t> visible;
+    if (topNodes.empty())
+        return visible;
+
+    std::array<uint32_t, stackSize> stack;
+    size_t size = 0;
+    stack[size++] = 0;
+    while (size) {
+        const uint32_t child = stack[--size];
+        if (child == invalid)
+            continue;
+        const FrustumTest test = frustum.classify(childBounds(child));
+        if (test == FrustumTest::Outside)
+            continue;
+        if (child & TopNode::leafBit) {
+            visible.push_back(sortedInstances[child & ~TopNode::leafBit]);
+            continue;
+        }
+        const TopNode& node = topNodes[child];
+        if (test == FrustumTest::Inside) {
+            // everything below is visible, and the leaves of a subtree are a range of the sorted instances
+            visible.insert(visible.end(), sortedInstances.begin() + node.first, sortedInstances.begin() + node.last + 1);
+            continue;
+        }
+        stack[size++] = node.right;
+        stack[size++] = node.left;
+    }
+    return visible;
+}
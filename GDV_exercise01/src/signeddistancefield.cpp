@@ -0,0 +1,299 @@
+#include "signeddistancefield.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+#include "parallel.h"
+
+namespace {
+
+/// entries of the traversal stack, the BVH keeps its trees below this depth
+constexpr uint32_t stackSize = 128;
+/// nodes farther away than this many times their radius use the dipole approximation
+constexpr float dipoleDistance = 2.0f;
+
+float component(const Point3D& p, int axis) { return axis == 0 ? p.x : axis == 1 ? p.y : p.z; }
+
+/**
+ * @brief the generalized winding number of the faces of a mesh with a BVH over them
+ * 1 inside closed surfaces with outward normals, 0 outside, in between near holes
+ */
+class WindingNumber {
+public:
+    explicit WindingNumber(const TriangleBVH& bvh) : bvh{bvh}
+    {
+        const auto& nodes = bvh.getNodes();
+        const auto& faceOrder = bvh.getFaceOrder();
+        const FaceList& faces = bvh.getMesh()->getFaces();
+        const VertexList& vertices = bvh.getMesh()->getVertices();
+
+        // breadth first, so every node comes after its parent and can be summed up in reverse
+        CountedVector<uint32_t, MemoryCategory::Temporary> order;
+        order.reserve(nodes.size());
+        order.push_back(0);
+        for (size_t i = 0; i < order.size(); ++i) {
+            const TriangleBVH::Node& node = nodes[order[i]];
+            if (!node.isLeaf()) {
+                order.push_back(node.left);
+                order.push_back(node.right);
+            }
+        }
+
+        dipoles.resize(nodes.size());
+        CountedVector<float, MemoryCategory::Temporary> areas(nodes.size(), 0.0f);
+        for (size_t i = order.size(); i-- > 0;) {
+            const uint32_t n = order[i];
+            const TriangleBVH::Node& node = nodes[n];
+            Dipole& dipole = dipoles[n];
+            Point3D weightedCenter{0.0f};
+            if (node.isLeaf()) {
+                for (uint32_t f = node.left; f < node.left + node.count; ++f) {
+                    const TriangleIndices& t = faces[faceOrder[f]];
+                    const Point3D& a = vertices[t.v1];
+                    const Point3D& b = vertices[t.v2];
+                    const Point3D& c = vertices[t.v3];
+                    const Point3D areaNormal = cross(b - a, c - a) * 0.5f;
+                    const float area = areaNormal.norm();
+                    dipole.normal += areaNormal;
+                    weightedCenter += (a + b + c) * (area / 3.0f);
+                    areas[n] += area;
+                }
+            }
+            else {
+                for (uint32_t child : {node.left, node.right}) {
+                    dipole.normal += dipoles[child].normal;
+                    weightedCenter += dipoles[child].center * areas[child];
+                    areas[n] += areas[child];
+                }
+            }
+            dipole.center = areas[n] > 0.0f ? weightedCenter / areas[n] : node.bounds.center();
+            const Point3D farthest = max(abs(dipole.center - node.bounds.min), abs(node.bounds.max - dipole.center));
+            dipole.farSquared = dot(farthest, farthest) * dipoleDistance * dipoleDistance;
+        }
+    }
+
+    float operator()(const Point3D& p) const
+    {
+        const auto& nodes = bvh.getNodes();
+        const auto& faceOrder = bvh.getFaceOrder();
+        const FaceList& faces = bvh.getMesh()->getFaces();
+        const VertexList& vertices = bvh.getMesh()->getVertices();
+
+        // solid angles of the faces seen from p
+        float solidAngle = 0.0f;
+        std::array<uint32_t, stackSize> stack;
+        uint32_t size = 0;
+        stack[size++] = 0;
+        while (size) {
+            const uint32_t n = stack[--size];
+            const Dipole& dipole = dipoles[n];
+            const Point3D r = dipole.center - p;
+            const float distanceSquared = dot(r, r);
+            if (distanceSquared > dipole.farSquared) {
+                solidAngle += dot(r, dipole.normal) / (distanceSquared * std::sqrt(distanceSquared));
+                continue;
+            }
+            const TriangleBVH::Node& node = nodes[n];
+            if (node.isLeaf()) {
+                // exact solid angle of a triangle (Van Oosterom and Strackee 1983)
+                for (uint32_t f = node.left; f < node.left + node.count; ++f) {
+                    const TriangleIndices& t = faces[faceOrder[f]];
+                    const Point3D a = vertices[t.v1] - p, b = vertices[t.v2] - p, c = vertices[t.v3] - p;
+                    const float la = a.norm(), lb = b.norm(), lc = c.norm();
+                    const float numerator = dot(a, cross(b, c));
+                    const float denominator = la * lb * lc + dot(a, b) * lc + dot(b, c) * la + dot(c, a) * lb;
+                    solidAngle += 2.0f * std::atan2(numerator, denominator);
+                }
+                continue;
+            }
+            stack[size++] = node.left;
+            stack[size++] = node.right;
+        }
+        return solidAngle * (0.25f * std::numbers::inv_pi_v<float>);
+    }
+
+private:
+    /// the faces below a node seen from far away, a point with their summed area normals
+    struct Dipole {
+        /// area weighted mean of the face centroids
+        Point3D center{0.0f};
+        /// sum of the normals scaled by the face areas
+        Point3D normal{0.0f};
+        /// squared distance from the center beyond which the approximation is used
+        float farSquared{0.0f};
+    };
+
+    const TriangleBVH& bvh;
+    CountedVector<Dipole, MemoryCategory::Temporary> dipoles;
+};
+
+} // namespace
+
+SignedDistanceField::SignedDistanceField(const Mesh& mesh, const DistanceFieldSettings& settings)
+{
+    const TriangleBVH bvh{mesh};
+    build(mesh, bvh, settings);
+}
+
+void SignedDistanceField::build(const Mesh& mesh, const TriangleBVH& bvh, const DistanceFieldSettings& settings)
+{
+    if (bvh.getMesh() != &mesh)
+        throw std::runtime_error("the BVH for the distance field must be built over the mesh");
+    if (mesh.getFaces().empty())
+        throw std::runtime_error("the distance field needs a mesh with faces");
+    if (!settings.resolution)
+        throw std::runtime_error("the distance field needs at least one voxel along the longest side");
+
+    // the BVH bounds only contain vertices used by faces
+    const AABB bounds = bvh.getBounds();
+    const float extent = bounds.extents().maxComponent();
+    spacing = extent > 0.0f ? extent / static_cast<float>(settings.resolution) : 1.0f;
+    start = bounds.min - Point3D{spacing * static_cast<float>(settings.padding)};
+    uint64_t blockCount = 1;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float cells = std::ceil(component(bounds.extents(), axis) / spacing);
+        size[axis] = static_cast<uint32_t>(cells) + 1 + 2 * settings.padding;
+        blocks[axis] = (size[axis] + blockSize - 1) / blockSize;
+        blockCount *= blocks[axis];
+    }
+    if (blockCount >= uniform / blockVoxels)
+        throw std::runtime_error("the distance field has too many voxels");
+
+    const float band = settings.narrowBand > 0.0f ? settings.narrowBand * spacing : std::numeric_limits<float>::infinity();
+    const WindingNumber winding{bvh};
+    std::atomic<size_t> evaluations{0};
+    auto blockOrigin = [&](uint32_t block) -> std::array<uint32_t, 3> {
+        return {block % blocks[0] * blockSize, block / blocks[0] % blocks[1] * blockSize,
+                block / (blocks[0] * blocks[1]) * blockSize};
+    };
+
+    // blocks without a face within the band plus their half diagonal only keep one value
+    blockSlots.assign(blockCount, 0);
+    uniformValues.assign(blockCount, 0.0f);
+    if (band < std::numeric_limits<float>::infinity()) {
+        const float halfBlock = 0.5f * static_cast<float>(blockSize - 1) * spacing;
+        const float halfDiagonal = std::sqrt(3.0f) * halfBlock;
+        parallelFor(blockCount, [&](size_t begin, size_t end) -> void {
+            size_t count = 0;
+            for (size_t block = begin; block < end; ++block) {
+                const auto [x, y, z] = blockOrigin(static_cast<uint32_t>(block));
+                const Point3D center = position(x, y, z) + Point3D{halfBlock};
+                ClosestPoint closest;
+                if (bvh.closestPoint(center, closest, band + halfDiagonal))
+                    continue;
+                blockSlots[block] = uniform;
+                uniformValues[block] = winding(center) > 0.5f ? -band : band;
+                ++count;
+            }
+            evaluations += count;
+        }, 16);
+    }
+    CountedVector<uint32_t, MemoryCategory::Temporary> storedBlocks;
+    for (uint32_t block = 0; block < blockCount; ++block) {
+        if (blockSlots[block] != uniform) {
+            blockSlots[block] = static_cast<uint32_t>(storedBlocks.size());
+            storedBlocks.push_back(block);
+        }
+    }
+
+    values.assign(storedBlocks.size() * blockVoxels, 0.0f);
+    parallelFor(storedBlocks.size(), [&](size_t begin, size_t end) -> void {
+        size_t count = 0;
+        for (size_t slot = begin; slot < end; ++slot) {
+            const auto [x0, y0, z0] = blockOrigin(storedBlocks[slot]);
+            float* voxels = &values[slot * blockVoxels];
+            float previous = 0.0f, rowStart = 0.0f, sliceStart = 0.0f;
+            for (uint32_t lz = 0; lz < blockSize && z0 + lz < size[2]; ++lz) {
+                for (uint32_t ly = 0; ly < blockSize && y0 + ly < size[1]; ++ly) {
+                    for (uint32_t lx = 0; lx < blockSize && x0 + lx < size[0]; ++lx) {
+                        // the last voxel next to this one: along the row, else the start of the last row or slice
+                        const bool hasNeighbor = lx || ly || lz;
+                        const float neighbor = lx ? previous : ly ? rowStart : sliceStart;
+                        const Point3D p = position(x0 + lx, y0 + ly, z0 + lz);
+
+                        const float bound = hasNeighbor ? std::min(band, std::abs(neighbor) + 1.001f * spacing) : band;
+                        ClosestPoint closest;
+                        const float distance = bvh.closestPoint(p, closest, bound) ? closest.distance() : bound;
+                        // the surface cannot pass between two voxels if it is farther than their spacing
+                        bool inside;
+                        if (hasNeighbor && std::abs(neighbor) > spacing)
+                            inside = neighbor < 0.0f;
+                        else {
+                            inside = winding(p) > 0.5f;
+                            ++count;
+                        }
+
+                        const float value = inside ? -distance : distance;
+                        voxels[(lz * blockSize + ly) * blockSize + lx] = value;
+                        previous = value;
+                        if (!lx) {
+                            rowStart = value;
+                            if (!ly)
+                                sliceStart = value;
+                        }
+                    }
+                }
+            }
+        }
+        evaluations += count;
+    }, 1);
+    windingNumbers = evaluations;
+}
+
+void SignedDistanceField::locate(const Point3D& p, std::array<uint32_t, 3>& cell, Point3D& fraction) const
+{
+    float f[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        const float last = static_cast<float>(size[axis] - 1);
+        const float g = std::clamp((component(p, axis) - component(start, axis)) / spacing, 0.0f, last);
+        cell[axis] = size[axis] > 1 ? std::min(static_cast<uint32_t>(g), size[axis] - 2) : 0;
+        f[axis] = size[axis] > 1 ? g - static_cast<float>(cell[axis]) : 0.0f;
+    }
+    fraction = {f[0], f[1], f[2]};
+}
+
+float SignedDistanceField::sample(const Point3D& p) const
+{
+    if (values.empty() && uniformValues.empty())
+        return std::numeric_limits<float>::infinity();
+    std::array<uint32_t, 3> c;
+    Point3D f;
+    locate(p, c, f);
+    const uint32_t x1 = std::min(c[0] + 1, size[0] - 1), y1 = std::min(c[1] + 1, size[1] - 1);
+    const uint32_t z1 = std::min(c[2] + 1, size[2] - 1);
+    auto lerp = [](float a, float b, float t) -> float { return a + (b - a) * t; };
+    const float c00 = lerp(at(c[0], c[1], c[2]), at(x1, c[1], c[2]), f.x);
+    const float c10 = lerp(at(c[0], y1, c[2]), at(x1, y1, c[2]), f.x);
+    const float c01 = lerp(at(c[0], c[1], z1), at(x1, c[1], z1), f.x);
+    const float c11 = lerp(at(c[0], y1, z1), at(x1, y1, z1), f.x);
+    return lerp(lerp(c00, c10, f.y), lerp(c01, c11, f.y), f.z);
+}
+
+Point3D SignedDistanceField::gradient(const Point3D& p) const
+{
+    if (values.empty() && uniformValues.empty())
+        return Point3D{0.0f};
+    std::array<uint32_t, 3> c;
+    Point3D f;
+    locate(p, c, f);
+    const uint32_t x1 = std::min(c[0] + 1, size[0] - 1), y1 = std::min(c[1] + 1, size[1] - 1);
+    const uint32_t z1 = std::min(c[2] + 1, size[2] - 1);
+    float v[2][2][2];
+    for (uint32_t k = 0; k < 2; ++k)
+        for (uint32_t j = 0; j < 2; ++j)
+            for (uint32_t i = 0; i < 2; ++i)
+                v[k][j][i] = at(i ? x1 : c[0], j ? y1 : c[1], k ? z1 : c[2]);
+
+    // derivatives of the trilinear interpolation along each axis
+    auto lerp = [](float a, float b, float t) -> float { return a + (b - a) * t; };
+    const float dx = lerp(lerp(v[0][0][1] - v[0][0][0], v[0][1][1] - v[0][1][0], f.y),
+                          lerp(v[1][0][1] - v[1][0][0], v[1][1][1] - v[1][1][0], f.y), f.z);
+    const float dy = lerp(lerp(v[0][1][0] - v[0][0][0], v[0][1][1] - v[0][0][1], f.x),
+                          lerp(v[1][1][0] - v[1][0][0], v[1][1][1] - v[1][0][1], f.x), f.z);
+    const float dz = lerp(lerp(v[1][0][0] - v[0][0][0], v[1][0][1] - v[0][0][1], f.x),
+                          lerp(v[1][1][0] - v[0][1][0], v[1][1][1] - v[0][1][1], f.x), f.y);
+    return Point3D{dx, dy, dz} / spacing;
+}
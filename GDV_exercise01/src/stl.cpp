@@ -0,0 +1,212 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "binaryio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr size_t headerSize = 84;
+constexpr size_t triangleSize = 50;
+
+/// marks corners which are the first occurrence of their position while the vertices are numbered
+constexpr uint32_t firstCornerFlag = 0x80000000u;
+constexpr uint32_t emptySlot = UINT32_MAX;
+
+/// bit patterns of a position, -0 is mapped to +0 so both are merged
+struct PositionBits {
+    uint32_t x, y, z;
+
+    bool operator==(const PositionBits&) const = default;
+};
+
+inline uint64_t hashPosition(const PositionBits& p)
+{
+    uint64_t h = (static_cast<uint64_t>(p.x) * 0x9E3779B97F4A7C15ull) ^ (static_cast<uint64_t>(p.y) << 21)
+               ^ (static_cast<uint64_t>(p.z) * 0xC2B2AE3D27D4EB4Full);
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 32);
+}
+
+/// an angle weighted normal which has to be added to a vertex owned by another chunk
+struct NormalContribution {
+    uint32_t vertex;
+    Vertex normal;
+};
+
+} // namespace
+
+void Mesh::loadSTL(const std::string& filename)
+{
+    clear();
+
+    const MemoryPeakScope memoryScope;
+
+    MappedFile file{filename};
+    auto fail = [&](const std::string& what) -> void {
+        clear();
+        throw std::runtime_error("failed to parse the STL file " + filename + "\n" + what);
+    };
+
+    // binary files may also start with "solid", so ASCII files are only detected by their size
+    const std::string_view text{reinterpret_cast<const char*>(file.data()), file.size()};
+    const size_t triangleCount = file.size() >= headerSize ? readLittleEndian<uint32_t>(file.data() + 80) : 0;
+    if (file.size() < headerSize || file.size() < headerSize + triangleCount * triangleSize)
+        fail(text.starts_with("solid") ? "only binary STL files are supported" : "unexpected end of file");
+    // the most significant bit of the corner indices is used as a flag below
+    const size_t cornerCount = 3 * triangleCount;
+    if (cornerCount >= firstCornerFlag)
+        fail("too many triangles");
+    // nothing to copy, and the face data pointer below may be null
+    if (triangleCount == 0) {
+        std::cout << "Loaded STL file: " << filename << " containing no triangles." << std::endl;
+        return;
+    }
+
+    // positions are read directly from the mapped file, the stored face normals are ignored
+    const uint8_t* triangles = file.data() + headerSize;
+    auto positionBits = [&](size_t corner) -> PositionBits {
+        const uint8_t* p = triangles + (corner / 3) * triangleSize + 12 + 12 * (corner % 3);
+        return {std::bit_cast<uint32_t>(readLittleEndian<float>(p) + 0.0f),
+                std::bit_cast<uint32_t>(readLittleEndian<float>(p + 4) + 0.0f),
+                std::bit_cast<uint32_t>(readLittleEndian<float>(p + 8) + 0.0f)};
+    };
+
+    faces.resize(triangleCount);
+    uint32_t* corners = &faces.data()->v1;
+    {
+        // the hash table keeps the smallest corner index of each distinct position, so the
+        // result does not depend on the order in which the threads insert the corners
+        CountedVector<uint32_t, MemoryCategory::Temporary> table(
+            std::max<size_t>(std::bit_ceil(2 * cornerCount), 1024), emptySlot);
+        const size_t mask = table.size() - 1;
+
+        parallelFor(cornerCount, [&](size_t begin, size_t end) -> void {
+            for (size_t corner = begin; corner < end; ++corner) {
+                const PositionBits position = positionBits(corner);
+                for (size_t slot = hashPosition(position) & mask;; slot = (slot + 1) & mask) {
+                    std::atomic_ref<uint32_t> entry{table[slot]};
+                    uint32_t current = entry.load(std::memory_order_relaxed);
+                    if (current == emptySlot
+                        && entry.compare_exchange_strong(current, static_cast<uint32_t>(corner),
+                                                         std::memory_order_relaxed))
+                        break;
+                    // current now holds the corner which occupies the slot
+                    if (positionBits(current) == position) {
+                        while (corner < current
+                               && !entry.compare_exchange_weak(current, static_cast<uint32_t>(corner),
+                                                               std::memory_order_relaxed)) {
+                        }
+                        break;
+                    }
+                }
+            }
+        }, size_t{1} << 16);
+
+        parallelFor(cornerCount, [&](size_t begin, size_t end) -> void {
+            for (size_t corner = begin; corner < end; ++corner) {
+                const PositionBits position = positionBits(corner);
+                size_t slot = hashPosition(position) & mask;
+                while (positionBits(table[slot]) != position)
+                    slot = (slot + 1) & mask;
+                corners[corner] = table[slot];
+            }
+        }, size_t{1} << 16);
+    }
+
+    // number the vertices in the order of their first occurrence, chunk c creates
+    // the vertices [firstVertex[c], firstVertex[c + 1])
+    const size_t chunks = chunkCount(triangleCount, size_t{1} << 15);
+    std::vector<uint32_t> firstVertex(chunks + 1, 0);
+    parallelForChunks(triangleCount, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        uint32_t count = 0;
+        for (size_t corner = 3 * begin; corner < 3 * end; ++corner)
+            count += corners[corner] == corner;
+        firstVertex[chunk + 1] = count;
+    });
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+        firstVertex[chunk + 1] += firstVertex[chunk];
+
+    vertices.resize(firstVertex[chunks]);
+    std::vector<AABB> chunkBounds(chunks);
+    parallelForChunks(triangleCount, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        uint32_t vertex = firstVertex[chunk];
+        for (size_t corner = 3 * begin; corner < 3 * end; ++corner) {
+            if (corners[corner] != corner)
+                continue;
+            const PositionBits bits = positionBits(corner);
+            vertices[vertex] = {std::bit_cast<float>(bits.x), std::bit_cast<float>(bits.y),
+                                std::bit_cast<float>(bits.z)};
+            chunkBounds[chunk].extend(vertices[vertex]);
+            corners[corner] = vertex++ | firstCornerFlag;
+        }
+    });
+    for (const AABB& bounds : chunkBounds)
+        aabb = aabb + bounds;
+
+    // resolve the remaining corners and compute the face areas and angle weighted normals in one
+    // pass, each chunk adds to the normals of its own vertices and defers all other contributions
+    faceAreas.resize(triangleCount);
+    normals.assign(vertices.size(), Vertex{});
+    std::vector<std::vector<NormalContribution>> deferred(chunks);
+    parallelForChunks(triangleCount, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+        auto addNormal = [&](uint32_t vertex, const Vertex& normal) -> void {
+            if (vertex >= firstVertex[chunk] && vertex < firstVertex[chunk + 1])
+                normals[vertex] += normal;
+            else
+                deferred[chunk].push_back({vertex, normal});
+        };
+
+        for (size_t i = begin; i < end; ++i) {
+            TriangleIndices& t = faces[i];
+            for (uint32_t* index : {&t.v1, &t.v2, &t.v3}) {
+                // first corners are only written by their own chunk, other corners refer to one
+                if (*index & firstCornerFlag)
+                    std::atomic_ref<uint32_t>{*index}.store(*index & ~firstCornerFlag, std::memory_order_relaxed);
+                else
+                    *index = std::atomic_ref<uint32_t>{corners[*index]}.load(std::memory_order_relaxed)
+                           & ~firstCornerFlag;
+            }
+
+            const Vertex v1v2 = vertices[t.v2] - vertices[t.v1];
+            const Vertex v1v3 = vertices[t.v3] - vertices[t.v1];
+            faceAreas[i] = cross(v1v2, v1v3).norm() * 0.5f;
+
+            // the same weights as updateNormals uses for faces in a smooth group
+            const Vertex e12 = normalize(v1v2);
+            const Vertex e13 = normalize(v1v3);
+            const Vertex e23 = normalize(vertices[t.v3] - vertices[t.v2]);
+            const Vertex up = normalize(cross(e12, e13));
+            addNormal(t.v1, up * std::acos(std::clamp(dot(e12, e13), -1.0f, 1.0f)));
+            addNormal(t.v2, up * std::acos(std::clamp(-dot(e12, e23), -1.0f, 1.0f)));
+            addNormal(t.v3, up * std::acos(std::clamp(dot(e23, e13), -1.0f, 1.0f)));
+        }
+    });
+    // in a coherent file only faces near the chunk borders produce deferred contributions
+    for (const auto& contributions : deferred)
+        for (const auto& [vertex, normal] : contributions)
+            normals[vertex] += normal;
+    deferred = {};
+
+    parallelFor(normals.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i)
+            normals[i] = normalize(normals[i]);
+    });
+
+    // STL has no smoothing information, all faces are shaded smooth
+    if (!faces.empty())
+        smoothGroups.emplace_back(0, faces.size());
+
+    peakLoadTransient = memoryScope.transient(getMemoryUsage().resident());
+
+    std::cout << "Loaded STL file: " << filename << " containing " << triangleCount << " triangles with "
+              << vertices.size() << " distinct vertices." << std::endl;
+}
@@ -0,0 +1,315 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numbers>
+#include <stdexcept>
+
+#include "halfedge.h"
+#include "parallel.h"
+
+namespace {
+
+constexpr uint32_t invalid = HalfEdgeMesh::invalid;
+/// face group of faces outside of all smooth groups
+constexpr uint32_t noGroup = UINT32_MAX;
+
+inline uint32_t next(uint32_t h) { return HalfEdgeMesh::next(h); }
+inline uint32_t prev(uint32_t h) { return HalfEdgeMesh::prev(h); }
+
+/*
+    face f = (v0, v1, v2) with edge points m0, m1, m2 on its half-edges 3f, 3f+1, 3f+2 is split into
+        4f   = (v0, m0, m2)
+        4f+1 = (m0, v1, m1)
+        4f+2 = (m2, m1, v2)
+        4f+3 = (m0, m1, m2)
+    so the half-edges of the refined mesh and their twins follow directly from the coarse ones
+*/
+
+/// the refined half-edge from the origin of coarse half-edge h to its edge point
+inline uint32_t firstHalf(uint32_t h) { return 3 * (4 * (h / 3) + h % 3) + h % 3; }
+/// the refined half-edge from the edge point of coarse half-edge h to its target
+inline uint32_t secondHalf(uint32_t h) { return 3 * (4 * (h / 3) + (h % 3 + 1) % 3) + h % 3; }
+
+/// half-edge connectivity carried from level to level
+struct Connectivity {
+    /// twin per half-edge, invalid on boundaries and non-manifold edges
+    std::vector<uint32_t> twins;
+    /// outgoing half-edge per vertex, a boundary one for boundary vertices
+    std::vector<uint32_t> outgoing;
+    /// vertices which are kept in place because several fans of faces meet there
+    std::vector<uint8_t> nonManifold;
+    /// smooth group per face, edges between different groups are creases
+    std::vector<uint32_t> faceGroups;
+};
+
+/// the Loop weight of the neighbors of an interior vertex with the given valence
+inline float loopBeta(size_t valence)
+{
+    const float c = 0.375f + 0.25f * std::cos(2.0f * std::numbers::pi_v<float> / static_cast<float>(valence));
+    return (0.625f - c * c) / static_cast<float>(valence);
+}
+
+/**
+ * @brief atan2(sine, cosine) for sine >= 0 with an error below 3e-4 radians
+ * std::atan2 dominates the normal computation of large meshes, the corner angles are only weights
+ */
+inline float cornerAngle(float sine, float cosine)
+{
+    // selects instead of branches, the corners of a mesh hit every case in random order
+    const float absCosine = std::abs(cosine);
+    const bool steep = sine > absCosine;
+    const float a = (steep ? absCosine : sine) / (steep ? sine : absCosine);
+    const float r = a * a;
+    const float atan = ((-0.0464964749f * r + 0.15931422f) * r - 0.327622764f) * r * a + a;
+    const float angle = steep ? std::numbers::pi_v<float> * 0.5f - atan : atan;
+    return std::copysign(angle, cosine) + (cosine < 0.0f ? std::numbers::pi_v<float> : 0.0f);
+}
+
+} // namespace
+
+void Mesh::subdivideLoop(unsigned levels)
+{
+    if (!levels || faces.empty())
+        return;
+
+    // the first level takes the twins from a half-edge mesh, all further ones are derived from them
+    Connectivity coarse;
+    {
+        const HalfEdgeMesh halfEdges{*this};
+        coarse.twins.resize(halfEdges.numHalfEdges());
+        parallelFor(coarse.twins.size(), [&](size_t begin, size_t end) -> void {
+            for (size_t h = begin; h < end; ++h)
+                coarse.twins[h] = halfEdges.twin(static_cast<uint32_t>(h));
+        });
+        coarse.outgoing.resize(vertices.size());
+        coarse.nonManifold.resize(vertices.size());
+        parallelFor(vertices.size(), [&](size_t begin, size_t end) -> void {
+            for (size_t v = begin; v < end; ++v) {
+                coarse.outgoing[v] = halfEdges.outgoing(static_cast<uint32_t>(v));
+                coarse.nonManifold[v] = !halfEdges.isManifoldVertex(static_cast<uint32_t>(v));
+            }
+        });
+    }
+    coarse.faceGroups.assign(faces.size(), noGroup);
+    for (size_t group = 0; group < smoothGroups.size(); ++group)
+        std::fill(coarse.faceGroups.begin() + smoothGroups[group].first,
+                  coarse.faceGroups.begin() + smoothGroups[group].second, static_cast<uint32_t>(group));
+
+    const bool hasTexCoords = !vertices.empty() && texCoords.size() == vertices.size();
+    const bool hasOcclusion = !vertices.empty() && ambientOcclusion.size() == vertices.size();
+
+    for (unsigned level = 0; level < levels; ++level) {
+        const size_t faceCount = faces.size();
+        const size_t vertexCount = vertices.size();
+        if (12 * faceCount >= invalid)
+            throw std::runtime_error("too many faces to subdivide");
+        const std::vector<uint32_t>& twins = coarse.twins;
+        const uint32_t* corners = &faces.data()->v1;
+        auto from = [&](uint32_t h) -> uint32_t { return corners[h]; };
+        auto to = [&](uint32_t h) -> uint32_t { return corners[next(h)]; };
+        auto isSharp = [&](uint32_t h) -> bool {
+            return twins[h] == invalid || coarse.faceGroups[h / 3] != coarse.faceGroups[twins[h] / 3];
+        };
+
+        // edge table: every edge is owned by its lower half-edge, edge points are numbered in face order
+        const size_t chunks = chunkCount(faceCount);
+        std::vector<uint32_t> edgeOf(3 * faceCount);
+        std::vector<uint32_t> firstEdge(chunks + 1, 0);
+        auto owns = [&](uint32_t h) -> bool { return twins[h] == invalid || h < twins[h]; };
+        parallelForChunks(faceCount, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+            uint32_t count = 0;
+            for (uint32_t h = static_cast<uint32_t>(3 * begin); h < 3 * end; ++h)
+                count += owns(h);
+            firstEdge[chunk + 1] = count;
+        });
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+            firstEdge[chunk + 1] += firstEdge[chunk];
+        parallelForChunks(faceCount, chunks, [&](size_t chunk, size_t begin, size_t end) -> void {
+            uint32_t edge = firstEdge[chunk];
+            for (uint32_t h = static_cast<uint32_t>(3 * begin); h < 3 * end; ++h) {
+                if (!owns(h))
+                    continue;
+                edgeOf[h] = edge;
+                if (twins[h] != invalid)
+                    edgeOf[twins[h]] = edge;
+                ++edge;
+            }
+        });
+        const size_t edgeCount = firstEdge[chunks];
+
+        // vertex points: smooth vertices use the Loop weights, vertices on exactly two sharp edges
+        // follow the crease curve, corners and non-manifold vertices stay in place
+        auto vertexPoint = [&](uint32_t v, const auto& attribute) {
+            using Value = std::decay_t<decltype(attribute[0])>;
+            const uint32_t start = coarse.outgoing[v];
+            if (start == invalid || coarse.nonManifold[v])
+                return attribute[v];
+            Value ring{}, sharp{};
+            size_t valence = 0, sharpEdges = 0;
+            uint32_t h = start, last = start;
+            do {
+                last = h;
+                ring += attribute[to(h)];
+                ++valence;
+                if (isSharp(h)) {
+                    sharp += attribute[to(h)];
+                    ++sharpEdges;
+                }
+                h = twins[prev(h)];
+            } while (h != invalid && h != start);
+            if (h == invalid) {
+                // the incoming boundary edge closes the fan
+                ring += attribute[from(prev(last))];
+                sharp += attribute[from(prev(last))];
+                ++valence;
+                ++sharpEdges;
+            }
+            if (sharpEdges > 2)
+                return attribute[v];
+            if (sharpEdges == 2)
+                return attribute[v] * 0.75f + sharp * 0.125f;
+            const float beta = loopBeta(valence);
+            return attribute[v] * (1.0f - static_cast<float>(valence) * beta) + ring * beta;
+        };
+
+        // edge points: midpoints on sharp edges, 3/8 and 1/8 weights otherwise
+        auto edgePoint = [&](uint32_t h, const auto& attribute) {
+            const auto& a = attribute[from(h)];
+            const auto& b = attribute[to(h)];
+            if (isSharp(h))
+                return (a + b) * 0.5f;
+            return (a + b) * 0.375f + (attribute[from(prev(h))] + attribute[from(prev(twins[h]))]) * 0.125f;
+        };
+
+        // old vertices keep their index, the edge points follow them
+        VertexList refinedVertices(vertexCount + edgeCount);
+        TextureCoordinateList refinedTexCoords(hasTexCoords ? vertexCount + edgeCount : 0);
+        AmbientOcclusionList refinedOcclusion(hasOcclusion ? vertexCount + edgeCount : 0);
+        parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+            for (size_t v = begin; v < end; ++v) {
+                refinedVertices[v] = vertexPoint(static_cast<uint32_t>(v), vertices);
+                // the other attributes are interpolated linearly, so the old vertices keep theirs
+                if (hasTexCoords)
+                    refinedTexCoords[v] = texCoords[v];
+                if (hasOcclusion)
+                    refinedOcclusion[v] = ambientOcclusion[v];
+            }
+        }, 1024);
+
+        FaceList refinedFaces(4 * faceCount);
+        Connectivity fine;
+        fine.twins.resize(12 * faceCount);
+        fine.outgoing.resize(vertexCount + edgeCount);
+        fine.nonManifold.assign(vertexCount + edgeCount, 0);
+        fine.faceGroups.resize(4 * faceCount);
+        parallelFor(faceCount, [&](size_t begin, size_t end) -> void {
+            for (uint32_t f = static_cast<uint32_t>(begin); f < end; ++f) {
+                const uint32_t h0 = 3 * f, h1 = h0 + 1, h2 = h0 + 2;
+                for (uint32_t h : {h0, h1, h2}) {
+                    if (!owns(h))
+                        continue;
+                    const uint32_t point = static_cast<uint32_t>(vertexCount) + edgeOf[h];
+                    refinedVertices[point] = edgePoint(h, vertices);
+                    if (hasTexCoords)
+                        refinedTexCoords[point] = (texCoords[from(h)] + texCoords[to(h)]) * 0.5f;
+                    if (hasOcclusion)
+                        refinedOcclusion[point] = (ambientOcclusion[from(h)] + ambientOcclusion[to(h)]) * 0.5f;
+                    // on boundary edges the second half is a boundary half-edge as well
+                    fine.outgoing[point] = secondHalf(h);
+                }
+
+                const uint32_t v0 = corners[h0], v1 = corners[h1], v2 = corners[h2];
+                const auto m0 = static_cast<uint32_t>(vertexCount + edgeOf[h0]);
+                const auto m1 = static_cast<uint32_t>(vertexCount + edgeOf[h1]);
+                const auto m2 = static_cast<uint32_t>(vertexCount + edgeOf[h2]);
+                refinedFaces[4 * f] = {v0, m0, m2};
+                refinedFaces[4 * f + 1] = {m0, v1, m1};
+                refinedFaces[4 * f + 2] = {m2, m1, v2};
+                refinedFaces[4 * f + 3] = {m0, m1, m2};
+
+                for (uint32_t h : {h0, h1, h2}) {
+                    const uint32_t twin = twins[h];
+                    fine.twins[firstHalf(h)] = twin == invalid ? invalid : secondHalf(twin);
+                    fine.twins[secondHalf(h)] = twin == invalid ? invalid : firstHalf(twin);
+                }
+                const uint32_t c = 12 * f;
+                // inner half-edges: (m0, m2) in 4f, (m1, m0) in 4f+1, (m2, m1) in 4f+2 against 4f+3
+                fine.twins[c + 1] = c + 11;
+                fine.twins[c + 11] = c + 1;
+                fine.twins[c + 5] = c + 9;
+                fine.twins[c + 9] = c + 5;
+                fine.twins[c + 6] = c + 10;
+                fine.twins[c + 10] = c + 6;
+
+                for (uint32_t k = 0; k < 4; ++k)
+                    fine.faceGroups[4 * f + k] = coarse.faceGroups[f];
+            }
+        });
+        parallelFor(vertexCount, [&](size_t begin, size_t end) -> void {
+            for (size_t v = begin; v < end; ++v) {
+                const uint32_t h = coarse.outgoing[v];
+                fine.outgoing[v] = h == invalid ? invalid : firstHalf(h);
+                fine.nonManifold[v] = coarse.nonManifold[v];
+            }
+        });
+
+        vertices = std::move(refinedVertices);
+        faces = std::move(refinedFaces);
+        if (hasTexCoords)
+            texCoords = std::move(refinedTexCoords);
+        if (hasOcclusion)
+            ambientOcclusion = std::move(refinedOcclusion);
+        coarse = std::move(fine);
+        for (auto& [start, end] : smoothGroups) {
+            start *= 4;
+            end *= 4;
+        }
+    }
+
+    updateBounds();
+    updateFaceAreas();
+
+    // the same angle weighted normals as updateNormals, but gathered per vertex around its fan
+    const uint32_t* corners = &faces.data()->v1;
+    auto cornerNormal = [&](uint32_t h) -> Vertex {
+        // the angle at the corner from one cross and one dot product, cross points along the face normal
+        const Vertex& p = vertices[corners[h]];
+        const Vertex e1 = vertices[corners[next(h)]] - p;
+        const Vertex e2 = vertices[corners[prev(h)]] - p;
+        const Vertex c = cross(e1, e2);
+        const float sine = c.norm();
+        return sine > 0.0f ? c * (cornerAngle(sine, dot(e1, e2)) / sine) : Vertex{};
+    };
+    auto contributes = [&](uint32_t h) -> bool { return h % 3 == 0 || coarse.faceGroups[h / 3] != noGroup; };
+
+    normals.assign(vertices.size(), Vertex{});
+    parallelFor(vertices.size(), [&](size_t begin, size_t end) -> void {
+        for (size_t v = begin; v < end; ++v) {
+            const uint32_t start = coarse.outgoing[v];
+            if (start == invalid || coarse.nonManifold[v])
+                continue;
+            Vertex sum{};
+            uint32_t h = start;
+            do {
+                if (contributes(h))
+                    sum += cornerNormal(h);
+                h = coarse.twins[prev(h)];
+            } while (h != invalid && h != start);
+            normals[v] = normalize(sum);
+        }
+    }, 1024);
+    // the fans of non-manifold vertices are not connected, so they are collected from all faces
+    if (std::find(coarse.nonManifold.begin(), coarse.nonManifold.end(), 1) != coarse.nonManifold.end()) {
+        for (uint32_t h = 0; h < 3 * faces.size(); ++h)
+            if (coarse.nonManifold[corners[h]] && contributes(h))
+                normals[corners[h]] += cornerNormal(h);
+        for (size_t v = 0; v < vertices.size(); ++v)
+            if (coarse.nonManifold[v])
+                normals[v] = normalize(normals[v]);
+    }
+
+    std::cout << "Loop subdivision: " << levels << " levels, " << vertices.size() << " vertices and "
+              << faces.size() << " faces." << std::endl;
+}
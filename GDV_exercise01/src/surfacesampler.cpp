@@ -0,0 +1,221 @@
+#include "surfacesampler.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "parallel.h"
+#include "random.h"
+
+namespace {
+
+/// samples per random stream, fixed so the result does not depend on the number of threads
+constexpr size_t blockSize = 1 << 16;
+
+using Cell = std::array<int32_t, 3>;
+
+uint64_t hashCell(const Cell& c)
+{
+    return (uint64_t{static_cast<uint32_t>(c[0])} * 0x9E3779B97F4A7C15ull)
+         ^ (uint64_t{static_cast<uint32_t>(c[1])} * 0xC2B2AE3D27D4EB4Full)
+         ^ (uint64_t{static_cast<uint32_t>(c[2])} * 0x165667B19E3779F9ull);
+}
+
+} // namespace
+
+SurfaceSampler::SurfaceSampler(const Mesh& mesh) : mesh{mesh}
+{
+    const FaceAreaList& faceAreas = mesh.getFaceAreas();
+    const size_t faceCount = mesh.getFaces().size();
+    if (faceAreas.size() != faceCount)
+        throw std::runtime_error("the face areas of the mesh are not up to date");
+    if (faceCount >= UINT32_MAX)
+        throw std::runtime_error("the mesh has too many faces for the surface sampler");
+
+    area = 0.0;
+    for (float faceArea : faceAreas)
+        area += faceArea;
+    if (!(area > 0.0) || !std::isfinite(area))
+        throw std::runtime_error("the mesh has no surface area to sample");
+
+    // Vose's alias method: columns with less than the average probability are filled up by larger ones
+    probabilities.resize(faceCount);
+    aliases.resize(faceCount);
+    std::vector<double> scaled(faceCount);
+    std::vector<uint32_t> small, large;
+    const double scale = static_cast<double>(faceCount) / area;
+    for (uint32_t f = 0; f < faceCount; ++f) {
+        scaled[f] = faceAreas[f] * scale;
+        (scaled[f] < 1.0 ? small : large).push_back(f);
+    }
+    while (!small.empty() && !large.empty()) {
+        const uint32_t less = small.back(), more = large.back();
+        small.pop_back();
+        probabilities[less] = static_cast<float>(scaled[less]);
+        aliases[less] = more;
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // the remaining columns are full up to rounding errors
+    for (uint32_t f : small) {
+        probabilities[f] = 1.0f;
+        aliases[f] = f;
+    }
+    for (uint32_t f : large) {
+        probabilities[f] = 1.0f;
+        aliases[f] = f;
+    }
+
+    smooth.assign(faceCount, 0);
+    for (const auto& [start, end] : mesh.getSmoothGroups())
+        std::fill(smooth.begin() + std::min(start, faceCount), smooth.begin() + std::min(end, faceCount), 1);
+    if (mesh.getNormals().size() != mesh.getVertices().size())
+        std::fill(smooth.begin(), smooth.end(), 0);
+}
+
+std::vector<SurfaceSample> SurfaceSampler::sample(size_t count, uint64_t seed) const
+{
+    const VertexList& vertices = mesh.getVertices();
+    const NormalList& normals = mesh.getNormals();
+    const FaceList& faces = mesh.getFaces();
+    const uint32_t faceCount = static_cast<uint32_t>(faces.size());
+
+    std::vector<SurfaceSample> samples(count);
+    const size_t blocks = (count + blockSize - 1) / blockSize;
+    parallelFor(blocks, [&](size_t beginBlock, size_t endBlock) -> void {
+        for (size_t block = beginBlock; block < endBlock; ++block) {
+            PCG32 random{seed, block};
+            const size_t end = std::min(count, (block + 1) * blockSize);
+            for (size_t i = block * blockSize; i < end; ++i) {
+                uint32_t f = random.nextBelow(faceCount);
+                if (random.nextFloat() >= probabilities[f])
+                    f = aliases[f];
+
+                // uniform barycentric coordinates from the square root warp
+                const float s = std::sqrt(random.nextFloat());
+                const float t = random.nextFloat();
+                const float b1 = s * (1.0f - t), b2 = s * t, b0 = 1.0f - b1 - b2;
+
+                const TriangleIndices& face = faces[f];
+                const Vertex& p0 = vertices[face.v1];
+                const Vertex& p1 = vertices[face.v2];
+                const Vertex& p2 = vertices[face.v3];
+                samples[i].position = p0 * b0 + p1 * b1 + p2 * b2;
+                samples[i].normal = smooth[f]
+                    ? normalize(normals[face.v1] * b0 + normals[face.v2] * b1 + normals[face.v3] * b2)
+                    : normalize(cross(p1 - p0, p2 - p0));
+                samples[i].face = f;
+            }
+        }
+    }, 1);
+    return samples;
+}
+
+std::vector<SurfaceSample> SurfaceSampler::samplePoissonDisk(float radius, uint64_t seed, float oversampling) const
+{
+    if (!(radius > 0.0f) || !(oversampling > 0.0f))
+        throw std::runtime_error("the Poisson disk radius and oversampling must be positive");
+    const double candidateCount = std::ceil(oversampling * area / (double{radius} * radius));
+    if (candidateCount >= UINT32_MAX)
+        throw std::runtime_error("the Poisson disk radius is too small for the surface area");
+
+    const std::vector<SurfaceSample> candidates = sample(static_cast<size_t>(candidateCount), seed);
+    const size_t count = candidates.size();
+
+    // the cells are 2*radius wide, so only the 8 cells around the nearest corner of the own
+    // cell can contain points within radius
+    const Point3D origin = mesh.getBounds().min;
+    const float invCellSize = 0.5f / radius;
+    struct CellEntry {
+        uint64_t key;
+        uint32_t candidate;
+    };
+    CountedVector<CellEntry, MemoryCategory::Temporary> entries(count);
+    CountedVector<Cell, MemoryCategory::Temporary> cells(count);
+    parallelFor(count, [&](size_t begin, size_t end) -> void {
+        for (size_t i = begin; i < end; ++i) {
+            const Point3D p = (candidates[i].position - origin) * invCellSize;
+            cells[i] = {static_cast<int32_t>(std::floor(p.x)), static_cast<int32_t>(std::floor(p.y)),
+                        static_cast<int32_t>(std::floor(p.z))};
+            entries[i] = {hashCell(cells[i]), static_cast<uint32_t>(i)};
+        }
+    });
+    parallelSort(entries.begin(), entries.end(), [](const CellEntry& a, const CellEntry& b) -> bool {
+        return a.key < b.key;
+    });
+
+    // open addressing table from cell hash to the range of its candidates, the accepted points
+    // of a cell are collected at the front of its range
+    struct Slot {
+        uint64_t key;
+        uint32_t begin, accepted;
+    };
+    constexpr uint32_t empty = UINT32_MAX;
+    CountedVector<Slot, MemoryCategory::Temporary> slots(std::bit_ceil(std::max<size_t>(count, 1) * 2), Slot{0, 0, empty});
+    const size_t mask = slots.size() - 1;
+    auto findSlot = [&](uint64_t key) -> Slot* {
+        for (size_t slot = key & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot].accepted == empty)
+                return nullptr;
+            if (slots[slot].key == key)
+                return &slots[slot];
+        }
+    };
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && entries[j].key == entries[i].key)
+            ++j;
+        size_t slot = entries[i].key & mask;
+        while (slots[slot].accepted != empty)
+            slot = (slot + 1) & mask;
+        slots[slot] = {entries[i].key, static_cast<uint32_t>(i), 0};
+        i = j;
+    }
+
+    // accept the candidates in their random order
+    const float radius2 = radius * radius;
+    std::vector<SurfaceSample> samples;
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& position = candidates[i].position;
+        const Point3D p = (position - origin) * invCellSize;
+        const Cell& cell = cells[i];
+        const Cell step{p.x - cell[0] < 0.5f ? -1 : 1, p.y - cell[1] < 0.5f ? -1 : 1, p.z - cell[2] < 0.5f ? -1 : 1};
+
+        bool free = true;
+        for (int n = 0; n < 8 && free; ++n) {
+            const Cell neighbor{cell[0] + (n & 1 ? step[0] : 0), cell[1] + (n & 2 ? step[1] : 0),
+                                cell[2] + (n & 4 ? step[2] : 0)};
+            const Slot* slot = findSlot(hashCell(neighbor));
+            if (!slot)
+                continue;
+            for (uint32_t e = slot->begin; e < slot->begin + slot->accepted; ++e) {
+                const Vertex d = candidates[entries[e].candidate].position - position;
+                if (dot(d, d) < radius2) {
+                    free = false;
+                    break;
+                }
+            }
+        }
+        if (!free)
+            continue;
+
+        // move the candidate to the end of the accepted points of its cell
+        Slot* own = findSlot(hashCell(cell));
+        uint32_t e = own->begin + own->accepted;
+        while (entries[e].candidate != i)
+            ++e;
+        std::swap(entries[e], entries[own->begin + own->accepted]);
+        ++own->accepted;
+        samples.push_back(candidates[i]);
+    }
+
+    std::cout << "Poisson disk sampling: accepted " << samples.size() << " of " << count
+              << " candidates with radius " << radius << "." << std::endl;
+    return samples;
+}